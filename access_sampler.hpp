@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <signal.h>
+#include <sys/mman.h>
+
+#include "mapper.hpp"
+
+namespace succinct { namespace mapper {
+
+    // Records which pages of the vectors of a structure are accessed
+    // between start() and stop(): the pages are protected, and the
+    // first access to each of them is caught with a SIGSEGV handler,
+    // which marks the page and gives it back its protection. After
+    // stop(), touched and touched_pages are set in the size tree.
+    //
+    // The original protection of each page is read from
+    // /proc/self/maps, so the vectors can be mapped from a file or
+    // live on the heap (as the fields rebuilt after mapping with
+    // freeze_flags::omit_derived). Only one sampler can be active at
+    // a time, and only the first access to each page during a window
+    // is recorded. Linux only.
+
+    namespace detail {
+        // part of the pages of a node with the same protection;
+        // first_page is the first page of the node
+        struct sampled_range {
+            uintptr_t begin;
+            uintptr_t end;
+            uintptr_t first_page;
+            int prot;
+            size_node* node;
+        };
+
+        struct sampler_state {
+            sampler_state()
+                : active(false)
+            {}
+
+            bool active;
+            std::vector<sampled_range> ranges;
+            struct sigaction old_action;
+        };
+
+        inline sampler_state& sampler_state_storage()
+        {
+            static sampler_state state;
+            return state;
+        }
+
+        inline void sampler_handler(int sig, siginfo_t* info, void* context)
+        {
+            sampler_state& state = sampler_state_storage();
+            uintptr_t page = uintptr_t(info->si_addr) & ~uintptr_t(page_size() - 1);
+            bool found = false;
+            int prot = PROT_NONE;
+            // the ranges are few, and each page faults at most once
+            for (size_t i = 0; i < state.ranges.size(); ++i) {
+                sampled_range const& r = state.ranges[i];
+                if (page >= r.begin && page < r.end) {
+                    r.node->touched[(page - r.first_page) / page_size()] = 1;
+                    prot = r.prot;
+                    found = true;
+                }
+            }
+
+            if (found) {
+                mprotect(reinterpret_cast<void*>(page), page_size(), prot);
+            } else if (state.old_action.sa_flags & SA_SIGINFO) {
+                state.old_action.sa_sigaction(sig, info, context);
+            } else if (state.old_action.sa_handler != SIG_IGN
+                       && state.old_action.sa_handler != SIG_DFL) {
+                state.old_action.sa_handler(sig);
+            } else {
+                // not ours: fault again with the default action
+                sigaction(SIGSEGV, &state.old_action, 0);
+            }
+        }
+
+        struct process_mapping {
+            uintptr_t begin;
+            uintptr_t end;
+            int prot;
+        };
+
+        inline void read_process_mappings(std::vector<process_mapping>& mappings)
+        {
+            std::ifstream maps("/proc/self/maps");
+            std::string line;
+            while (std::getline(maps, line)) {
+                unsigned long begin, end;
+                char perms[5];
+                if (sscanf(line.c_str(), "%lx-%lx %4s", &begin, &end, perms) != 3) continue;
+                process_mapping m = {uintptr_t(begin), uintptr_t(end), PROT_NONE};
+                if (perms[0] == 'r') m.prot |= PROT_READ;
+                if (perms[1] == 'w') m.prot |= PROT_WRITE;
+                if (perms[2] == 'x') m.prot |= PROT_EXEC;
+                mappings.push_back(m);
+            }
+        }
+
+        // splits the pages of each vector by the mappings they fall
+        // in, which give the protection to restore
+        inline void collect_ranges(size_node& node,
+                                   std::vector<process_mapping> const& mappings,
+                                   std::vector<sampled_range>& ranges)
+        {
+            std::pair<uintptr_t, size_t> range = page_range(node.data, node.data_bytes);
+            if (range.second) {
+                node.touched.assign(range.second, 0);
+                uintptr_t begin = range.first;
+                uintptr_t end = begin + range.second * page_size();
+                for (size_t i = 0; i < mappings.size(); ++i) {
+                    process_mapping const& m = mappings[i];
+                    if (m.end <= begin || m.begin >= end) continue;
+                    sampled_range r = {std::max(begin, m.begin), std::min(end, m.end),
+                                       begin, m.prot, &node};
+                    ranges.push_back(r);
+                }
+            }
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                collect_ranges(*node.children[i], mappings, ranges);
+            }
+        }
+
+        inline void count_touched(size_node& node)
+        {
+            node.touched_pages = size_t(std::count(node.touched.begin(), node.touched.end(), 1));
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                count_touched(*node.children[i]);
+                node.touched_pages += node.children[i]->touched_pages;
+            }
+        }
+    }
+
+    class access_sampler : boost::noncopyable {
+    public:
+        // samples the vectors of the tree returned by size_tree_of
+        // (or residency_tree_of) on the structure
+        explicit access_sampler(size_node_ptr tree)
+            : m_tree(tree)
+            , m_started(false)
+        {}
+
+        ~access_sampler() {
+            if (m_started) {
+                stop();
+            }
+        }
+
+        void start() {
+            detail::sampler_state& state = detail::sampler_state_storage();
+            assert(!state.active && !m_started);
+            state.ranges.clear();
+            std::vector<detail::process_mapping> mappings;
+            detail::read_process_mappings(mappings);
+            detail::collect_ranges(*m_tree, mappings, state.ranges);
+            state.active = true;
+
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_sigaction = detail::sampler_handler;
+            action.sa_flags = SA_SIGINFO;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGSEGV, &action, &state.old_action);
+
+            for (size_t i = 0; i < state.ranges.size(); ++i) {
+                mprotect(reinterpret_cast<void*>(state.ranges[i].begin),
+                         state.ranges[i].end - state.ranges[i].begin, PROT_NONE);
+            }
+            m_started = true;
+        }
+
+        // restores the protection and updates the tree
+        void stop() {
+            assert(m_started);
+            detail::sampler_state& state = detail::sampler_state_storage();
+            for (size_t i = 0; i < state.ranges.size(); ++i) {
+                mprotect(reinterpret_cast<void*>(state.ranges[i].begin),
+                         state.ranges[i].end - state.ranges[i].begin, state.ranges[i].prot);
+            }
+            sigaction(SIGSEGV, &state.old_action, 0);
+            state.ranges.clear();
+            state.active = false;
+
+            detail::count_touched(*m_tree);
+            m_started = false;
+        }
+
+        size_node_ptr tree() const {
+            return m_tree;
+        }
+
+    private:
+        size_node_ptr m_tree;
+        bool m_started;
+    };
+
+}}
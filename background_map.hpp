@@ -0,0 +1,105 @@
+#pragma once
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include "mapper.hpp"
+
+namespace succinct { namespace mapper {
+
+    // Maps a frozen structure in a background thread, including the
+    // rebuild of the derived fields omitted with
+    // freeze_flags::omit_derived, so that loading does not wait for
+    // it. get() blocks until the structure is ready; with one
+    // background_map per shard (for example per section of a
+    // container) a query only waits for the shards it touches.
+    template <typename T>
+    class background_map : boost::noncopyable {
+    public:
+        background_map(const char* base_address, uint64_t flags = 0,
+                       const char* friendly_name = "<TOP>")
+            : m_base_address(base_address)
+            , m_flags(flags)
+            , m_friendly_name(friendly_name)
+            , m_ready(false)
+            , m_bytes_read(0)
+        {
+            m_thread = boost::thread(boost::ref(*this));
+        }
+
+        background_map(boost::iostreams::mapped_file_source const& m, uint64_t flags = 0,
+                       const char* friendly_name = "<TOP>")
+            : m_base_address(m.data())
+            , m_flags(flags)
+            , m_friendly_name(friendly_name)
+            , m_ready(false)
+            , m_bytes_read(0)
+        {
+            m_thread = boost::thread(boost::ref(*this));
+        }
+
+        ~background_map() {
+            m_thread.join();
+        }
+
+        bool ready() const {
+            boost::mutex::scoped_lock lock(m_mutex);
+            return m_ready;
+        }
+
+        // waits for the structure, and rethrows the exception thrown
+        // while mapping it, if any
+        T const& get() const {
+            wait();
+            return m_val;
+        }
+
+        size_t bytes_read() const {
+            wait();
+            return m_bytes_read;
+        }
+
+        // thread body
+        void operator()() {
+            boost::exception_ptr error;
+            size_t bytes_read = 0;
+            try {
+                bytes_read = mapper::map(m_val, m_base_address, m_flags, m_friendly_name);
+            } catch (...) {
+                error = boost::current_exception();
+            }
+
+            boost::mutex::scoped_lock lock(m_mutex);
+            m_bytes_read = bytes_read;
+            m_error = error;
+            m_ready = true;
+            m_cond.notify_all();
+        }
+
+    private:
+        void wait() const {
+            boost::mutex::scoped_lock lock(m_mutex);
+            while (!m_ready) {
+                m_cond.wait(lock);
+            }
+            if (m_error) {
+                boost::rethrow_exception(m_error);
+            }
+        }
+
+        const char* m_base_address;
+        uint64_t m_flags;
+        const char* m_friendly_name;
+        T m_val;
+
+        mutable boost::mutex m_mutex;
+        mutable boost::condition_variable m_cond;
+        bool m_ready;
+        size_t m_bytes_read;
+        boost::exception_ptr m_error;
+        boost::thread m_thread;
+    };
+
+}}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstring>
 
 #include <boost/range.hpp>
 
@@ -27,6 +28,7 @@ namespace succinct {
         bit_vector_builder(uint64_t size = 0, bool init = 0)
             : m_size(size)
         {
+            mapper::reserve_padded(m_bits, detail::words_for(size));
             m_bits.resize(detail::words_for(size), uint64_t(-init));
             if (size) {
                 m_cur_word = &m_bits.back();
@@ -38,7 +40,7 @@ namespace succinct {
         }
 
         void reserve(uint64_t size) {
-            m_bits.reserve(detail::words_for(size));
+            mapper::reserve_padded(m_bits, detail::words_for(size));
         }
 
         inline void push_back(bool b) {
@@ -231,6 +233,8 @@ namespace succinct {
                 (m_bits, "m_bits");
         }
 
+        SUCCINCT_MOVE_BY_SWAP(bit_vector)
+
         void swap(bit_vector& other) {
             std::swap(other.m_size, m_size);
             other.m_bits.swap(m_bits);
@@ -256,11 +260,9 @@ namespace succinct {
             uint64_t block = pos / 64;
             uint64_t shift = pos % 64;
             uint64_t mask = -(len == 64) | ((1ULL << len) - 1);
-            if (shift + len <= 64) {
-                return m_bits[block] >> shift & mask;
-            } else {
-                return (m_bits[block] >> shift) | (m_bits[block + 1] << (64 - shift) & mask);
-            }
+            // block + 1 is at most the padding word, see mappable_vector
+            const uint64_t* bits = m_bits.data();
+            return ((bits[block] >> shift) | ((bits[block + 1] << 1) << (63 - shift))) & mask;
         }
 
         // same as get_bits(pos, 64) but it can extend further size(), padding with zeros
@@ -269,19 +271,22 @@ namespace succinct {
             assert(pos < size());
             uint64_t block = pos / 64;
             uint64_t shift = pos % 64;
-            uint64_t word = m_bits[block] >> shift;
-            if (shift && block + 1 < m_bits.size()) {
-                word |= m_bits[block + 1] << (64 - shift);
-            }
-            return word;
+            // the word after the last is the zero padding word; the
+            // double shift avoids shifting by 64 when shift is 0
+            const uint64_t* bits = m_bits.data();
+            return (bits[block] >> shift) | ((bits[block + 1] << 1) << (63 - shift));
         }
 
-        // unsafe and fast version of get_word, it retrieves at least 56 bits
+        // faster version of get_word, it retrieves at least 56 bits
+        // with a single unaligned load, which stays within the
+        // padding word
         inline uint64_t get_word56(uint64_t pos) const
         {
             // XXX check endianness?
             const char* ptr = reinterpret_cast<const char*>(m_bits.data());
-            return *(reinterpret_cast<uint64_t const*>(ptr + pos / 8)) >> (pos % 8);
+            uint64_t word;
+            memcpy(&word, ptr + pos / 8, sizeof(word));
+            return word >> (pos % 8);
         }
 
         inline uint64_t predecessor0(uint64_t pos) const {
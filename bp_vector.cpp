@@ -1,6 +1,22 @@
+#include <cstring>
+
 #include "bp_vector.hpp"
 #include "util.hpp"
 
+#if SUCCINCT_HAS_CPU_DISPATCH
+// GCC 12 reports the _mm512_undefined_* placeholders of the AVX-512
+// headers as uninitialized (GCC bug 105593)
+#if !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
 namespace succinct {
 
     namespace {
@@ -72,7 +88,9 @@ namespace succinct {
 
         const static excess_tables tables;
 
-        inline bool find_close_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t& ret)
+        typedef bp_vector::excess_t excess_t;
+
+        inline bool find_close_in_word(uint64_t word, uint64_t byte_counts, excess_t cur_exc, uint64_t& ret)
         {
             assert(cur_exc > 0 && cur_exc <= 64);
             const uint64_t cum_exc_step_8 = (uint64_t(cur_exc) + ((2 * byte_counts - 8 * broadword::ones_step_8) << 8)) * broadword::ones_step_8;
@@ -95,7 +113,7 @@ namespace succinct {
             return false;
         }
 
-        inline bool find_open_in_word(uint64_t word, uint64_t byte_counts, bp_vector::excess_t cur_exc, uint64_t& ret) {
+        inline bool find_open_in_word(uint64_t word, uint64_t byte_counts, excess_t cur_exc, uint64_t& ret) {
             assert(cur_exc > 0 && cur_exc <= 64);
             const uint64_t rev_byte_counts = broadword::reverse_bytes(byte_counts);
             const uint64_t cum_exc_step_8 = (uint64_t(cur_exc) - ((2 * rev_byte_counts - 8 * broadword::ones_step_8) << 8)) * broadword::ones_step_8;
@@ -119,17 +137,17 @@ namespace succinct {
         }
 
         inline void
-        excess_rmq_in_word(uint64_t word, bp_vector::excess_t& exc, uint64_t word_start,
-                           bp_vector::excess_t& min_exc, uint64_t& min_exc_idx)
+        excess_rmq_in_word(uint64_t word, excess_t& exc, uint64_t word_start,
+                           excess_t& min_exc, uint64_t& min_exc_idx)
         {
-            bp_vector::excess_t min_byte_exc = min_exc;
+            excess_t min_byte_exc = min_exc;
             uint64_t min_byte_idx = 0;
 
             for (size_t i = 0; i < 8; ++i) {
                 size_t shift = i * 8;
                 size_t byte = (word >> shift) & 0xFF;
                 // m_fwd_min is negated
-                bp_vector::excess_t cur_min = exc - tables.m_fwd_min[byte];
+                excess_t cur_min = exc - tables.m_fwd_min[byte];
 
                 min_byte_idx = (cur_min < min_byte_exc) ? i : min_byte_idx;
                 min_byte_exc = (cur_min < min_byte_exc) ? cur_min : min_byte_exc;
@@ -143,37 +161,296 @@ namespace succinct {
                 min_exc_idx = word_start + shift + tables.m_fwd_min_idx[(word >> shift) & 0xFF];
             }
         }
+
+        bool find_close_generic(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            for (size_t i = 0; i < n; ++i) {
+                assert(excess > 0);
+                uint64_t byte_counts = broadword::byte_counts(words[i]);
+                if (excess <= 64 && find_close_in_word(words[i], byte_counts, excess, ret)) {
+                    ret += i * 64;
+                    return true;
+                }
+                excess += static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
+            }
+            return false;
+        }
+
+        bool find_open_generic(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            for (size_t i = n; i-- > 0; ) {
+                assert(excess > 0);
+                uint64_t byte_counts = broadword::byte_counts(words[i]);
+                if (excess <= 64 && find_open_in_word(words[i], byte_counts, excess, ret)) {
+                    ret += i * 64;
+                    return true;
+                }
+                excess -= static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
+            }
+            return false;
+        }
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+
+        // The SIMD kernels expand each bit of a word into a byte step
+        // (-1 for open, +1 for close), compute the prefix sums of the
+        // steps, which fit a byte since a word has 64 bits, and
+        // compare them with the target excess. Since the steps are
+        // +-1, the first prefix sum equal to the target is also the
+        // first one reaching it. find_open does the same on the word
+        // in reverse order.
+
+        // 32 bytes of steps of the bits selected by the byte
+        // shuffle and the bit masks (0x80..01 forward, 0x01..80 in
+        // reverse)
+        __attribute__((target("avx2")))
+        inline __m256i steps_avx2(uint32_t bits, __m256i shuffle, __m256i bit_masks)
+        {
+            __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(int(bits)), shuffle);
+            v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bit_masks), bit_masks);
+            return _mm256_or_si256(v, _mm256_set1_epi8(1));
+        }
+
+        __attribute__((target("avx2")))
+        inline __m256i prefix_sum_avx2(__m256i v)
+        {
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 1));
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 2));
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 4));
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 8));
+            // add the last byte of the low lane to the high lane
+            __m256i carry = _mm256_permute2x128_si256(v, v, 0x08);
+            return _mm256_add_epi8(v, _mm256_shuffle_epi8(carry, _mm256_set1_epi8(15)));
+        }
+
+        // bit i is set if the sum of the first i + 1 steps is target;
+        // lo_bits and hi_bits give the first and last 32 steps
+        __attribute__((target("avx2,popcnt")))
+        inline uint64_t prefix_matches_avx2(uint32_t lo_bits, uint32_t hi_bits,
+                                            __m256i shuffle, __m256i bit_masks, int target)
+        {
+            const __m256i v_target = _mm256_set1_epi8(char(target));
+            __m256i lo = prefix_sum_avx2(steps_avx2(lo_bits, shuffle, bit_masks));
+            __m256i hi = prefix_sum_avx2(steps_avx2(hi_bits, shuffle, bit_masks));
+            int lo_sum = 32 - 2 * __builtin_popcount(lo_bits);
+            hi = _mm256_add_epi8(hi, _mm256_set1_epi8(char(lo_sum)));
+            uint32_t lo_mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v_target)));
+            uint32_t hi_mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v_target)));
+            return lo_mask | (uint64_t(hi_mask) << 32);
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        bool find_close_avx2(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                     2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+            const __m256i bit_masks = _mm256_set1_epi64x(int64_t(0x8040201008040201ULL));
+            for (size_t i = 0; i < n; ++i) {
+                assert(excess > 0);
+                uint64_t word = words[i];
+                if (excess <= 64) {
+                    uint64_t matches = prefix_matches_avx2(uint32_t(word), uint32_t(word >> 32),
+                                                           shuffle, bit_masks, excess);
+                    if (matches) {
+                        ret = i * 64 + uint64_t(__builtin_ctzll(matches));
+                        return true;
+                    }
+                }
+                excess += static_cast<excess_t>(2 * __builtin_popcountll(word) - 64);
+            }
+            return false;
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        bool find_open_avx2(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            const __m256i shuffle = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                                     1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i bit_masks = _mm256_set1_epi64x(int64_t(0x0102040810204080ULL));
+            for (size_t i = n; i-- > 0; ) {
+                assert(excess > 0);
+                uint64_t word = words[i];
+                if (excess <= 64) {
+                    uint64_t matches = prefix_matches_avx2(uint32_t(word >> 32), uint32_t(word),
+                                                           shuffle, bit_masks, -excess);
+                    if (matches) {
+                        ret = i * 64 + 63 - uint64_t(__builtin_ctzll(matches));
+                        return true;
+                    }
+                }
+                excess -= static_cast<excess_t>(2 * __builtin_popcountll(word) - 64);
+            }
+            return false;
+        }
+
+        // same as prefix_matches_avx2, with the 64 steps of word in a
+        // single register
+        __attribute__((target("avx512f,avx512bw,popcnt")))
+        inline uint64_t prefix_matches_avx512(uint64_t word, int target)
+        {
+            const __m512i zero = _mm512_setzero_si512();
+            __m512i v = _mm512_mask_blend_epi8(__mmask64(word), _mm512_set1_epi8(1), _mm512_set1_epi8(-1));
+            v = _mm512_add_epi8(v, _mm512_bslli_epi128(v, 1));
+            v = _mm512_add_epi8(v, _mm512_bslli_epi128(v, 2));
+            v = _mm512_add_epi8(v, _mm512_bslli_epi128(v, 4));
+            v = _mm512_add_epi8(v, _mm512_bslli_epi128(v, 8));
+            // add the sums of the preceding lanes to each lane
+            __m512i lane_sums = _mm512_shuffle_epi8(v, _mm512_set1_epi8(15));
+            lane_sums = _mm512_add_epi8(lane_sums, _mm512_alignr_epi64(lane_sums, zero, 6));
+            lane_sums = _mm512_add_epi8(lane_sums, _mm512_alignr_epi64(lane_sums, zero, 4));
+            v = _mm512_add_epi8(v, _mm512_alignr_epi64(lane_sums, zero, 6));
+            return _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(char(target)));
+        }
+
+        __attribute__((target("avx512f,avx512bw,popcnt")))
+        bool find_close_avx512(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            for (size_t i = 0; i < n; ++i) {
+                assert(excess > 0);
+                uint64_t word = words[i];
+                if (excess <= 64) {
+                    uint64_t matches = prefix_matches_avx512(word, excess);
+                    if (matches) {
+                        ret = i * 64 + uint64_t(__builtin_ctzll(matches));
+                        return true;
+                    }
+                }
+                excess += static_cast<excess_t>(2 * __builtin_popcountll(word) - 64);
+            }
+            return false;
+        }
+
+        __attribute__((target("avx512f,avx512bw,popcnt")))
+        bool find_open_avx512(uint64_t const* words, size_t n, excess_t excess, uint64_t& ret)
+        {
+            for (size_t i = n; i-- > 0; ) {
+                assert(excess > 0);
+                uint64_t word = words[i];
+                if (excess <= 64) {
+                    uint64_t matches = prefix_matches_avx512(broadword::reverse_bits(word), -excess);
+                    if (matches) {
+                        ret = i * 64 + 63 - uint64_t(__builtin_ctzll(matches));
+                        return true;
+                    }
+                }
+                excess -= static_cast<excess_t>(2 * __builtin_popcountll(word) - 64);
+            }
+            return false;
+        }
+
+#endif /* SUCCINCT_HAS_CPU_DISPATCH */
+
+        std::vector<bp_kernels> detect_bp_kernels()
+        {
+            std::vector<bp_kernels> ret;
+            bp_kernels generic = {"generic", find_close_generic, find_open_generic};
+            ret.push_back(generic);
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+            intrinsics::cpu_features const& features = intrinsics::get_cpu_features();
+            if (features.popcnt && features.avx2) {
+                bp_kernels k = {"avx2", find_close_avx2, find_open_avx2};
+                ret.push_back(k);
+            }
+            if (features.popcnt && features.avx512bw) {
+                bp_kernels k = {"avx512", find_close_avx512, find_open_avx512};
+                ret.push_back(k);
+            }
+#endif
+            return ret;
+        }
+    }
+
+    std::vector<bp_kernels> const& supported_bp_kernels()
+    {
+        static const std::vector<bp_kernels> kernels = detect_bp_kernels();
+        return kernels;
     }
 
-    inline bool bp_vector::find_close_in_block(uint64_t block_offset, bp_vector::excess_t excess, uint64_t start, uint64_t& ret) const {
+    namespace {
+        bp_kernels const* default_simd_bp_kernels()
+        {
+            std::vector<bp_kernels> const& kernels = supported_bp_kernels();
+            for (size_t i = 0; i < kernels.size(); ++i) {
+                if (strcmp(kernels[i].name, "avx512") == 0) {
+                    return &kernels[i];
+                }
+            }
+            return 0;
+        }
+    }
+
+    namespace detail {
+        bp_kernels const* bp_simd_kernels = default_simd_bp_kernels();
+    }
+
+    bp_kernels const& active_bp_kernels()
+    {
+        return detail::bp_simd_kernels
+            ? *detail::bp_simd_kernels
+            : supported_bp_kernels().front();
+    }
+
+    scoped_bp_kernels::scoped_bp_kernels(bp_kernels const& kernels)
+        : m_kernels(kernels)
+        , m_saved(detail::bp_simd_kernels)
+    {
+        // the generic kernels run inline
+        bool generic = kernels.find_close == supported_bp_kernels().front().find_close;
+        detail::bp_simd_kernels = generic ? 0 : &m_kernels;
+    }
+
+    scoped_bp_kernels::~scoped_bp_kernels()
+    {
+        detail::bp_simd_kernels = m_saved;
+    }
+
+    template <typename RsBitVector>
+    inline bool basic_bp_vector<RsBitVector>::find_close_in_block(uint64_t block_offset, excess_t excess, uint64_t start, uint64_t& ret) const {
         if (excess > excess_t((bp_block_size - start) * 64)) {
             return false;
         }
         assert(excess > 0);
-        for (uint64_t sub_block_offset = start; sub_block_offset < bp_block_size; ++sub_block_offset) {
-            uint64_t sub_block = block_offset + sub_block_offset;
-            uint64_t word = m_bits[sub_block];
-            uint64_t byte_counts = broadword::byte_counts(word);
-            assert(excess > 0);
-            if (excess <= 64) {
-                if (find_close_in_word(word, byte_counts, excess, ret)) {
+        // the last block can be partial
+        uint64_t end = std::min(uint64_t(bp_block_size), this->num_words() - block_offset);
+        bp_kernels const* kernels = detail::bp_simd_kernels;
+        if (!kernels) {
+            for (uint64_t sub_block_offset = start; sub_block_offset < end; ++sub_block_offset) {
+                uint64_t sub_block = block_offset + sub_block_offset;
+                uint64_t word = this->word(sub_block);
+                uint64_t byte_counts = broadword::byte_counts(word);
+                assert(excess > 0);
+                if (excess <= 64 && find_close_in_word(word, byte_counts, excess, ret)) {
                     ret += sub_block * 64;
                     return true;
                 }
+                excess += static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
             }
-            excess += static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
+            return false;
+        }
+
+        // the kernels need the words contiguous
+        uint64_t words[bp_block_size];
+        for (uint64_t sub_block_offset = start; sub_block_offset < end; ++sub_block_offset) {
+            words[sub_block_offset] = this->word(block_offset + sub_block_offset);
+        }
+        if (start < end
+            && kernels->find_close(words + start, end - start, excess, ret)) {
+            ret += (block_offset + start) * 64;
+            return true;
         }
         return false;
     }
 
-    uint64_t bp_vector::find_close(uint64_t pos) const
+    template <typename RsBitVector>
+    uint64_t basic_bp_vector<RsBitVector>::find_close(uint64_t pos) const
     {
         assert((*this)[pos]); // check there is an opening parenthesis in pos
         uint64_t ret = -1U;
         // Search in current word
         uint64_t word_pos = (pos + 1) / 64;
         uint64_t shift = (pos + 1) % 64;
-        uint64_t shifted_word = m_bits[word_pos] >> shift;
+        uint64_t shifted_word = this->word(word_pos) >> shift;
         // Pad with "open"
         uint64_t padded_word = shifted_word | (-!!shift & (~0ULL << (64 - shift)));
         uint64_t byte_counts = broadword::byte_counts(padded_word);
@@ -206,29 +483,42 @@ namespace succinct {
         return ret;
     }
 
-    inline bool bp_vector::find_open_in_block(uint64_t block_offset, bp_vector::excess_t excess, uint64_t start, uint64_t& ret) const {
+    template <typename RsBitVector>
+    inline bool basic_bp_vector<RsBitVector>::find_open_in_block(uint64_t block_offset, excess_t excess, uint64_t start, uint64_t& ret) const {
         if (excess > excess_t(start * 64)) {
             return false;
         }
         assert(excess >= 0);
-
-        for (uint64_t sub_block_offset = start - 1; sub_block_offset + 1 > 0; --sub_block_offset) {
-            assert(excess > 0);
-            uint64_t sub_block = block_offset + sub_block_offset;
-            uint64_t word = m_bits[sub_block];
-            uint64_t byte_counts = broadword::byte_counts(word);
-            if (excess <= 64) {
-                if (find_open_in_word(word, byte_counts, excess, ret)) {
+        bp_kernels const* kernels = detail::bp_simd_kernels;
+        if (!kernels) {
+            for (uint64_t sub_block_offset = start; sub_block_offset-- > 0; ) {
+                uint64_t sub_block = block_offset + sub_block_offset;
+                uint64_t word = this->word(sub_block);
+                uint64_t byte_counts = broadword::byte_counts(word);
+                assert(excess > 0);
+                if (excess <= 64 && find_open_in_word(word, byte_counts, excess, ret)) {
                     ret += sub_block * 64;
                     return true;
                 }
+                excess -= static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
             }
-            excess -= static_cast<excess_t>(2 * broadword::bytes_sum(byte_counts) - 64);
+            return false;
+        }
+
+        // the kernels need the words contiguous
+        uint64_t words[bp_block_size];
+        for (uint64_t sub_block_offset = 0; sub_block_offset < start; ++sub_block_offset) {
+            words[sub_block_offset] = this->word(block_offset + sub_block_offset);
+        }
+        if (kernels->find_open(words, start, excess, ret)) {
+            ret += block_offset * 64;
+            return true;
         }
         return false;
     }
 
-    uint64_t bp_vector::find_open(uint64_t pos) const
+    template <typename RsBitVector>
+    uint64_t basic_bp_vector<RsBitVector>::find_open(uint64_t pos) const
     {
         assert(pos);
         uint64_t ret = -1U;
@@ -236,7 +526,7 @@ namespace succinct {
         uint64_t word_pos = (pos / 64);
         uint64_t len = pos % 64;
         // Rest is padded with "close"
-        uint64_t shifted_word = -!!len & (m_bits[word_pos] << (64 - len));
+        uint64_t shifted_word = -!!len & (this->word(word_pos) << (64 - len));
         uint64_t byte_counts = broadword::byte_counts(shifted_word);
 
         excess_t word_exc = 1;
@@ -268,8 +558,9 @@ namespace succinct {
         return ret;
     }
 
+    template <typename RsBitVector>
     template <int direction>
-    inline bool bp_vector::search_block_in_superblock(uint64_t block, excess_t excess, size_t& found_block) const
+    inline bool basic_bp_vector<RsBitVector>::search_block_in_superblock(uint64_t block, excess_t excess, size_t& found_block) const
     {
         size_t superblock = block / superblock_size;
         excess_t superblock_excess = get_block_excess(superblock * superblock_size);
@@ -296,21 +587,25 @@ namespace succinct {
         return false;
     }
 
-    inline bp_vector::excess_t bp_vector::get_block_excess(uint64_t block) const {
+    template <typename RsBitVector>
+    inline typename basic_bp_vector<RsBitVector>::excess_t
+    basic_bp_vector<RsBitVector>::get_block_excess(uint64_t block) const {
         uint64_t sub_block_idx = block * bp_block_size;
         uint64_t block_pos = sub_block_idx * 64;
-        excess_t excess = static_cast<excess_t>(2 * sub_block_rank(sub_block_idx) - block_pos);
+        excess_t excess = static_cast<excess_t>(2 * this->sub_block_rank(sub_block_idx) - block_pos);
         assert(excess >= 0);
         return excess;
     }
 
-    inline bool bp_vector::in_node_range(uint64_t node, excess_t excess) const {
-        assert(m_superblock_excess_min[node] != excess_t(size()));
+    template <typename RsBitVector>
+    inline bool basic_bp_vector<RsBitVector>::in_node_range(uint64_t node, excess_t excess) const {
+        assert(m_superblock_excess_min[node] != excess_t(this->size()));
         return excess >= m_superblock_excess_min[node];
     }
 
+    template <typename RsBitVector>
     template <int direction>
-    inline uint64_t bp_vector::search_min_tree(uint64_t block, excess_t excess) const
+    inline uint64_t basic_bp_vector<RsBitVector>::search_min_tree(uint64_t block, excess_t excess) const
     {
         size_t found_block = -1U;
         if (search_block_in_superblock<direction>(block, excess, found_block)) {
@@ -356,16 +651,18 @@ namespace succinct {
     }
 
 
-    bp_vector::excess_t
-    bp_vector::excess(uint64_t pos) const
+    template <typename RsBitVector>
+    typename basic_bp_vector<RsBitVector>::excess_t
+    basic_bp_vector<RsBitVector>::excess(uint64_t pos) const
     {
-        return static_cast<excess_t>(2 * rank(pos) - pos);
+        return static_cast<excess_t>(2 * this->rank(pos) - pos);
     }
 
+    template <typename RsBitVector>
     void
-    bp_vector::excess_rmq_in_block(uint64_t start, uint64_t end,
-                                   bp_vector::excess_t& exc,
-                                   bp_vector::excess_t& min_exc,
+    basic_bp_vector<RsBitVector>::excess_rmq_in_block(uint64_t start, uint64_t end,
+                                                     excess_t& exc,
+                                                     excess_t& min_exc,
                                    uint64_t& min_exc_idx) const
     {
         assert(start <= end);
@@ -373,14 +670,15 @@ namespace succinct {
 
         assert((start / bp_block_size) == ((end - 1) / bp_block_size));
         for (size_t w = start; w < end; ++w) {
-            excess_rmq_in_word(m_bits[w], exc, w * 64,
+            excess_rmq_in_word(this->word(w), exc, w * 64,
                                min_exc, min_exc_idx);
         }
     }
 
+    template <typename RsBitVector>
     void
-    bp_vector::excess_rmq_in_superblock(uint64_t block_start, uint64_t block_end,
-                                        bp_vector::excess_t& block_min_exc,
+    basic_bp_vector<RsBitVector>::excess_rmq_in_superblock(uint64_t block_start, uint64_t block_end,
+                                                          excess_t& block_min_exc,
                                         uint64_t& block_min_idx) const
     {
         assert(block_start <= block_end);
@@ -400,9 +698,10 @@ namespace succinct {
     }
 
 
+    template <typename RsBitVector>
     void
-    bp_vector::find_min_superblock(uint64_t superblock_start, uint64_t superblock_end,
-                                   bp_vector::excess_t& superblock_min_exc,
+    basic_bp_vector<RsBitVector>::find_min_superblock(uint64_t superblock_start, uint64_t superblock_end,
+                                                     excess_t& superblock_min_exc,
                                    uint64_t& superblock_min_idx) const {
 
         if (superblock_start == superblock_end) return;
@@ -505,7 +804,8 @@ namespace succinct {
         }
     }
 
-    uint64_t bp_vector::excess_rmq(uint64_t a, uint64_t b, excess_t& min_exc) const
+    template <typename RsBitVector>
+    uint64_t basic_bp_vector<RsBitVector>::excess_rmq(uint64_t a, uint64_t b, excess_t& min_exc) const
     {
         assert(a <= b);
 
@@ -524,7 +824,7 @@ namespace succinct {
 
         // search in word_a
         uint64_t shift_a = a % 64;
-        uint64_t shifted_word_a = m_bits[word_a_idx] >> shift_a;
+        uint64_t shifted_word_a = this->word(word_a_idx) >> shift_a;
         uint64_t subword_len_a = std::min(64 - shift_a, range_len);
 
         uint64_t padded_word_a =
@@ -608,7 +908,7 @@ namespace succinct {
         }
 
         // search in word_b
-        uint64_t word_b = m_bits[word_b_idx];
+        uint64_t word_b = this->word(word_b_idx);
         uint64_t offset_b = b % 64;
         uint64_t padded_word_b =
             (offset_b == 0)
@@ -625,13 +925,14 @@ namespace succinct {
     }
 
 
-    void bp_vector::build_min_tree()
+    template <typename RsBitVector>
+    void basic_bp_vector<RsBitVector>::build_min_tree()
     {
-        if (!size()) return;
+        if (!this->size()) return;
 
         std::vector<block_min_excess_t> block_excess_min;
         excess_t cur_block_min = 0, cur_superblock_excess = 0;
-        for (uint64_t sub_block = 0; sub_block < m_bits.size(); ++sub_block) {
+        for (uint64_t sub_block = 0; sub_block < this->num_words(); ++sub_block) {
             if (sub_block % bp_block_size == 0) {
                 if (sub_block % (bp_block_size * superblock_size) == 0) {
                     cur_superblock_excess = 0;
@@ -643,12 +944,12 @@ namespace succinct {
                     cur_block_min = cur_superblock_excess;
                 }
             }
-            uint64_t word = m_bits[sub_block];
+            uint64_t word = this->word(sub_block);
             uint64_t mask = 1ULL;
             // for last block stop at bit boundary
             uint64_t n_bits =
-                (sub_block == m_bits.size() - 1 && size() % 64)
-                ? size() % 64
+                (sub_block == this->num_words() - 1 && this->size() % 64)
+                ? this->size() % 64
                 : 64;
             // XXX(ot) use tables.m_fwd_{min,max}
             for (uint64_t i = 0; i < n_bits; ++i) {
@@ -662,7 +963,7 @@ namespace succinct {
         assert(cur_block_min <= std::numeric_limits<block_min_excess_t>::max());
         block_excess_min.push_back((block_min_excess_t)cur_block_min);
 
-        size_t n_blocks = util::ceil_div(data().size(), bp_block_size);
+        size_t n_blocks = util::ceil_div(this->num_words(), bp_block_size);
         assert(n_blocks == block_excess_min.size());
 
         size_t n_superblocks = (n_blocks + superblock_size - 1) / superblock_size;
@@ -673,11 +974,13 @@ namespace succinct {
         m_internal_nodes = n_complete_leaves;
         size_t treesize = m_internal_nodes + n_superblocks;
 
-        std::vector<excess_t> superblock_excess_min(treesize);
+        std::vector<excess_t> superblock_excess_min;
+        mapper::reserve_padded(superblock_excess_min, treesize);
+        superblock_excess_min.resize(treesize);
 
         // Fill in the leaves of the tree
         for (size_t superblock = 0; superblock < n_superblocks; ++superblock) {
-            excess_t cur_super_min = static_cast<excess_t>(size());
+            excess_t cur_super_min = static_cast<excess_t>(this->size());
             excess_t superblock_excess = get_block_excess(superblock * superblock_size);
 
             for (size_t block = superblock * superblock_size;
@@ -685,7 +988,7 @@ namespace succinct {
                  ++block) {
                 cur_super_min = std::min(cur_super_min, superblock_excess + block_excess_min[block]);
             }
-            assert(cur_super_min >= 0 && cur_super_min < excess_t(size()));
+            assert(cur_super_min >= 0 && cur_super_min < excess_t(this->size()));
 
             superblock_excess_min[m_internal_nodes + superblock] = cur_super_min;
         }
@@ -693,7 +996,7 @@ namespace succinct {
         // fill in the internal nodes with past-the-boundary values
         // (they will also serve as sentinels in debug)
         for (size_t node = 0; node < m_internal_nodes; ++node) {
-            superblock_excess_min[node] = static_cast<excess_t>(size());
+            superblock_excess_min[node] = static_cast<excess_t>(this->size());
         }
 
         // Fill bottom-up the other layers: each node updates the parent
@@ -706,4 +1009,8 @@ namespace succinct {
         m_block_excess_min.steal(block_excess_min);
         m_superblock_excess_min.steal(superblock_excess_min);
     }
+
+    template class basic_bp_vector<rs_bit_vector>;
+    template class basic_bp_vector<interleaved_rs_bit_vector>;
+    template class basic_bp_vector<poppy_bit_vector>;
 }
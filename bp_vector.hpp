@@ -7,36 +7,109 @@
 #include <boost/range.hpp>
 
 #include "rs_bit_vector.hpp"
+#include "interleaved_rs_bit_vector.hpp"
+#include "poppy_bit_vector.hpp"
 
 namespace succinct {
 
-    class bp_vector : public rs_bit_vector {
+    // Kernels that search the excess of a few consecutive words of
+    // parentheses (1 is open), used by find_close and find_open on
+    // the words of a bp block. As with broadword::bulk_kernels, the
+    // implementations supported by the running CPU are detected at
+    // runtime (see bp_vector.cpp).
+    struct bp_kernels {
+        const char* name;
+        // first position p in the bits of words[0, n) such that
+        // excess plus the excess of the bits [0, p] is 0; excess > 0
+        bool (*find_close)(uint64_t const* words, size_t n, int32_t excess, uint64_t& ret);
+        // last position p in the bits of words[0, n) such that excess
+        // minus the excess of the bits [p, 64 * n) is 0; excess > 0
+        bool (*find_open)(uint64_t const* words, size_t n, int32_t excess, uint64_t& ret);
+    };
+
+    // kernel sets supported by the running CPU, the generic one first
+    std::vector<bp_kernels> const& supported_bp_kernels();
+
+    namespace detail {
+        // The SIMD kernels used by basic_bp_vector, chosen at static
+        // initialization: avx512 when supported, otherwise none, since
+        // the AVX2 kernels are slower than the tables (see
+        // perftest_bp_vector). When null, the generic search runs
+        // inline on the words in place.
+        extern bp_kernels const* bp_simd_kernels;
+    }
+
+    // kernels used by basic_bp_vector
+    bp_kernels const& active_bp_kernels();
+
+    // Replaces the kernels used by basic_bp_vector while in scope, to
+    // compare the implementations in tests and benchmarks; no query
+    // may run concurrently
+    class scoped_bp_kernels : boost::noncopyable {
+    public:
+        explicit scoped_bp_kernels(bp_kernels const& kernels);
+        ~scoped_bp_kernels();
+
+    private:
+        bp_kernels m_kernels;
+        bp_kernels const* m_saved;
+    };
+
+    // Balanced parentheses on top of a rank/select bit vector, which
+    // must expose the protected num_words(), word(i) and
+    // sub_block_rank(i) accessors (see rs_bit_vector and
+    // interleaved_rs_bit_vector). The supported instantiations are
+    // listed at the end of bp_vector.cpp.
+    template <typename RsBitVector>
+    class basic_bp_vector : public RsBitVector {
     public:
-        bp_vector()
-            : rs_bit_vector()
+        typedef RsBitVector rs_bit_vector_type;
+
+        basic_bp_vector()
+            : RsBitVector()
+            , m_internal_nodes(0)
         {}
 
         template <class Range>
-        bp_vector(Range const& from,
-                  bool with_select_hints = false,
-                  bool with_select0_hints = false)
-            : rs_bit_vector(from, with_select_hints, with_select0_hints)
+        basic_bp_vector(Range const& from,
+                        bool with_select_hints = false,
+                        bool with_select0_hints = false)
+            : RsBitVector(from, with_select_hints, with_select0_hints)
+        {
+            build_min_tree();
+        }
+
+        template <class Range>
+        basic_bp_vector(Range const& from,
+                        select_index_type select_index,
+                        select_index_type select0_index = select_index_none)
+            : RsBitVector(from, select_index, select0_index)
         {
             build_min_tree();
         }
 
         template <typename Visitor>
         void map(Visitor& visit) {
-            rs_bit_vector::map(visit);
+            RsBitVector::map(visit);
             visit
                 (m_internal_nodes, "m_internal_nodes")
-                (m_block_excess_min, "m_block_excess_min")
-                (m_superblock_excess_min, "m_superblock_excess_min")
+                (mapper::derived(m_block_excess_min), "m_block_excess_min")
+                (mapper::derived(m_superblock_excess_min), "m_superblock_excess_min")
                 ;
         }
 
-        void swap(bp_vector& other) {
-            rs_bit_vector::swap(other);
+        void rebuild_derived() {
+            // the rank/select indices first, the min tree uses them
+            mapper::rebuild_derived(static_cast<RsBitVector&>(*this));
+            if (m_block_excess_min.omitted() || m_superblock_excess_min.omitted()) {
+                build_min_tree();
+            }
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(basic_bp_vector)
+
+        void swap(basic_bp_vector& other) {
+            RsBitVector::swap(other);
             std::swap(m_internal_nodes, other.m_internal_nodes);
             m_block_excess_min.swap(other.m_block_excess_min);
             m_superblock_excess_min.swap(other.m_superblock_excess_min);
@@ -72,14 +145,14 @@ namespace succinct {
                                 uint64_t max_sub_blocks, uint64_t& ret) const;
 
         void excess_rmq_in_block(uint64_t start, uint64_t end,
-                                 bp_vector::excess_t& exc,
-                                 bp_vector::excess_t& min_exc,
+                                 excess_t& exc,
+                                 excess_t& min_exc,
                                  uint64_t& min_exc_idx) const;
         void excess_rmq_in_superblock(uint64_t block_start, uint64_t block_end,
-                                      bp_vector::excess_t& block_min_exc,
+                                      excess_t& block_min_exc,
                                       uint64_t& block_min_idx) const;
         void find_min_superblock(uint64_t superblock_start, uint64_t superblock_end,
-                                 bp_vector::excess_t& superblock_min_exc,
+                                 excess_t& superblock_min_exc,
                                  uint64_t& superblock_min_idx) const;
 
 
@@ -98,4 +171,8 @@ namespace succinct {
         mapper::mappable_vector<block_min_excess_t> m_block_excess_min;
         mapper::mappable_vector<excess_t> m_superblock_excess_min;
     };
+
+    typedef basic_bp_vector<rs_bit_vector> bp_vector;
+    typedef basic_bp_vector<interleaved_rs_bit_vector> interleaved_bp_vector;
+    typedef basic_bp_vector<poppy_bit_vector> poppy_bp_vector;
 }
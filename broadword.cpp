@@ -0,0 +1,400 @@
+#include <algorithm>
+
+#include "broadword.hpp"
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+// GCC 12 reports the _mm512_undefined_* placeholders of the AVX-512
+// headers as uninitialized (GCC bug 105593)
+#if !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace succinct { namespace broadword {
+
+    namespace {
+
+        uint64_t popcount_sum_generic(uint64_t const* data, size_t n)
+        {
+            uint64_t ret = 0;
+            for (size_t i = 0; i < n; ++i) {
+                ret += popcount(data[i]);
+            }
+            return ret;
+        }
+
+        void popcount_each_generic(uint64_t const* data, size_t n, uint8_t* counts)
+        {
+            for (size_t i = 0; i < n; ++i) {
+                counts[i] = uint8_t(popcount(data[i]));
+            }
+        }
+
+        inline uint64_t unpack_one(uint64_t const* data, size_t num_words,
+                                   uint64_t pos, uint64_t mask)
+        {
+            uint64_t word_idx = pos / 64;
+            uint64_t shift = pos % 64;
+            uint64_t w = data[word_idx] >> shift;
+            if (shift && word_idx + 1 < num_words) {
+                w |= data[word_idx + 1] << (64 - shift);
+            }
+            return w & mask;
+        }
+
+        void unpack_bits_generic(uint64_t const* data, size_t num_words,
+                                 uint64_t pos, size_t width, size_t n, uint64_t* out)
+        {
+            assert(width < 64);
+            uint64_t mask = (uint64_t(1) << width) - 1;
+            for (size_t i = 0; i < n; ++i, pos += width) {
+                out[i] = unpack_one(data, num_words, pos, mask);
+            }
+        }
+
+        void ones_positions_generic(uint64_t const* data, uint64_t pos, size_t n, uint64_t* out)
+        {
+            if (!n) return;
+            uint64_t word_idx = pos / 64;
+            uint64_t word = data[word_idx] & (uint64_t(-1) << (pos % 64));
+            uint64_t* end = out + n;
+            while (true) {
+                while (word) {
+                    *out = word_idx * 64 + lsb(word);
+                    word &= word - 1;
+                    if (++out == end) return;
+                }
+                word = data[++word_idx];
+            }
+        }
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+
+        // positions of the ones of each byte, packed in the bytes of
+        // a word
+        struct byte_positions {
+            byte_positions()
+            {
+                for (uint64_t b = 0; b < 256; ++b) {
+                    uint64_t entry = 0;
+                    uint64_t count = 0;
+                    for (uint64_t j = 0; j < 8; ++j) {
+                        if (b >> j & 1) {
+                            entry |= j << (8 * count++);
+                        }
+                    }
+                    table[b] = entry;
+                }
+            }
+
+            uint64_t table[256];
+        };
+
+        uint64_t const* byte_positions_table()
+        {
+            static const byte_positions positions;
+            return positions.table;
+        }
+
+        __attribute__((target("popcnt")))
+        uint64_t popcount_sum_popcnt(uint64_t const* data, size_t n)
+        {
+            uint64_t ret = 0;
+            for (size_t i = 0; i < n; ++i) {
+                ret += uint64_t(__builtin_popcountll(data[i]));
+            }
+            return ret;
+        }
+
+        __attribute__((target("popcnt")))
+        void popcount_each_popcnt(uint64_t const* data, size_t n, uint8_t* counts)
+        {
+            for (size_t i = 0; i < n; ++i) {
+                counts[i] = uint8_t(__builtin_popcountll(data[i]));
+            }
+        }
+
+        // Nibble-table popcount of each byte (Mula et al.), the byte
+        // counts are then summed in each 64-bit lane with psadbw
+        __attribute__((target("avx2,popcnt")))
+        inline __m256i popcount_lanes_avx2(__m256i v)
+        {
+            const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low_mask = _mm256_set1_epi8(0x0f);
+            __m256i lo = _mm256_and_si256(v, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            __m256i byte_counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                                  _mm256_shuffle_epi8(lookup, hi));
+            return _mm256_sad_epu8(byte_counts, _mm256_setzero_si256());
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        uint64_t popcount_sum_avx2(uint64_t const* data, size_t n)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+                acc = _mm256_add_epi64(acc, popcount_lanes_avx2(v));
+            }
+            uint64_t lanes[4];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+            uint64_t ret = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < n; ++i) {
+                ret += uint64_t(__builtin_popcountll(data[i]));
+            }
+            return ret;
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        void popcount_each_avx2(uint64_t const* data, size_t n, uint8_t* counts)
+        {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+                uint64_t lanes[4];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), popcount_lanes_avx2(v));
+                counts[i] = uint8_t(lanes[0]);
+                counts[i + 1] = uint8_t(lanes[1]);
+                counts[i + 2] = uint8_t(lanes[2]);
+                counts[i + 3] = uint8_t(lanes[3]);
+            }
+            for (; i < n; ++i) {
+                counts[i] = uint8_t(__builtin_popcountll(data[i]));
+            }
+        }
+
+        __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+        uint64_t popcount_sum_avx512(uint64_t const* data, size_t n)
+        {
+            __m512i acc = _mm512_setzero_si512();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i v = _mm512_loadu_si512(data + i);
+                acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+            }
+            uint64_t ret = uint64_t(_mm512_reduce_add_epi64(acc));
+            for (; i < n; ++i) {
+                ret += uint64_t(__builtin_popcountll(data[i]));
+            }
+            return ret;
+        }
+
+        __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+        void popcount_each_avx512(uint64_t const* data, size_t n, uint8_t* counts)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m512i v = _mm512_loadu_si512(data + i);
+                // truncate the 8 lane counts to bytes
+                __m128i c = _mm512_cvtepi64_epi8(_mm512_popcnt_epi64(v));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(counts + i), c);
+            }
+            for (; i < n; ++i) {
+                counts[i] = uint8_t(__builtin_popcountll(data[i]));
+            }
+        }
+
+        // Each lane gathers the two words that contain its value and
+        // funnel-shifts them; variable shifts by 64 give 0, so the
+        // word-aligned case needs no special handling. The lanes are
+        // used only while the second word is inside the array.
+        __attribute__((target("avx2,popcnt")))
+        void unpack_bits_avx2(uint64_t const* data, size_t num_words,
+                              uint64_t pos, size_t width, size_t n, uint64_t* out)
+        {
+            assert(width < 64);
+            uint64_t mask = (uint64_t(1) << width) - 1;
+            long long const* base = reinterpret_cast<long long const*>(data);
+            const __m256i v_mask = _mm256_set1_epi64x(int64_t(mask));
+            const __m256i v_63 = _mm256_set1_epi64x(63);
+            const __m256i v_64 = _mm256_set1_epi64x(64);
+            const __m256i v_one = _mm256_set1_epi64x(1);
+            const __m256i v_step = _mm256_set1_epi64x(int64_t(4 * width));
+            __m256i v_pos = _mm256_setr_epi64x(int64_t(pos), int64_t(pos + width),
+                                               int64_t(pos + 2 * width), int64_t(pos + 3 * width));
+            size_t i = 0;
+            for (; i + 4 <= n && (pos + (i + 4) * width) / 64 + 1 < num_words; i += 4) {
+                __m256i word_idx = _mm256_srli_epi64(v_pos, 6);
+                __m256i shift = _mm256_and_si256(v_pos, v_63);
+                __m256i lo = _mm256_i64gather_epi64(base, word_idx, 8);
+                __m256i hi = _mm256_i64gather_epi64(base, _mm256_add_epi64(word_idx, v_one), 8);
+                __m256i w = _mm256_or_si256(_mm256_srlv_epi64(lo, shift),
+                                            _mm256_sllv_epi64(hi, _mm256_sub_epi64(v_64, shift)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_and_si256(w, v_mask));
+                v_pos = _mm256_add_epi64(v_pos, v_step);
+            }
+            for (; i < n; ++i) {
+                out[i] = unpack_one(data, num_words, pos + i * width, mask);
+            }
+        }
+
+        __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+        void unpack_bits_avx512(uint64_t const* data, size_t num_words,
+                                uint64_t pos, size_t width, size_t n, uint64_t* out)
+        {
+            assert(width < 64);
+            uint64_t mask = (uint64_t(1) << width) - 1;
+            const __m512i v_mask = _mm512_set1_epi64(int64_t(mask));
+            const __m512i v_63 = _mm512_set1_epi64(63);
+            const __m512i v_64 = _mm512_set1_epi64(64);
+            const __m512i v_one = _mm512_set1_epi64(1);
+            const __m512i v_step = _mm512_set1_epi64(int64_t(8 * width));
+            __m512i v_pos = _mm512_setr_epi64(int64_t(pos), int64_t(pos + width),
+                                              int64_t(pos + 2 * width), int64_t(pos + 3 * width),
+                                              int64_t(pos + 4 * width), int64_t(pos + 5 * width),
+                                              int64_t(pos + 6 * width), int64_t(pos + 7 * width));
+            size_t i = 0;
+            for (; i + 8 <= n && (pos + (i + 8) * width) / 64 + 1 < num_words; i += 8) {
+                __m512i word_idx = _mm512_srli_epi64(v_pos, 6);
+                __m512i shift = _mm512_and_si512(v_pos, v_63);
+                __m512i lo = _mm512_i64gather_epi64(word_idx, data, 8);
+                __m512i hi = _mm512_i64gather_epi64(_mm512_add_epi64(word_idx, v_one), data, 8);
+                __m512i w = _mm512_or_si512(_mm512_srlv_epi64(lo, shift),
+                                            _mm512_sllv_epi64(hi, _mm512_sub_epi64(v_64, shift)));
+                _mm512_storeu_si512(out + i, _mm512_and_si512(w, v_mask));
+                v_pos = _mm512_add_epi64(v_pos, v_step);
+            }
+            for (; i < n; ++i) {
+                out[i] = unpack_one(data, num_words, pos + i * width, mask);
+            }
+        }
+
+        // The positions of the ones of each byte are expanded from
+        // byte_positions_table and stored unconditionally, advancing
+        // the output by the byte's popcount; this is done while a
+        // whole byte fits in the output, the rest is left to the
+        // generic version.
+        __attribute__((target("avx2,popcnt")))
+        void ones_positions_avx2(uint64_t const* data, uint64_t pos, size_t n, uint64_t* out)
+        {
+            uint64_t const* table = byte_positions_table();
+            uint64_t* end = out + n;
+            uint64_t word_idx = pos / 64;
+            uint64_t word = data[word_idx] & (uint64_t(-1) << (pos % 64));
+            while (true) {
+                for (uint64_t b = 0; b < 64; b += 8) {
+                    if (end - out < 8) {
+                        ones_positions_generic(data, std::max(pos, word_idx * 64 + b),
+                                               size_t(end - out), out);
+                        return;
+                    }
+                    uint64_t byte = word >> b & 0xFF;
+                    __m128i positions = _mm_cvtsi64_si128(int64_t(table[byte]));
+                    __m256i base = _mm256_set1_epi64x(int64_t(word_idx * 64 + b));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                                        _mm256_add_epi64(_mm256_cvtepu8_epi64(positions), base));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4),
+                                        _mm256_add_epi64(_mm256_cvtepu8_epi64(_mm_srli_si128(positions, 4)), base));
+                    out += __builtin_popcountll(byte);
+                }
+                if (out == end) return;
+                word = data[++word_idx];
+            }
+        }
+
+        __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+        void ones_positions_avx512(uint64_t const* data, uint64_t pos, size_t n, uint64_t* out)
+        {
+            uint64_t const* table = byte_positions_table();
+            uint64_t* end = out + n;
+            uint64_t word_idx = pos / 64;
+            uint64_t word = data[word_idx] & (uint64_t(-1) << (pos % 64));
+            while (true) {
+                for (uint64_t b = 0; b < 64; b += 8) {
+                    if (end - out < 8) {
+                        ones_positions_generic(data, std::max(pos, word_idx * 64 + b),
+                                               size_t(end - out), out);
+                        return;
+                    }
+                    uint64_t byte = word >> b & 0xFF;
+                    __m512i positions = _mm512_cvtepu8_epi64(_mm_cvtsi64_si128(int64_t(table[byte])));
+                    __m512i base = _mm512_set1_epi64(int64_t(word_idx * 64 + b));
+                    _mm512_storeu_si512(out, _mm512_add_epi64(positions, base));
+                    out += __builtin_popcountll(byte);
+                }
+                if (out == end) return;
+                word = data[++word_idx];
+            }
+        }
+
+        __attribute__((target("bmi,bmi2")))
+        uint64_t select_in_word_bmi2(uint64_t x, uint64_t k)
+        {
+            return uint64_t(_tzcnt_u64(_pdep_u64(uint64_t(1) << k, x)));
+        }
+
+#endif /* SUCCINCT_HAS_CPU_DISPATCH */
+
+        std::vector<select_kernel> detect_select_kernels()
+        {
+            std::vector<select_kernel> ret;
+            select_kernel generic = {"broadword", select_in_word_broadword};
+            ret.push_back(generic);
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+            intrinsics::cpu_features const& features = intrinsics::get_cpu_features();
+            if (features.bmi2) {
+                select_kernel k = {"bmi2", select_in_word_bmi2};
+                ret.push_back(k);
+            }
+#endif
+            return ret;
+        }
+
+        std::vector<bulk_kernels> detect_bulk_kernels()
+        {
+            std::vector<bulk_kernels> ret;
+            bulk_kernels generic = {"generic", popcount_sum_generic, popcount_each_generic,
+                                    unpack_bits_generic, ones_positions_generic};
+            ret.push_back(generic);
+
+#if SUCCINCT_HAS_CPU_DISPATCH
+            intrinsics::cpu_features const& features = intrinsics::get_cpu_features();
+            if (features.popcnt) {
+                bulk_kernels k = {"popcnt", popcount_sum_popcnt, popcount_each_popcnt,
+                                  unpack_bits_generic, ones_positions_generic};
+                ret.push_back(k);
+            }
+            if (features.popcnt && features.avx2) {
+                bulk_kernels k = {"avx2", popcount_sum_avx2, popcount_each_avx2,
+                                  unpack_bits_avx2, ones_positions_avx2};
+                ret.push_back(k);
+            }
+            if (features.popcnt && features.avx512_vpopcntdq) {
+                bulk_kernels k = {"avx512", popcount_sum_avx512, popcount_each_avx512,
+                                  unpack_bits_avx512, ones_positions_avx512};
+                ret.push_back(k);
+            }
+#endif
+            return ret;
+        }
+    }
+
+    std::vector<select_kernel> const& supported_select_kernels()
+    {
+        static const std::vector<select_kernel> kernels = detect_select_kernels();
+        return kernels;
+    }
+
+    namespace detail {
+        const select_in_word_fn select_in_word_pdep =
+            supported_select_kernels().size() > 1
+            ? supported_select_kernels().back().select_in_word
+            : 0;
+    }
+
+    std::vector<bulk_kernels> const& supported_bulk_kernels()
+    {
+        static const std::vector<bulk_kernels> kernels = detect_bulk_kernels();
+        return kernels;
+    }
+
+}}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cassert>
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
 #include "intrinsics.hpp"
 #include "tables.hpp"
 
@@ -83,10 +86,9 @@ namespace succinct { namespace broadword {
         return reverse_bytes(x);
     }
 
-    inline uint64_t select_in_word(const uint64_t x, const uint64_t k)
+    inline uint64_t select_in_word_broadword(const uint64_t x, const uint64_t k)
     {
         assert(k < popcount(x));
-
         uint64_t byte_sums = byte_counts(x) * ones_step_8;
 
         const uint64_t k_step_8 = k * ones_step_8;
@@ -100,6 +102,91 @@ namespace succinct { namespace broadword {
         return place + tables::select_in_byte[((x >> place) & 0xFF ) | (byte_rank << 8)];
     }
 
+    // select_in_word uses PDEP (BMI2) when the running CPU supports
+    // it, as it is much faster than the broadword version even
+    // behind an indirect call; the pointer is bound once, at static
+    // initialization, and the broadword version stays inline on the
+    // other CPUs. popcount is instead selected at compile time
+    // (SUCCINCT_USE_POPCNT): behind an indirect call POPCNT costs as
+    // much as the inlined broadword popcount, so dispatching it would
+    // only pay off by cloning whole query paths.
+    typedef uint64_t (*select_in_word_fn)(uint64_t x, uint64_t k);
+
+    struct select_kernel {
+        const char* name;
+        select_in_word_fn select_in_word;
+    };
+
+    // select_in_word implementations supported by the running CPU,
+    // the best one last
+    std::vector<select_kernel> const& supported_select_kernels();
+
+    namespace detail {
+        // the PDEP select_in_word if the CPU supports it, otherwise
+        // (and before static initialization) null; see broadword.cpp
+        extern const select_in_word_fn select_in_word_pdep;
+    }
+
+    inline uint64_t select_in_word(const uint64_t x, const uint64_t k)
+    {
+        assert(k < popcount(x));
+#if SUCCINCT_HAS_CPU_DISPATCH
+        if (detail::select_in_word_pdep) {
+            return detail::select_in_word_pdep(x, k);
+        }
+#endif
+        return select_in_word_broadword(x, k);
+    }
+
+    // Kernels that work on whole arrays of words, used in index
+    // construction and bulk decoding. All the implementations
+    // supported by the running CPU are selected at runtime (see
+    // broadword.cpp), as for select_in_word.
+    struct bulk_kernels {
+        const char* name;
+        // total number of ones in data[0, n)
+        uint64_t (*popcount_sum)(uint64_t const* data, size_t n);
+        // counts[i] = popcount(data[i]) for i in [0, n)
+        void (*popcount_each)(uint64_t const* data, size_t n, uint8_t* counts);
+        // out[i] = the width bits at position pos + i * width of the
+        // bit array data[0, num_words), for i in [0, n); width < 64
+        void (*unpack_bits)(uint64_t const* data, size_t num_words,
+                            uint64_t pos, size_t width, size_t n, uint64_t* out);
+        // out[i] = position of the i-th one at or after position pos
+        // of the bit array data, for i in [0, n); the ones must exist
+        void (*ones_positions)(uint64_t const* data, uint64_t pos, size_t n, uint64_t* out);
+    };
+
+    // kernel sets supported by the running CPU, the best one last
+    std::vector<bulk_kernels> const& supported_bulk_kernels();
+
+    inline bulk_kernels const& best_bulk_kernels()
+    {
+        static const bulk_kernels kernels = supported_bulk_kernels().back();
+        return kernels;
+    }
+
+    inline uint64_t popcount_sum(uint64_t const* data, size_t n)
+    {
+        return best_bulk_kernels().popcount_sum(data, n);
+    }
+
+    inline void popcount_each(uint64_t const* data, size_t n, uint8_t* counts)
+    {
+        best_bulk_kernels().popcount_each(data, n, counts);
+    }
+
+    inline void unpack_bits(uint64_t const* data, size_t num_words,
+                            uint64_t pos, size_t width, size_t n, uint64_t* out)
+    {
+        best_bulk_kernels().unpack_bits(data, num_words, pos, width, n, out);
+    }
+
+    inline void ones_positions(uint64_t const* data, uint64_t pos, size_t n, uint64_t* out)
+    {
+        best_bulk_kernels().ones_positions(data, pos, n, out);
+    }
+
     inline uint64_t same_msb(uint64_t x, uint64_t y)
     {
         return (x ^ y) <= (x & y);
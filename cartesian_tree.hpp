@@ -32,9 +32,14 @@ namespace succinct {
     //
     // - Our data structures have 0-based indices, so the operations
     //   are slightly different from those in the paper
+    //
+    // The BP sequence is stored in BpVector, any instantiation of
+    // basic_bp_vector.
 
-    class cartesian_tree : boost::noncopyable {
+    template <typename BpVector>
+    class basic_cartesian_tree : boost::noncopyable {
     public:
+        typedef BpVector bp_vector_type;
 
         template <typename T>
         class builder {
@@ -74,28 +79,29 @@ namespace succinct {
                 return m_bp;
             }
 
-            friend class cartesian_tree;
+            friend class basic_cartesian_tree;
         private:
             std::vector<T> m_stack;
             bit_vector_builder m_bp;
         };
 
-        cartesian_tree() {}
+        basic_cartesian_tree() {}
 
         template <typename T>
-        cartesian_tree(builder<T>* b)
+        basic_cartesian_tree(builder<T>* b)
         {
-            bp_vector(&b->finalize(), false, true).swap(m_bp);
+            // rmq() performs three select0, use the inventory for them
+            BpVector(&b->finalize(), select_index_none, select_index_inventory).swap(m_bp);
         }
 
         template <typename Range>
-        cartesian_tree(Range const& v)
+        basic_cartesian_tree(Range const& v)
         {
             build_from_range(v, std::less<typename boost::range_value<Range>::type>());
         }
 
         template <typename Range, typename Comparator>
-        cartesian_tree(Range const& v, Comparator const& comp)
+        basic_cartesian_tree(Range const& v, Comparator const& comp)
         {
             build_from_range(v, comp);
         }
@@ -105,7 +111,7 @@ namespace succinct {
         // the rest of the library?
         uint64_t rmq(uint64_t a, uint64_t b) const
         {
-            typedef bp_vector::excess_t excess_t;
+            typedef typename BpVector::excess_t excess_t;
 
             assert(a <= b);
             if (a == b) return a;
@@ -136,7 +142,7 @@ namespace succinct {
             return ret;
         }
 
-        bp_vector const& get_bp() const
+        BpVector const& get_bp() const
         {
             return m_bp;
         }
@@ -153,7 +159,9 @@ namespace succinct {
                 (m_bp, "m_bp");
         }
 
-        void swap(cartesian_tree& other)
+        SUCCINCT_MOVE_BY_SWAP(basic_cartesian_tree)
+
+        void swap(basic_cartesian_tree& other)
         {
             other.m_bp.swap(m_bp);
         }
@@ -172,11 +180,14 @@ namespace succinct {
             for (iter_type it = boost::begin(v); it != boost::end(v); ++it) {
                 b.push_back(*it, comp);
             }
-            cartesian_tree(&b).swap(*this);
+            basic_cartesian_tree(&b).swap(*this);
         }
 
 
-        bp_vector m_bp;
+        BpVector m_bp;
     };
 
+    typedef basic_cartesian_tree<bp_vector> cartesian_tree;
+    typedef basic_cartesian_tree<interleaved_bp_vector> interleaved_cartesian_tree;
+
 }
@@ -1,11 +1,153 @@
 #pragma once
 
 #include "bit_vector.hpp"
+#include "parallel.hpp"
 
 namespace succinct {
 
     namespace detail {
 
+        template <typename WordGetter>
+        class position_enumerator {
+        public:
+            position_enumerator(bit_vector const& bv, uint64_t word_idx)
+                : m_data(&bv.data())
+                , m_size(bv.size())
+                , m_word_idx(word_idx)
+                , m_word(word_idx < m_data->size() ? WordGetter()(*m_data, word_idx) : 0)
+            {}
+
+            // next position whose bit is set in the words returned by
+            // WordGetter, false if past the end of the bit vector
+            inline bool next(uint64_t& pos) {
+                unsigned long l;
+                while (!broadword::lsb(m_word, l)) {
+                    if (++m_word_idx >= m_data->size()) {
+                        return false;
+                    }
+                    m_word = WordGetter()(*m_data, m_word_idx);
+                }
+                pos = m_word_idx * 64 + l;
+                if (pos >= m_size) {
+                    return false;
+                }
+                m_word &= m_word - 1;
+                return true;
+            }
+
+        private:
+            mapper::mappable_vector<uint64_t> const* m_data;
+            uint64_t m_size;
+            uint64_t m_word_idx;
+            uint64_t m_word;
+        };
+
+        template <typename WordGetter>
+        struct position_counter {
+            bit_vector const* bv;
+            std::vector<uint64_t> const* chunk_words;
+            uint64_t* chunk_positions;
+
+            void operator()(size_t chunk) const {
+                mapper::mappable_vector<uint64_t> const& data = bv->data();
+                uint64_t count = 0;
+                for (uint64_t i = (*chunk_words)[chunk]; i < (*chunk_words)[chunk + 1]; ++i) {
+                    uint64_t word = WordGetter()(data, i);
+                    if ((i + 1) * 64 > bv->size()) {
+                        word &= uint64_t(-1) >> ((i + 1) * 64 - bv->size());
+                    }
+                    count += broadword::popcount(word);
+                }
+                chunk_positions[chunk] = count;
+            }
+        };
+
+        template <typename WordGetter, typename Builder>
+        struct position_blocks_worker {
+            bit_vector const* bv;
+            size_t block_size;
+            std::vector<uint64_t> const* chunk_words;
+            std::vector<uint64_t>* chunk_positions; // in: first index, out: end index
+            std::vector<Builder*> const* builders;
+
+            void operator()(size_t chunk) const {
+                Builder& builder = *(*builders)[chunk];
+                uint64_t idx = (*chunk_positions)[chunk];
+                uint64_t end_pos = (*chunk_words)[chunk + 1] * 64;
+                position_enumerator<WordGetter> enumerator(*bv, (*chunk_words)[chunk]);
+                std::vector<uint64_t> cur_block_positions;
+                uint64_t pos;
+                // a block belongs to the chunk that contains its first
+                // position, and can extend past the end of the chunk
+                while (enumerator.next(pos) && pos < end_pos) {
+                    if (idx % block_size) {
+                        ++idx;
+                        continue;
+                    }
+                    cur_block_positions.push_back(pos);
+                    while (cur_block_positions.size() < block_size
+                           && enumerator.next(pos)) {
+                        cur_block_positions.push_back(pos);
+                    }
+                    idx += cur_block_positions.size();
+                    builder.flush(cur_block_positions);
+                }
+                (*chunk_positions)[chunk] = idx;
+            }
+        };
+
+        // Splits the positions of the bits set in the words returned
+        // by WordGetter in blocks of block_size, and calls
+        // builder.flush(positions) on each block in order; flush must
+        // clear positions. builder.reserve(n) is first called with the
+        // number of positions. With parallel::num_threads() > 1, the
+        // bit vector is split in chunks, each one handled by a copy of
+        // builder, and the copies are concatenated in order with
+        // builder.append(copy), so the result does not depend on the
+        // number of threads. Returns the number of positions.
+        template <typename WordGetter, typename Builder>
+        uint64_t build_position_blocks(bit_vector const& bv, size_t block_size, Builder& builder)
+        {
+            uint64_t n_words = bv.data().size();
+            size_t n_chunks = std::max(std::min(parallel::num_threads(), size_t(n_words)), size_t(1));
+            std::vector<uint64_t> chunk_words(n_chunks + 1);
+            for (size_t chunk = 0; chunk <= n_chunks; ++chunk) {
+                chunk_words[chunk] = n_words * chunk / n_chunks;
+            }
+
+            // the positions before each chunk, and the total
+            std::vector<uint64_t> chunk_positions(n_chunks + 1);
+            position_counter<WordGetter> counter;
+            counter.bv = &bv;
+            counter.chunk_words = &chunk_words;
+            counter.chunk_positions = chunk_positions.data() + 1;
+            parallel::for_each(n_chunks, counter);
+            for (size_t chunk = 1; chunk <= n_chunks; ++chunk) {
+                chunk_positions[chunk] += chunk_positions[chunk - 1];
+            }
+            uint64_t n_positions = chunk_positions[n_chunks];
+            builder.reserve(n_positions);
+
+            std::vector<Builder> chunk_builders(n_chunks - 1, builder);
+            std::vector<Builder*> builders(1, &builder);
+            for (size_t chunk = 1; chunk < n_chunks; ++chunk) {
+                builders.push_back(&chunk_builders[chunk - 1]);
+            }
+
+            position_blocks_worker<WordGetter, Builder> worker;
+            worker.bv = &bv;
+            worker.block_size = block_size;
+            worker.chunk_words = &chunk_words;
+            worker.chunk_positions = &chunk_positions;
+            worker.builders = &builders;
+            parallel::for_each(n_chunks, worker);
+
+            for (size_t chunk = 1; chunk < n_chunks; ++chunk) {
+                builder.append(chunk_builders[chunk - 1]);
+            }
+            return n_positions;
+        }
+
         template <typename WordGetter>
         class darray {
         public:
@@ -17,41 +159,12 @@ namespace succinct {
             darray(bit_vector const& bv)
                 : m_positions()
             {
-                mapper::mappable_vector<uint64_t> const& data = bv.data();
-
-                std::vector<uint64_t> cur_block_positions;
-                std::vector<int64_t> block_inventory;
-                std::vector<uint16_t> subblock_inventory;
-                std::vector<uint64_t> overflow_positions;
-
-                for (size_t word_idx = 0; word_idx < data.size(); ++word_idx) {
-                    size_t cur_pos = word_idx * 64;
-                    uint64_t cur_word = WordGetter()(data, word_idx);
-                    unsigned long l;
-                    while (broadword::lsb(cur_word, l)) {
-                        cur_pos += l;
-                        cur_word >>= l;
-                        if (cur_pos >= bv.size()) break;
-
-                        cur_block_positions.push_back(cur_pos);
-
-                        if (cur_block_positions.size() == block_size) {
-                            flush_cur_block(cur_block_positions, block_inventory, subblock_inventory, overflow_positions);
-                        }
-
-                        // can't do >>= l + 1, can be 64
-                        cur_word >>= 1;
-                        cur_pos += 1;
-                        m_positions += 1;
-                    }
-                }
-                if (cur_block_positions.size()) {
-                    flush_cur_block(cur_block_positions, block_inventory, subblock_inventory, overflow_positions);
-                }
+                blocks_builder builder;
+                m_positions = build_position_blocks<WordGetter>(bv, block_size, builder);
 
-                m_block_inventory.steal(block_inventory);
-                m_subblock_inventory.steal(subblock_inventory);
-                m_overflow_positions.steal(overflow_positions);
+                m_block_inventory.steal(builder.block_inventory);
+                m_subblock_inventory.steal(builder.subblock_inventory);
+                m_overflow_positions.steal(builder.overflow_positions);
             }
 
             template <typename Visitor>
@@ -64,6 +177,14 @@ namespace succinct {
                     ;
             }
 
+            // see mappable_vector::omitted()
+            bool omitted() const {
+                return m_block_inventory.omitted() || m_subblock_inventory.omitted()
+                    || m_overflow_positions.omitted();
+            }
+
+            SUCCINCT_MOVE_BY_SWAP(darray)
+
             void swap(darray& other) {
                 std::swap(other.m_positions, m_positions);
                 m_block_inventory.swap(other.m_block_inventory);
@@ -110,6 +231,33 @@ namespace succinct {
 
         protected:
 
+            struct blocks_builder {
+                std::vector<int64_t> block_inventory;
+                std::vector<uint16_t> subblock_inventory;
+                std::vector<uint64_t> overflow_positions;
+
+                void reserve(uint64_t positions) {
+                    mapper::reserve_padded(block_inventory, util::ceil_div(positions, block_size));
+                    mapper::reserve_padded(subblock_inventory, util::ceil_div(positions, subblock_size));
+                }
+
+                void flush(std::vector<uint64_t>& cur_block_positions) {
+                    flush_cur_block(cur_block_positions, block_inventory, subblock_inventory, overflow_positions);
+                }
+
+                void append(blocks_builder const& other) {
+                    int64_t overflow_offset = int64_t(overflow_positions.size());
+                    for (size_t i = 0; i < other.block_inventory.size(); ++i) {
+                        int64_t block_pos = other.block_inventory[i];
+                        block_inventory.push_back(block_pos < 0 ? block_pos - overflow_offset : block_pos);
+                    }
+                    subblock_inventory.insert(subblock_inventory.end(),
+                                              other.subblock_inventory.begin(), other.subblock_inventory.end());
+                    overflow_positions.insert(overflow_positions.end(),
+                                              other.overflow_positions.begin(), other.overflow_positions.end());
+                }
+            };
+
             static void flush_cur_block(std::vector<uint64_t>& cur_block_positions, std::vector<int64_t>& block_inventory,
                                         std::vector<uint16_t>& subblock_inventory, std::vector<uint64_t>& overflow_positions)
             {
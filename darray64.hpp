@@ -45,6 +45,8 @@ namespace succinct {
             m_subblock_inventory.steal(b->subblock_inventory);
         }
 
+        SUCCINCT_MOVE_BY_SWAP(darray64)
+
         void swap(darray64& other)
         {
             std::swap(m_num_ones, other.m_num_ones);
@@ -1,63 +1,183 @@
 #pragma once
 
+#include <algorithm>
+
 #include "bit_vector.hpp"
 #include "darray.hpp"
+#include "poppy_bit_vector.hpp"
 
 namespace succinct {
 
-    class elias_fano {
+    template <typename HighBits> class basic_elias_fano;
+
+    class elias_fano_builder {
     public:
-        elias_fano()
-            : m_size(0)
-        {}
+        elias_fano_builder(uint64_t n, uint64_t m)
+            : m_n(n)
+            , m_m(m)
+            , m_pos(0)
+            , m_last(0)
+            , m_l(uint8_t((m && n / m) ? broadword::msb(n / m) : 0))
+            , m_high_bits((m + 1) + (n >> m_l) + 1)
+        {
+            assert(m_l < 64); // for the correctness of low_mask
+            m_low_bits.reserve(m * m_l);
+        }
 
-        struct elias_fano_builder {
-            elias_fano_builder(uint64_t n, uint64_t m)
-                : m_n(n)
-                , m_m(m)
-                , m_pos(0)
-                , m_last(0)
-                , m_l(uint8_t((m && n / m) ? broadword::msb(n / m) : 0))
-                , m_high_bits((m + 1) + (n >> m_l) + 1)
-            {
-                assert(m_l < 64); // for the correctness of low_mask
-                m_low_bits.reserve(m * m_l);
+        inline void push_back(uint64_t i) {
+            assert(i >= m_last && i <= m_n);
+            m_last = i;
+            uint64_t low_mask = (1ULL << m_l) - 1;
+
+            if (m_l) {
+                m_low_bits.append_bits(i & low_mask, m_l);
             }
+            m_high_bits.set((i >> m_l) + m_pos, 1);
+            ++m_pos;
+            assert(m_pos <= m_m); (void)m_m;
+        }
 
-            inline void push_back(uint64_t i) {
-                assert(i >= m_last && i <= m_n);
-                m_last = i;
-                uint64_t low_mask = (1ULL << m_l) - 1;
+        template <typename HighBits> friend class basic_elias_fano;
+    private:
+        uint64_t m_n;
+        uint64_t m_m;
+        uint64_t m_pos;
+        uint64_t m_last;
+        uint8_t m_l;
+        bit_vector_builder m_high_bits;
+        bit_vector_builder m_low_bits;
+    };
 
-                if (m_l) {
-                    m_low_bits.append_bits(i & low_mask, m_l);
-                }
-                m_high_bits.set((i >> m_l) + m_pos, 1);
-                ++m_pos;
-                assert(m_pos <= m_m); (void)m_m;
+    // High bits representations for basic_elias_fano. A
+    // representation stores the high bits in a bit_vector and
+    // supports select1 and, when built with the rank index, select0;
+    // darray_high_bits is the default, rs_high_bits adapts a
+    // rank/select bit vector such as poppy_bit_vector.
+    class darray_high_bits {
+    public:
+        void build(bit_vector_builder* bvb, bool with_rank_index) {
+            bit_vector bits(bvb);
+            build(&bits, with_rank_index);
+        }
+
+        // takes the bits of bits, which is left empty
+        void build(bit_vector* bits, bool with_rank_index) {
+            bits->swap(m_bits);
+            darray1(m_bits).swap(m_d1);
+            if (with_rank_index) {
+                darray0(m_bits).swap(m_d0);
             }
+        }
 
-            friend class elias_fano;
-        private:
-            uint64_t m_n;
-            uint64_t m_m;
-            uint64_t m_pos;
-            uint64_t m_last;
-            uint8_t m_l;
-            bit_vector_builder m_high_bits;
-            bit_vector_builder m_low_bits;
-        };
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit
+                (m_bits, "m_high_bits")
+                (mapper::derived(m_d1), "m_high_bits_d1")
+                (mapper::derived(m_d0), "m_high_bits_d0")
+                ;
+        }
+
+        void rebuild_derived() {
+            if (m_d1.omitted()) {
+                darray1(m_bits).swap(m_d1);
+            }
+            if (m_d0.omitted()) {
+                darray0(m_bits).swap(m_d0);
+            }
+        }
+
+        void swap(darray_high_bits& other) {
+            m_bits.swap(other.m_bits);
+            m_d1.swap(other.m_d1);
+            m_d0.swap(other.m_d0);
+        }
+
+        inline bit_vector const& bits() const {
+            return m_bits;
+        }
+
+        inline uint64_t num_ones() const {
+            return m_d1.num_positions();
+        }
+
+        inline bool has_select0() const {
+            return m_d0.num_positions() != 0;
+        }
 
+        inline uint64_t select1(uint64_t n) const {
+            return m_d1.select(m_bits, n);
+        }
+
+        inline uint64_t select0(uint64_t n) const {
+            return m_d0.select(m_bits, n);
+        }
+
+    private:
+        bit_vector m_bits;
+        darray1 m_d1;
+        darray0 m_d0;
+    };
+
+    template <typename RsBitVector>
+    class rs_high_bits {
+    public:
+        void build(bit_vector_builder* bvb, bool with_rank_index) {
+            RsBitVector(bvb, true, with_rank_index).swap(m_bits);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit
+                (m_bits, "m_high_bits")
+                ;
+        }
+
+        void swap(rs_high_bits& other) {
+            m_bits.swap(other.m_bits);
+        }
+
+        inline bit_vector const& bits() const {
+            return m_bits;
+        }
+
+        inline uint64_t num_ones() const {
+            return m_bits.num_ones();
+        }
 
-        elias_fano(bit_vector_builder* bvb, bool with_rank_index = true)
+        inline bool has_select0() const {
+            return true;
+        }
+
+        inline uint64_t select1(uint64_t n) const {
+            return m_bits.select(n);
+        }
+
+        inline uint64_t select0(uint64_t n) const {
+            return m_bits.select0(n);
+        }
+
+    private:
+        RsBitVector m_bits;
+    };
+
+    template <typename HighBits>
+    class basic_elias_fano {
+    public:
+        typedef HighBits high_bits_type;
+        typedef succinct::elias_fano_builder elias_fano_builder;
+
+        basic_elias_fano()
+            : m_size(0)
+            , m_l(0)
+        {}
+
+        basic_elias_fano(bit_vector_builder* bvb, bool with_rank_index = true)
         {
             bit_vector_builder::bits_type& bits = bvb->move_bits();
             uint64_t n = bvb->size();
 
-            uint64_t m = 0;
-            for (size_t i = 0; i < bits.size(); ++i) {
-                m += broadword::popcount(bits[i]);
-            }
+            uint64_t m = broadword::popcount_sum(bits.data(), bits.size());
 
             bit_vector bv(bvb);
             elias_fano_builder builder(n, m);
@@ -72,28 +192,44 @@ namespace succinct {
             build(builder, with_rank_index);
         }
 
-        elias_fano(elias_fano_builder* builder, bool with_rank_index = true)
+        basic_elias_fano(elias_fano_builder* builder, bool with_rank_index = true)
         {
             build(*builder, with_rank_index);
         }
 
+        // from high and low bits built as in elias_fano_builder, which
+        // are left empty; needs HighBits::build(bit_vector*, bool)
+        basic_elias_fano(uint64_t n, uint8_t l, bit_vector* high_bits, bit_vector* low_bits,
+                         bool with_rank_index = true)
+            : m_size(n)
+            , m_l(l)
+        {
+            m_high_bits.build(high_bits, with_rank_index);
+            low_bits->swap(m_low_bits);
+        }
+
         template <typename Visitor>
         void map(Visitor& visit) {
             visit
                 (m_size, "m_size")
-                (m_high_bits, "m_high_bits")
-                (m_high_bits_d1, "m_high_bits_d1")
-                (m_high_bits_d0, "m_high_bits_d0")
+                ;
+            m_high_bits.map(visit);
+            visit
                 (m_low_bits, "m_low_bits")
                 (m_l, "m_l")
                 ;
         }
 
-        void swap(elias_fano& other) {
+        void rebuild_derived() {
+            // m_high_bits is not visited as a node
+            mapper::rebuild_derived(m_high_bits);
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(basic_elias_fano)
+
+        void swap(basic_elias_fano& other) {
             std::swap(other.m_size, m_size);
             other.m_high_bits.swap(m_high_bits);
-            other.m_high_bits_d1.swap(m_high_bits_d1);
-            other.m_high_bits_d0.swap(m_high_bits_d0);
             other.m_low_bits.swap(m_low_bits);
             std::swap(other.m_l, m_l);
         }
@@ -103,19 +239,19 @@ namespace succinct {
         }
 
         inline uint64_t num_ones() const {
-            return m_high_bits_d1.num_positions();
+            return m_high_bits.num_ones();
         }
 
         inline bool operator[](uint64_t pos) const {
             assert(pos < size());
-            assert(m_high_bits_d0.num_positions()); // needs rank index
+            assert(m_high_bits.has_select0()); // needs rank index
             uint64_t h_rank = pos >> m_l;
-            uint64_t h_pos = m_high_bits_d0.select(m_high_bits, h_rank);
+            uint64_t h_pos = m_high_bits.select0(h_rank);
             uint64_t rank = h_pos - h_rank;
             uint64_t l_pos = pos & ((1ULL << m_l) - 1);
 
             while (h_pos > 0
-                   && m_high_bits[h_pos - 1]) {
+                   && m_high_bits.bits()[h_pos - 1]) {
                 --rank;
                 --h_pos;
                 uint64_t cur_low_bits = m_low_bits.get_bits(rank * m_l, m_l);
@@ -131,24 +267,24 @@ namespace succinct {
 
         inline uint64_t select(uint64_t n) const {
             return
-                ((m_high_bits_d1.select(m_high_bits, n) - n) << m_l)
+                ((m_high_bits.select1(n) - n) << m_l)
                 | m_low_bits.get_bits(n * m_l, m_l);
         }
 
         inline uint64_t rank(uint64_t pos) const {
             assert(pos <= m_size);
-            assert(m_high_bits_d0.num_positions()); // needs rank index
+            assert(m_high_bits.has_select0()); // needs rank index
             if (pos == size()) {
                 return num_ones();
             }
 
             uint64_t h_rank = pos >> m_l;
-            uint64_t h_pos = m_high_bits_d0.select(m_high_bits, h_rank);
+            uint64_t h_pos = m_high_bits.select0(h_rank);
             uint64_t rank = h_pos - h_rank;
             uint64_t l_pos = pos & ((1ULL << m_l) - 1);
 
             while (h_pos > 0
-                   && m_high_bits[h_pos - 1]
+                   && m_high_bits.bits()[h_pos - 1]
                    && m_low_bits.get_bits((rank - 1) * m_l, m_l) >= l_pos) {
                 --rank;
                 --h_pos;
@@ -171,12 +307,12 @@ namespace succinct {
         // Efficient only if there are no large gaps in high bits
         // XXX(ot): could make this adaptive
         inline uint64_t delta(uint64_t n) const {
-            uint64_t high_val = m_high_bits_d1.select(m_high_bits, n);
+            uint64_t high_val = m_high_bits.select1(n);
             uint64_t low_val = m_low_bits.get_bits(n * m_l, m_l);
             if (n) {
                 return
                     // need a + here instead of an | for carry
-                    ((high_val - m_high_bits.predecessor1(high_val - 1) - 1) << m_l)
+                    ((high_val - m_high_bits.bits().predecessor1(high_val - 1) - 1) << m_l)
                     + low_val - m_low_bits.get_bits((n - 1) * m_l, m_l);
             } else {
                 return
@@ -190,37 +326,68 @@ namespace succinct {
         inline std::pair<uint64_t, uint64_t> select_range(uint64_t n) const
         {
             assert(n + 1 < num_ones());
-            uint64_t high_val_b = m_high_bits_d1.select(m_high_bits, n);
+            uint64_t high_val_b = m_high_bits.select1(n);
             uint64_t low_val_b = m_low_bits.get_bits(n * m_l, m_l);
-            uint64_t high_val_e = m_high_bits.successor1(high_val_b + 1);
+            uint64_t high_val_e = m_high_bits.bits().successor1(high_val_b + 1);
             uint64_t low_val_e = m_low_bits.get_bits((n + 1) * m_l, m_l);
             return std::make_pair(((high_val_b - n) << m_l) | low_val_b,
                                   ((high_val_e - n - 1) << m_l) | low_val_e);
         }
 
+        // Writes select(i), ..., select(i + count - 1) to out. The
+        // positions of the ones of the high bits and the low bits are
+        // extracted with the bulk kernels.
+        void decode(uint64_t i, size_t count, uint64_t* out) const
+        {
+            assert(i + count <= num_ones());
+            if (!count) return;
+
+            broadword::ones_positions(m_high_bits.bits().data().data(),
+                                      m_high_bits.select1(i), count, out);
+
+            uint64_t l = m_l;
+            const size_t block_size = 64;
+            uint64_t low[block_size];
+            for (size_t b = 0; b < count; b += block_size) {
+                size_t n = std::min(block_size, count - b);
+                if (l) {
+                    broadword::unpack_bits(m_low_bits.data().data(), m_low_bits.data().size(),
+                                           (i + b) * l, l, n, low);
+                } else {
+                    std::fill(low, low + n, 0);
+                }
+                uint64_t* block = out + b;
+                // the high part is the position minus the index
+                uint64_t idx = i + b;
+                for (size_t k = 0; k < n; ++k) {
+                    block[k] = ((block[k] - idx - k) << l) | low[k];
+                }
+            }
+        }
+
         struct select_enumerator {
 
-            select_enumerator(elias_fano const& ef, uint64_t i)
+            select_enumerator(basic_elias_fano const& ef, uint64_t i)
                 : m_ef(&ef)
                 , m_i(i)
                 , m_l(ef.m_l)
+                , m_high_pos(0)
             {
                 m_low_mask = (uint64_t(1) << m_l) - 1;
-                m_low_buf = 0;
-                if (m_l) {
-                    m_chunks_in_word = 64 / m_l;
-                    m_chunks_avail = 0;
-                } else {
-                    m_chunks_in_word = 0;
-                    m_chunks_avail = m_ef->num_ones();
-                }
+                m_chunks_in_word = m_l ? 64 / m_l : 0;
+                reset_low_buf();
 
                 if (!m_ef->num_ones()) return;
-                uint64_t pos = m_ef->m_high_bits_d1.select(m_ef->m_high_bits, m_i);
-                m_high_enum =  bit_vector::unary_enumerator(m_ef->m_high_bits, pos);
+                m_high_pos = m_ef->m_high_bits.select1(m_i);
+                m_high_enum =  bit_vector::unary_enumerator(m_ef->m_high_bits.bits(), m_high_pos);
                 assert(m_l < 64);
             }
 
+            // index of the element returned by the next call to next()
+            uint64_t index() const {
+                return m_i;
+            }
+
             uint64_t next() {
                 if (!m_chunks_avail--) {
                     m_low_buf = m_ef->m_low_bits.get_word(m_i * m_l);
@@ -228,7 +395,8 @@ namespace succinct {
                 }
 
                 uint64_t high = m_high_enum.next();
-                assert(high == m_ef->m_high_bits_d1.select(m_ef->m_high_bits, m_i));
+                assert(high == m_ef->m_high_bits.select1(m_i));
+                m_high_pos = high + 1;
                 uint64_t low = m_low_buf & m_low_mask;
                 uint64_t ret =
                     ((high - m_i) << m_l)
@@ -239,11 +407,107 @@ namespace succinct {
                 return ret;
             }
 
+            // moves to the i-th element, which is returned by the
+            // next call to next(); short forward jumps are scanned in
+            // the high bits, the others use select1
+            void move(uint64_t i) {
+                assert(i <= m_ef->num_ones());
+                if (i == m_i) return;
+                if (i < m_ef->num_ones()) {
+                    if (i > m_i && i - m_i <= linear_scan_threshold) {
+                        m_high_enum.skip(i - m_i);
+                        m_high_pos = m_high_enum.position();
+                    } else {
+                        m_high_pos = m_ef->m_high_bits.select1(i);
+                        m_high_enum = bit_vector::unary_enumerator(m_ef->m_high_bits.bits(), m_high_pos);
+                    }
+                }
+                m_i = i;
+                reset_low_buf();
+            }
+
+            // skips the next k elements
+            void skip(uint64_t k) {
+                move(m_i + k);
+            }
+
+            // returns the first element greater than or equal to x,
+            // starting from the current one, and moves past it as
+            // next() does; returns size() if there is none. The
+            // buckets of the high bits before x are skipped with
+            // select0 if the jump is long and the rank index is
+            // available, otherwise they are scanned.
+            uint64_t next_geq(uint64_t x) {
+                uint64_t n = m_ef->num_ones();
+                uint64_t high_x = x >> m_l;
+                if (high_x > (m_ef->size() >> m_l)) {
+                    m_i = n;
+                }
+                if (m_i == n) {
+                    return m_ef->size();
+                }
+
+                // the high part of the current element is at least
+                // cur_high, the number of zeros before m_high_pos
+                uint64_t cur_high = m_high_pos - m_i;
+                if (high_x > cur_high) {
+                    // position after the (high_x - 1)-th zero
+                    uint64_t pos;
+                    if (high_x - cur_high > linear_scan_threshold
+                        && m_ef->m_high_bits.has_select0()) {
+                        pos = m_ef->m_high_bits.select0(high_x - 1) + 1;
+                    } else {
+                        pos = next_zero(m_high_pos, high_x - cur_high - 1) + 1;
+                    }
+
+                    uint64_t i = pos - high_x;
+                    assert(i >= m_i);
+                    if (i > m_i) {
+                        m_i = i;
+                        reset_low_buf();
+                        if (m_i == n) {
+                            return m_ef->size();
+                        }
+                        m_high_pos = pos;
+                        m_high_enum = bit_vector::unary_enumerator(m_ef->m_high_bits.bits(), pos);
+                    }
+                }
+
+                while (m_i < n) {
+                    uint64_t val = next();
+                    if (val >= x) {
+                        return val;
+                    }
+                }
+                return m_ef->size();
+            }
+
         private:
 
-            elias_fano const* m_ef;
+            inline void reset_low_buf() {
+                m_low_buf = 0;
+                m_chunks_avail = m_l ? 0 : m_ef->num_ones();
+            }
+
+            // position of the k-th zero of the high bits starting from pos
+            inline uint64_t next_zero(uint64_t pos, uint64_t k) const {
+                uint64_t const* data = m_ef->m_high_bits.bits().data().data();
+                uint64_t word_idx = pos / 64;
+                uint64_t buf = ~data[word_idx] & (uint64_t(-1) << (pos % 64));
+                uint64_t w;
+                while ((w = broadword::popcount(buf)) <= k) {
+                    k -= w;
+                    buf = ~data[++word_idx];
+                }
+                return word_idx * 64 + broadword::select_in_word(buf, k);
+            }
+
+            static const uint64_t linear_scan_threshold = 256;
+
+            basic_elias_fano const* m_ef;
             uint64_t m_i;
             uint64_t m_l;
+            uint64_t m_high_pos; // one past the last returned element, or the next one
             bit_vector::unary_enumerator m_high_enum;
             uint64_t m_low_buf;
             uint64_t m_low_mask;
@@ -255,20 +519,17 @@ namespace succinct {
         void build(elias_fano_builder& builder, bool with_rank_index) {
             m_size = builder.m_n;
             m_l = builder.m_l;
-            bit_vector(&builder.m_high_bits).swap(m_high_bits);
-            darray1(m_high_bits).swap(m_high_bits_d1);
-            if (with_rank_index) {
-                darray0(m_high_bits).swap(m_high_bits_d0);
-            }
+            m_high_bits.build(&builder.m_high_bits, with_rank_index);
             bit_vector(&builder.m_low_bits).swap(m_low_bits);
         }
 
         uint64_t m_size;
-        bit_vector m_high_bits;
-        darray1 m_high_bits_d1;
-        darray0 m_high_bits_d0;
+        HighBits m_high_bits;
         bit_vector m_low_bits;
         uint8_t m_l;
     };
 
+    typedef basic_elias_fano<darray_high_bits> elias_fano;
+    typedef basic_elias_fano<rs_high_bits<poppy_bit_vector> > poppy_elias_fano;
+
 }
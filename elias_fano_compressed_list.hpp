@@ -52,6 +52,8 @@ namespace succinct {
             return m_ef.num_ones() - 1;
         }
 
+        SUCCINCT_MOVE_BY_SWAP(elias_fano_compressed_list)
+
         void swap(elias_fano_compressed_list& other)
         {
             m_ef.swap(other.m_ef);
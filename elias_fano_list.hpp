@@ -49,6 +49,8 @@ namespace succinct {
             return m_ef.size() - 1;
         }
 
+        SUCCINCT_MOVE_BY_SWAP(elias_fano_list)
+
         void swap(elias_fano_list& other)
         {
             m_ef.swap(other.m_ef);
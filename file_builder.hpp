@@ -0,0 +1,292 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "bit_vector.hpp"
+#include "elias_fano.hpp"
+#include "mapper.hpp"
+
+namespace succinct {
+
+    // Builders that write the bits directly into the output file, at
+    // the position where freeze() puts them, so that large structures
+    // can be built without holding the bits in memory: the pages of
+    // the file mapping are written back by the kernel as needed. The
+    // derived indices are built in memory over the mapped bits and
+    // appended with finish(); the resulting file can be mapped with
+    // mapper::map(). POSIX only; the structures built over the bits
+    // refer to the builder's mapping, so they must not outlive it.
+
+    namespace detail {
+
+        // A file mapped read-write, grown by doubling
+        class growable_mapped_file : boost::noncopyable {
+        public:
+            growable_mapped_file(const char* filename, bool temporary = false)
+                : m_filename(filename)
+                , m_data(0)
+                , m_capacity(0)
+            {
+                m_fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (m_fd < 0) {
+                    throw std::invalid_argument("Unable to open file '" + m_filename + "'.");
+                }
+                if (temporary) {
+                    // the file lives as long as the descriptor
+                    unlink(filename);
+                }
+            }
+
+            ~growable_mapped_file() {
+                if (m_data) {
+                    munmap(m_data, m_capacity);
+                }
+                close(m_fd);
+            }
+
+            char* data() const {
+                return m_data;
+            }
+
+            // makes sure that the first bytes of the file are mapped;
+            // the mapping may move
+            void reserve(size_t bytes) {
+                if (bytes <= m_capacity) return;
+                size_t capacity = std::max(bytes, 2 * m_capacity);
+                capacity += padding(capacity, mapper::detail::page_size());
+                if (ftruncate(m_fd, off_t(capacity)) != 0) {
+                    throw std::runtime_error("Unable to grow file '" + m_filename + "'.");
+                }
+
+                void* data;
+                if (!m_data) {
+                    data = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+                } else {
+#if defined(__linux__)
+                    data = mremap(m_data, m_capacity, capacity, MREMAP_MAYMOVE);
+#else
+                    munmap(m_data, m_capacity);
+                    data = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+#endif
+                }
+                if (data == MAP_FAILED) {
+                    m_data = 0;
+                    throw std::runtime_error("Unable to map file '" + m_filename + "'.");
+                }
+                m_data = static_cast<char*>(data);
+                m_capacity = capacity;
+            }
+
+            // writes the bytes not already in place, and truncates the
+            // file to size; the mapping is not moved
+            void write(const char* data, size_t bytes, uint64_t offset) {
+                if (data == m_data + offset && offset + bytes <= m_capacity) return;
+                if (!mapper::detail::pwrite_all(m_fd, data, bytes, offset)) {
+                    throw std::runtime_error("Error writing file '" + m_filename + "'.");
+                }
+            }
+
+            void truncate(uint64_t size) {
+                if (ftruncate(m_fd, off_t(size)) != 0) {
+                    throw std::runtime_error("Error writing file '" + m_filename + "'.");
+                }
+            }
+
+        private:
+            static size_t padding(size_t offset, size_t alignment) {
+                return mapper::detail::padding(offset, alignment);
+            }
+
+            std::string m_filename;
+            int m_fd;
+            char* m_data;
+            size_t m_capacity;
+        };
+    }
+
+    // Same interface as bit_vector_builder for building, with the
+    // words at byte offset 8 * header_words of the file. The default
+    // is the position of the bits of a bit_vector (or a structure
+    // deriving from it) frozen on its own: flags, size, number of
+    // words.
+    class file_bit_vector_builder : boost::noncopyable {
+    public:
+        file_bit_vector_builder(const char* filename, uint64_t size = 0,
+                                size_t header_words = 3, bool temporary = false)
+            : m_file(filename, temporary)
+            , m_header_words(header_words)
+            , m_size(size)
+            , m_finished(false)
+        {
+            assert(header_words >= 3);
+            grow(size);
+        }
+
+        inline void push_back(bool b) {
+            uint64_t pos_in_word = m_size % 64;
+            if (pos_in_word == 0) {
+                grow(m_size + 1);
+            }
+            bits()[m_size / 64] |= uint64_t(b) << pos_in_word;
+            ++m_size;
+        }
+
+        inline void set(uint64_t pos, bool b) {
+            assert(pos < m_size);
+            uint64_t* w = bits() + pos / 64;
+            uint64_t pos_in_word = pos % 64;
+            *w &= ~(uint64_t(1) << pos_in_word);
+            *w |= uint64_t(b) << pos_in_word;
+        }
+
+        inline void append_bits(uint64_t bits_, size_t len) {
+            // check there are no spurious bits
+            assert(len == 64 || (bits_ >> len) == 0);
+            if (!len) return;
+            uint64_t pos_in_word = m_size % 64;
+            grow(m_size + len);
+            uint64_t* w = bits() + m_size / 64;
+            m_size += len;
+            if (pos_in_word == 0) {
+                *w = bits_;
+            } else {
+                *w |= bits_ << pos_in_word;
+                if (len > 64 - pos_in_word) {
+                    *(w + 1) = bits_ >> (64 - pos_in_word);
+                }
+            }
+        }
+
+        inline void zero_extend(uint64_t n) {
+            grow(m_size + n);
+            m_size += n;
+        }
+
+        inline void one_extend(uint64_t n) {
+            while (n >= 64) {
+                append_bits(uint64_t(-1), 64);
+                n -= 64;
+            }
+            if (n) {
+                append_bits(uint64_t(-1) >> (64 - n), n);
+            }
+        }
+
+        uint64_t size() const {
+            return m_size;
+        }
+
+        // the words in the file mapping, which moves as the file grows
+        const uint64_t* data() const {
+            return bits();
+        }
+
+        // Stops building, and maps the bits into bv
+        void build(bit_vector& bv) {
+            assert(!m_finished);
+            // write a bit_vector header just before the words; the
+            // fields before it are overwritten by finish()
+            uint64_t* header = bits() - 3;
+            // current format, as the zero word after the words is in
+            // place, so that map() does not copy them
+            header[0] = mapper::detail::freeze_header(0);
+            header[1] = m_size;
+            header[2] = detail::words_for(m_size);
+            mapper::map(bv, reinterpret_cast<const char*>(header));
+            m_finished = true;
+        }
+
+        // Writes val to the file as freeze() would; val must have been
+        // built over the bit_vector returned by build(), and its
+        // first fields must fill the header words. Returns the size
+        // of the file.
+        template <typename T>
+        size_t finish(T& val) {
+            assert(m_finished);
+            mapper::detail::layout_visitor layout(0);
+            layout(val, "<TOP>");
+            std::vector<mapper::detail::freeze_segment> const& segs = layout.segments();
+            assert(segs.size() > 2 && segs[1].offset == 8 * m_header_words);
+            for (size_t i = 0; i < segs.size(); ++i) {
+                if (segs[i].data) {
+                    m_file.write(segs[i].data, segs[i].bytes, segs[i].offset);
+                }
+            }
+            m_file.truncate(layout.size());
+            return size_t(layout.size());
+        }
+
+    private:
+        uint64_t* bits() const {
+            return reinterpret_cast<uint64_t*>(m_file.data()) + m_header_words;
+        }
+
+        // with the zero word that follows the bits when frozen
+        void grow(uint64_t size) {
+            assert(!m_finished);
+            m_file.reserve(8 * (m_header_words + detail::words_for(size) + 1));
+        }
+
+        detail::growable_mapped_file m_file;
+        size_t m_header_words;
+        uint64_t m_size;
+        bool m_finished;
+    };
+
+    // Same interface as elias_fano_builder. The high bits are written
+    // in place in the output file; the low bits, which are frozen
+    // after the high bits indices, are written to a temporary file and
+    // copied to the output by finish().
+    class file_elias_fano_builder : boost::noncopyable {
+    public:
+        file_elias_fano_builder(const char* filename, uint64_t n, uint64_t m)
+            : m_n(n)
+            , m_m(m)
+            , m_pos(0)
+            , m_last(0)
+            , m_l(uint8_t((m && n / m) ? broadword::msb(n / m) : 0))
+              // after flags and m_size
+            , m_high_bits(filename, (m + 1) + (n >> m_l) + 1, 4)
+            , m_low_bits((std::string(filename) + ".low").c_str(), 0, 3, true)
+        {
+            assert(m_l < 64); // for the correctness of low_mask
+        }
+
+        inline void push_back(uint64_t i) {
+            assert(i >= m_last && i <= m_n);
+            m_last = i;
+            uint64_t low_mask = (1ULL << m_l) - 1;
+
+            if (m_l) {
+                m_low_bits.append_bits(i & low_mask, m_l);
+            }
+            m_high_bits.set((i >> m_l) + m_pos, 1);
+            ++m_pos;
+            assert(m_pos <= m_m); (void)m_m;
+        }
+
+        // Builds ef over the file and writes it; returns the size of
+        // the file
+        size_t finish(elias_fano& ef, bool with_rank_index = true) {
+            bit_vector high_bits, low_bits;
+            m_high_bits.build(high_bits);
+            m_low_bits.build(low_bits);
+            elias_fano(m_n, m_l, &high_bits, &low_bits, with_rank_index).swap(ef);
+            return m_high_bits.finish(ef);
+        }
+
+    private:
+        uint64_t m_n;
+        uint64_t m_m;
+        uint64_t m_pos;
+        uint64_t m_last;
+        uint8_t m_l;
+        file_bit_vector_builder m_high_bits;
+        file_bit_vector_builder m_low_bits;
+    };
+}
@@ -56,6 +56,8 @@ namespace succinct {
             return m_high_bits.num_ones() - 1;
         }
 
+        SUCCINCT_MOVE_BY_SWAP(gamma_bit_vector)
+
         void swap(gamma_bit_vector& other)
         {
             m_high_bits.swap(other.m_high_bits);
@@ -50,6 +50,8 @@ namespace succinct {
             return m_high_bits.num_ones() - 1;
         }
 
+        SUCCINCT_MOVE_BY_SWAP(gamma_vector)
+
         void swap(gamma_vector& other)
         {
             m_high_bits.swap(other.m_high_bits);
@@ -0,0 +1,83 @@
+#include "interleaved_rs_bit_vector.hpp"
+
+#include <stdexcept>
+
+namespace succinct {
+
+    void interleaved_rs_bit_vector::build(bit_vector const& bv,
+                                          select_index_type select_index,
+                                          select_index_type select0_index)
+    {
+        using broadword::popcount;
+        m_size = bv.size();
+        mapper::mappable_vector<uint64_t> const& bits = bv.data();
+
+        {
+            uint64_t n_lines = util::ceil_div(bits.size(), data_words);
+            // one more line as sentinel
+            std::vector<uint64_t, util::aligned_allocator<uint64_t, 64> > lines;
+            mapper::reserve_padded(lines, (n_lines + 1) * line_words);
+            lines.resize((n_lines + 1) * line_words);
+
+            uint64_t cur_rank = 0;
+            for (uint64_t line = 0; line < n_lines; ++line) {
+                uint64_t* l = &lines[line * line_words];
+                uint64_t line_rank = 0;
+                uint64_t pair_ranks = 0;
+                for (uint64_t w = 0; w < data_words; ++w) {
+                    uint64_t i = line * data_words + w;
+                    uint64_t word = (i < bits.size()) ? bits[i] : 0;
+                    if (w && w % 2 == 0) {
+                        pair_ranks |= line_rank << (9 * (w / 2 - 1));
+                    }
+                    l[1 + w] = word;
+                    line_rank += popcount(word);
+                }
+                l[0] = cur_rank | (pair_ranks << rank_bits);
+                cur_rank += line_rank;
+            }
+            // the headers of the lines past the limit are garbage
+            if (cur_rank > rank_mask) {
+                throw std::invalid_argument("interleaved_rs_bit_vector: more than 2^37 ones");
+            }
+            lines[n_lines * line_words] = cur_rank;
+
+            m_lines.steal(lines);
+        }
+
+        if (select_index == select_index_hints) {
+            std::vector<uint64_t> select_hints;
+            uint64_t cur_ones_threshold = select_ones_per_hint;
+            for (uint64_t i = 0; i < num_lines(); ++i) {
+                if (line_rank(i + 1) > cur_ones_threshold) {
+                    select_hints.push_back(i);
+                    cur_ones_threshold += select_ones_per_hint;
+                }
+            }
+            select_hints.push_back(num_lines());
+            m_select_hints.steal(select_hints);
+        }
+
+        if (select0_index == select_index_hints) {
+            std::vector<uint64_t> select0_hints;
+            uint64_t cur_zeros_threshold = select_zeros_per_hint;
+            for (uint64_t i = 0; i < num_lines(); ++i) {
+                if (line_rank0(i + 1) > cur_zeros_threshold) {
+                    select0_hints.push_back(i);
+                    cur_zeros_threshold += select_zeros_per_hint;
+                }
+            }
+            select0_hints.push_back(num_lines());
+            m_select0_hints.steal(select0_hints);
+        }
+
+        if (select_index == select_index_inventory) {
+            detail::select_inventory(bv, false, line_bits).swap(m_select_inventory);
+        }
+
+        if (select0_index == select_index_inventory) {
+            detail::select_inventory(bv, true, line_bits).swap(m_select0_inventory);
+        }
+    }
+
+}
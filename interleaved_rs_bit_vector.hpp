@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "bit_vector.hpp"
+#include "broadword.hpp"
+#include "util.hpp"
+#include "select_inventory.hpp"
+
+namespace succinct {
+
+    // Rank/select bit vector with the same interface as
+    // rs_bit_vector, but with the rank directory interleaved with the
+    // data: each 64-byte line holds a header word followed by 7 data
+    // words (448 bits), so a rank touches a single cache line instead
+    // of the rank pair and the data word. The header packs the
+    // absolute rank of the line (37 bits) and the cumulative counts
+    // of data words [0, 2), [0, 4), [0, 6) (3 x 9 bits); the space
+    // overhead is 1/8 of the data bits. Building a vector with more
+    // than 2^37 ones throws std::invalid_argument.
+    //
+    // The lines are cache-line aligned when the vector is built in
+    // memory; when mapped, they are aligned only if the mapped
+    // payload is.
+    class interleaved_rs_bit_vector {
+    public:
+        interleaved_rs_bit_vector()
+            : m_size(0)
+        {}
+
+        template <class Range>
+        interleaved_rs_bit_vector(Range const& from,
+                                  bool with_select_hints = false,
+                                  bool with_select0_hints = false)
+        {
+            // from can be either a range of bools or a bit_vector_builder*
+            bit_vector bv(from);
+            build(bv,
+                  with_select_hints ? select_index_hints : select_index_none,
+                  with_select0_hints ? select_index_hints : select_index_none);
+        }
+
+        template <class Range>
+        interleaved_rs_bit_vector(Range const& from,
+                                  select_index_type select_index,
+                                  select_index_type select0_index = select_index_none)
+        {
+            bit_vector bv(from);
+            build(bv, select_index, select0_index);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit
+                (m_size, "m_size")
+                (m_lines, "m_lines")
+                (m_select_hints, "m_select_hints")
+                (m_select0_hints, "m_select0_hints")
+                (m_select_inventory, "m_select_inventory")
+                (m_select0_inventory, "m_select0_inventory")
+                ;
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(interleaved_rs_bit_vector)
+
+        void swap(interleaved_rs_bit_vector& other) {
+            std::swap(other.m_size, m_size);
+            m_lines.swap(other.m_lines);
+            m_select_hints.swap(other.m_select_hints);
+            m_select0_hints.swap(other.m_select0_hints);
+            m_select_inventory.swap(other.m_select_inventory);
+            m_select0_inventory.swap(other.m_select0_inventory);
+        }
+
+        inline size_t size() const {
+            return m_size;
+        }
+
+        inline uint64_t num_ones() const {
+            return line_rank(num_lines());
+        }
+
+        inline uint64_t num_zeros() const {
+            return size() - num_ones();
+        }
+
+        inline bool operator[](uint64_t pos) const {
+            assert(pos < m_size);
+            return (word(pos / 64) >> (pos % 64)) & 1;
+        }
+
+        inline uint64_t rank(uint64_t pos) const {
+            assert(pos <= size());
+            uint64_t line = pos / line_bits;
+            uint64_t const* l = m_lines.data() + line * line_words;
+            uint64_t header = l[0];
+            uint64_t w = (pos % line_bits) / 64;
+            uint64_t r = (header & rank_mask) + pair_rank(header, w / 2);
+            if (w & 1) {
+                r += broadword::popcount(l[w]); // data word w - 1
+            }
+            uint64_t sub_left = pos % 64;
+            if (sub_left) {
+                r += broadword::popcount(l[1 + w] << (64 - sub_left));
+            }
+            return r;
+        }
+
+        inline uint64_t rank0(uint64_t pos) const {
+            return pos - rank(pos);
+        }
+
+        inline uint64_t select(uint64_t n) const {
+            using broadword::popcount;
+            using broadword::select_in_word;
+            assert(n < num_ones());
+            uint64_t a = 0;
+            uint64_t b = num_lines();
+            if (!m_select_inventory.empty()) {
+                if (!m_select_inventory.block_range(n, a, b)) {
+                    return a;
+                }
+            } else if (m_select_hints.size()) {
+                uint64_t chunk = n / select_ones_per_hint;
+                if (chunk != 0) {
+                    a = m_select_hints[chunk - 1];
+                }
+                b = m_select_hints[chunk] + 1;
+            }
+
+            while (b - a > 1) {
+                uint64_t mid = a + (b - a) / 2;
+                if (line_rank(mid) <= n) {
+                    a = mid;
+                } else {
+                    b = mid;
+                }
+            }
+
+            uint64_t const* l = m_lines.data() + a * line_words;
+            uint64_t header = l[0];
+            uint64_t r = n - (header & rank_mask);
+            uint64_t pair = (r >= pair_rank(header, 1))
+                + (r >= pair_rank(header, 2))
+                + (r >= pair_rank(header, 3));
+            r -= pair_rank(header, pair);
+            uint64_t w = 2 * pair;
+            uint64_t word_pop = popcount(l[1 + w]);
+            if (r >= word_pop) {
+                r -= word_pop;
+                w += 1;
+            }
+            assert(w < data_words);
+            return (a * data_words + w) * 64 + select_in_word(l[1 + w], r);
+        }
+
+        inline uint64_t select0(uint64_t n) const {
+            using broadword::popcount;
+            using broadword::select_in_word;
+            assert(n < num_zeros());
+            uint64_t a = 0;
+            uint64_t b = num_lines();
+            if (!m_select0_inventory.empty()) {
+                if (!m_select0_inventory.block_range(n, a, b)) {
+                    return a;
+                }
+            } else if (m_select0_hints.size()) {
+                uint64_t chunk = n / select_zeros_per_hint;
+                if (chunk != 0) {
+                    a = m_select0_hints[chunk - 1];
+                }
+                b = m_select0_hints[chunk] + 1;
+            }
+
+            while (b - a > 1) {
+                uint64_t mid = a + (b - a) / 2;
+                if (line_rank0(mid) <= n) {
+                    a = mid;
+                } else {
+                    b = mid;
+                }
+            }
+
+            uint64_t const* l = m_lines.data() + a * line_words;
+            uint64_t header = l[0];
+            uint64_t r = n - line_rank0(a);
+            uint64_t pair = (r >= pair_rank0(header, 1))
+                + (r >= pair_rank0(header, 2))
+                + (r >= pair_rank0(header, 3));
+            r -= pair_rank0(header, pair);
+            uint64_t w = 2 * pair;
+            uint64_t word_pop0 = popcount(~l[1 + w]);
+            if (r >= word_pop0) {
+                r -= word_pop0;
+                w += 1;
+            }
+            assert(w < data_words);
+            return (a * data_words + w) * 64 + select_in_word(~l[1 + w], r);
+        }
+
+        inline uint64_t predecessor0(uint64_t pos) const {
+            assert(pos < m_size);
+            uint64_t block = pos / 64;
+            uint64_t shift = 64 - pos % 64 - 1;
+            uint64_t w = ~word(block);
+            w = (w << shift) >> shift;
+
+            unsigned long ret;
+            while (!broadword::msb(w, ret)) {
+                assert(block);
+                w = ~word(--block);
+            };
+            return block * 64 + ret;
+        }
+
+        inline uint64_t successor0(uint64_t pos) const {
+            assert(pos < m_size);
+            uint64_t block = pos / 64;
+            uint64_t shift = pos % 64;
+            uint64_t w = (~word(block) >> shift) << shift;
+
+            unsigned long ret;
+            while (!broadword::lsb(w, ret)) {
+                ++block;
+                assert(block < num_words());
+                w = ~word(block);
+            };
+            return block * 64 + ret;
+        }
+
+        inline uint64_t predecessor1(uint64_t pos) const {
+            assert(pos < m_size);
+            uint64_t block = pos / 64;
+            uint64_t shift = 64 - pos % 64 - 1;
+            uint64_t w = word(block);
+            w = (w << shift) >> shift;
+
+            unsigned long ret;
+            while (!broadword::msb(w, ret)) {
+                assert(block);
+                w = word(--block);
+            };
+            return block * 64 + ret;
+        }
+
+        inline uint64_t successor1(uint64_t pos) const {
+            assert(pos < m_size);
+            uint64_t block = pos / 64;
+            uint64_t shift = pos % 64;
+            uint64_t w = (word(block) >> shift) << shift;
+
+            unsigned long ret;
+            while (!broadword::lsb(w, ret)) {
+                ++block;
+                assert(block < num_words());
+                w = word(block);
+            };
+            return block * 64 + ret;
+        }
+
+    protected:
+
+        // interface shared with rs_bit_vector, used by basic_bp_vector
+
+        inline uint64_t num_words() const {
+            return detail::words_for(m_size);
+        }
+
+        inline uint64_t word(uint64_t i) const {
+            return m_lines[(i / data_words) * line_words + 1 + i % data_words];
+        }
+
+        inline uint64_t sub_block_rank(uint64_t sub_block) const {
+            uint64_t line = sub_block / data_words;
+            uint64_t const* l = m_lines.data() + line * line_words;
+            uint64_t header = l[0];
+            uint64_t w = sub_block % data_words;
+            uint64_t r = (header & rank_mask) + pair_rank(header, w / 2);
+            if (w & 1) {
+                r += broadword::popcount(l[w]);
+            }
+            return r;
+        }
+
+        inline uint64_t num_lines() const {
+            return m_lines.size() / line_words - 1;
+        }
+
+        inline uint64_t line_rank(uint64_t line) const {
+            return m_lines[line * line_words] & rank_mask;
+        }
+
+        inline uint64_t line_rank0(uint64_t line) const {
+            return line * line_bits - line_rank(line);
+        }
+
+        // number of ones in data words [0, 2 * pair) of the line
+        static inline uint64_t pair_rank(uint64_t header, uint64_t pair) {
+            return ((header >> rank_bits) << 9) >> (9 * pair) & 0x1FF;
+        }
+
+        static inline uint64_t pair_rank0(uint64_t header, uint64_t pair) {
+            return 128 * pair - pair_rank(header, pair);
+        }
+
+        void build(bit_vector const& bv, select_index_type select_index, select_index_type select0_index);
+
+        static const uint64_t line_words = 8;
+        static const uint64_t data_words = line_words - 1;
+        static const uint64_t line_bits = data_words * 64;
+        static const uint64_t rank_bits = 37; // at most 2^37 ones
+        static const uint64_t rank_mask = (uint64_t(1) << rank_bits) - 1;
+        static const uint64_t select_ones_per_hint = 1024; // must be > line_bits
+        static const uint64_t select_zeros_per_hint = select_ones_per_hint;
+
+        typedef mapper::mappable_vector<uint64_t> uint64_vec;
+        size_t m_size;
+        uint64_vec m_lines; // the last line is a sentinel holding num_ones()
+        uint64_vec m_select_hints;
+        uint64_vec m_select0_hints;
+        detail::select_inventory m_select_inventory;
+        detail::select_inventory m_select0_inventory;
+    };
+}
@@ -23,6 +23,15 @@
 #include <smmintrin.h>
 #endif
 
+// Runtime CPU dispatch needs CPUID and per-function target
+// attributes, so it is only available with GCC/Clang on x86
+#if SUCCINCT_USE_INTRINSICS && (defined(__GNUC__) || defined(__clang__)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#    define SUCCINCT_HAS_CPU_DISPATCH 1
+#else
+#    define SUCCINCT_HAS_CPU_DISPATCH 0
+#endif
+
 
 
 namespace succinct { namespace intrinsics {
@@ -98,4 +107,42 @@ namespace succinct { namespace intrinsics {
 
 #endif /* SUCCINCT_USE_POPCNT */
 
+    // CPU features relevant to the runtime-dispatched kernels,
+    // detected once at startup
+    struct cpu_features {
+        cpu_features()
+            : popcnt(false)
+            , bmi2(false)
+            , avx2(false)
+            , avx512_vpopcntdq(false)
+            , avx512bw(false)
+        {
+#if SUCCINCT_HAS_CPU_DISPATCH
+            __builtin_cpu_init();
+            popcnt = __builtin_cpu_supports("popcnt");
+            // PDEP is microcoded, and slower than the broadword
+            // select, before Zen 3
+            bmi2 = __builtin_cpu_supports("bmi2")
+                && !__builtin_cpu_is("znver1") && !__builtin_cpu_is("znver2");
+            avx2 = __builtin_cpu_supports("avx2");
+            avx512_vpopcntdq = __builtin_cpu_supports("avx512f")
+                && __builtin_cpu_supports("avx512vpopcntdq");
+            avx512bw = __builtin_cpu_supports("avx512f")
+                && __builtin_cpu_supports("avx512bw");
+#endif
+        }
+
+        bool popcnt;
+        bool bmi2; // with a fast PDEP
+        bool avx2;
+        bool avx512_vpopcntdq;
+        bool avx512bw;
+    };
+
+    inline cpu_features const& get_cpu_features()
+    {
+        static const cpu_features features;
+        return features;
+    }
+
 }}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "broadword.hpp"
+#include "util.hpp"
+
+namespace succinct {
+
+    // Boolean operations over sorted lists stored in sequences with
+    // the elias_fano interface (num_ones(), size() and a
+    // select_enumerator with next() and next_geq()), such as
+    // elias_fano and partitioned_elias_fano. The results are written
+    // in increasing order to a caller buffer, and their number is
+    // returned.
+
+    namespace detail {
+
+        // select_enumerator with its last returned value, or
+        // end_value when the list is exhausted
+        template <typename Sequence>
+        struct list_cursor {
+            typedef typename Sequence::select_enumerator enumerator_type;
+            static const uint64_t end_value = uint64_t(-1);
+
+            list_cursor(Sequence const& seq)
+                : m_seq(&seq)
+                , m_enum(seq, 0)
+                , value(end_value)
+            {
+                next();
+            }
+
+            uint64_t next() {
+                value = (m_enum.index() < m_seq->num_ones()) ? m_enum.next() : end_value;
+                return value;
+            }
+
+            uint64_t next_geq(uint64_t x) {
+                if (value < x) {
+                    uint64_t v = m_enum.next_geq(x);
+                    value = (v >= m_seq->size()) ? end_value : v;
+                }
+                return value;
+            }
+
+            bool operator<(list_cursor const& other) const {
+                return value < other.value;
+            }
+
+            Sequence const* m_seq;
+            enumerator_type m_enum;
+            uint64_t value;
+        };
+
+        template <typename Sequence>
+        bool fewer_ones(Sequence const* a, Sequence const* b) {
+            return a->num_ones() < b->num_ones();
+        }
+    }
+
+    // Values contained in all the lists. The rarest list drives the
+    // candidates, the others skip to them with next_geq. out must
+    // have room for the size of the smallest list.
+    template <typename Sequence>
+    size_t intersect_lists(std::vector<Sequence const*> const& lists, uint64_t* out)
+    {
+        typedef detail::list_cursor<Sequence> cursor;
+        if (lists.empty()) return 0;
+
+        std::vector<Sequence const*> sorted(lists);
+        std::sort(sorted.begin(), sorted.end(), detail::fewer_ones<Sequence>);
+        std::vector<cursor> cursors;
+        cursors.reserve(sorted.size());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            cursors.push_back(cursor(*sorted[i]));
+        }
+
+        size_t n = 0;
+        uint64_t candidate = cursors[0].value;
+        size_t i = 1;
+        while (candidate != cursor::end_value) {
+            for (; i < cursors.size(); ++i) {
+                uint64_t v = cursors[i].next_geq(candidate);
+                if (v != candidate) {
+                    candidate = cursors[0].next_geq(v);
+                    i = 1;
+                    break;
+                }
+            }
+
+            if (i == cursors.size()) {
+                out[n++] = candidate;
+                candidate = cursors[0].next();
+                i = 1;
+            }
+        }
+        return n;
+    }
+
+    // Values contained in at least one list. If the lists are dense
+    // with respect to the universe they are merged in a bitmap,
+    // otherwise with a heap. out must have room for the sum of the
+    // sizes of the lists.
+    template <typename Sequence>
+    size_t union_lists(std::vector<Sequence const*> const& lists, uint64_t* out)
+    {
+        typedef detail::list_cursor<Sequence> cursor;
+
+        uint64_t universe = 0;
+        uint64_t total = 0;
+        for (size_t i = 0; i < lists.size(); ++i) {
+            universe = std::max(universe, lists[i]->size());
+            total += lists[i]->num_ones();
+        }
+        if (!total) return 0;
+
+        if (lists.size() > 2 && universe / 64 <= total) {
+            std::vector<uint64_t> bits(util::ceil_div(universe, 64));
+            for (size_t i = 0; i < lists.size(); ++i) {
+                typename Sequence::select_enumerator e(*lists[i], 0);
+                for (uint64_t j = 0; j < lists[i]->num_ones(); ++j) {
+                    uint64_t v = e.next();
+                    bits[v / 64] |= uint64_t(1) << (v % 64);
+                }
+            }
+            size_t n = size_t(broadword::popcount_sum(bits.data(), bits.size()));
+            broadword::ones_positions(bits.data(), 0, n, out);
+            return n;
+        }
+
+        std::vector<std::pair<uint64_t, size_t> > heap;
+        std::vector<cursor> cursors;
+        cursors.reserve(lists.size());
+        for (size_t i = 0; i < lists.size(); ++i) {
+            cursors.push_back(cursor(*lists[i]));
+            if (cursors[i].value != cursor::end_value) {
+                heap.push_back(std::make_pair(cursors[i].value, i));
+            }
+        }
+        typedef std::greater<std::pair<uint64_t, size_t> > heap_order;
+        std::make_heap(heap.begin(), heap.end(), heap_order());
+
+        size_t n = 0;
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), heap_order());
+            uint64_t v = heap.back().first;
+            size_t i = heap.back().second;
+            if (!n || out[n - 1] != v) {
+                out[n++] = v;
+            }
+
+            uint64_t next = cursors[i].next();
+            if (next == cursor::end_value) {
+                heap.pop_back();
+            } else {
+                heap.back().first = next;
+                std::push_heap(heap.begin(), heap.end(), heap_order());
+            }
+        }
+        return n;
+    }
+
+    // Values contained in at least k of the lists. The cursors are
+    // kept sorted by value; no value smaller than the k-th smallest
+    // current value (the pivot) can be in k lists, so the cursors
+    // before it skip to the pivot with next_geq. out must have room
+    // for the sum of the sizes of the lists divided by k.
+    template <typename Sequence>
+    size_t threshold_lists(std::vector<Sequence const*> const& lists, size_t k, uint64_t* out)
+    {
+        typedef detail::list_cursor<Sequence> cursor;
+        assert(k > 0);
+        if (k > lists.size()) {
+            return 0;
+        } else if (k == 1) {
+            return union_lists(lists, out);
+        } else if (k == lists.size()) {
+            return intersect_lists(lists, out);
+        }
+
+        std::vector<cursor> cursors;
+        cursors.reserve(lists.size());
+        for (size_t i = 0; i < lists.size(); ++i) {
+            cursors.push_back(cursor(*lists[i]));
+        }
+
+        size_t n = 0;
+        while (true) {
+            std::sort(cursors.begin(), cursors.end());
+            uint64_t pivot = cursors[k - 1].value;
+            if (pivot == cursor::end_value) break;
+
+            if (cursors[0].value == pivot) {
+                out[n++] = pivot;
+                for (size_t i = 0; i < cursors.size() && cursors[i].value == pivot; ++i) {
+                    cursors[i].next();
+                }
+            } else {
+                for (size_t i = 0; i < k - 1; ++i) {
+                    cursors[i].next_geq(pivot);
+                }
+            }
+        }
+        return n;
+    }
+}
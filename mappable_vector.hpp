@@ -2,15 +2,19 @@
 
 #include <vector>
 #include <algorithm>
+#include <utility>
 
+#include <boost/config.hpp>
 #include <boost/utility.hpp>
+#include <boost/utility/enable_if.hpp>
 #include <boost/range.hpp>
-#include <boost/function.hpp>
-#include <boost/lambda/bind.hpp>
-#include <boost/lambda/construct.hpp>
 
 #include <stdint.h>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
 #include "intrinsics.hpp"
 
 namespace succinct { namespace mapper {
@@ -19,10 +23,190 @@ namespace succinct { namespace mapper {
         class freeze_visitor;
         class map_visitor;
         class sizeof_visitor;
+        class layout_visitor;
+        class unpack_visitor;
+    }
+
+    // Marks a field as derived data in the map() method of a
+    // structure, as in visit(mapper::derived(m_index), "m_index").
+    // Structures with derived fields must rebuild them in a
+    // rebuild_derived() method, see below.
+    template <typename T>
+    struct derived_field {
+        explicit derived_field(T& ref)
+            : ref(ref)
+        {}
+
+        T& ref;
+    };
+
+    template <typename T>
+    inline derived_field<T> derived(T& ref)
+    {
+        return derived_field<T>(ref);
     }
 
-    typedef boost::function<void()> deleter_t;
+    namespace detail {
+        // Whether the class T has a rebuild_derived() member, possibly
+        // inherited: if it does, the name is ambiguous in probe and
+        // the first overload of test is discarded
+        template <typename T>
+        struct has_rebuild_derived {
+            typedef char yes;
+            typedef long no;
+            struct fallback { void rebuild_derived() {} };
+            struct probe : T, fallback {};
+            template <typename U, U> struct check;
+            template <typename U> static no test(check<void (fallback::*)(), &U::rebuild_derived>*);
+            template <typename U> static yes test(...);
+            static const bool value = sizeof(test<probe>(0)) == sizeof(yes);
+        };
+    }
+
+    // Calls val.rebuild_derived() if T declares it. After a file
+    // frozen with freeze_flags::omit_derived is mapped, the omitted
+    // vectors are placeholders (mappable_vector::omitted()) and
+    // rebuild_derived() is called bottom-up on each structure, which
+    // must replace them; structures should call this on the members
+    // whose map() they call directly.
+    template <typename T>
+    inline typename boost::enable_if_c<detail::has_rebuild_derived<T>::value>::type
+    rebuild_derived(T& val)
+    {
+        val.rebuild_derived();
+    }
+
+    template <typename T>
+    inline typename boost::disable_if_c<detail::has_rebuild_derived<T>::value>::type
+    rebuild_derived(T& /* val */)
+    {}
+
+#if !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+    // Move constructor and move assignment for a class T with a
+    // default constructor and swap(T&); the moved-from object is left
+    // empty. Expands to nothing without rvalue references, where the
+    // structures are moved with swap().
+#   define SUCCINCT_MOVE_BY_SWAP(T)             \
+    T(T&& other)                                \
+        : T()                                   \
+    {                                           \
+        swap(other);                            \
+    }                                           \
+                                                \
+    T& operator=(T&& other) {                   \
+        T tmp(std::move(other));                \
+        swap(tmp);                              \
+        return *this;                           \
+    }
+#else
+#   define SUCCINCT_MOVE_BY_SWAP(T)
+#endif
 
+    // How the memory of a mappable_vector is allocated when it is
+    // built in memory (by the Range constructor, assign and steal).
+    // With the huge page policies, payloads of at least 2MB are
+    // copied to 2MB-aligned anonymous memory, so that random accesses
+    // need fewer TLB entries; smaller payloads are unaffected.
+    enum alloc_policy {
+        alloc_default,
+        // madvise(MADV_HUGEPAGE), for transparent huge pages
+        alloc_hugepage,
+        // explicit huge pages (MAP_HUGETLB) from the hugetlbfs pool,
+        // falling back to alloc_hugepage if the pool is empty
+        alloc_hugetlb
+    };
+
+    namespace detail {
+        inline alloc_policy& alloc_policy_storage()
+        {
+            static alloc_policy policy = alloc_default;
+            return policy;
+        }
+
+        static const size_t huge_page_size = size_t(1) << 21;
+
+        inline size_t huge_length(size_t bytes)
+        {
+            return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+        }
+
+        // Allocates bytes of 2MB-aligned memory according to policy,
+        // to be freed with huge_deallocate. Returns 0 if the policy
+        // does not apply, or the allocation fails.
+        inline void* huge_allocate(size_t bytes, alloc_policy policy)
+        {
+#if !defined(_WIN32)
+            if (policy == alloc_default || bytes < huge_page_size) return 0;
+            size_t len = huge_length(bytes);
+
+#if defined(MAP_HUGETLB)
+            if (policy == alloc_hugetlb) {
+                void* p = mmap(0, len, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (p != MAP_FAILED) {
+                    return p;
+                }
+            }
+#endif
+            // over-allocate by a huge page and trim to an aligned range
+            void* p = mmap(0, len + huge_page_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) return 0;
+            char* begin = static_cast<char*>(p);
+            char* aligned = reinterpret_cast<char*>((uintptr_t(begin) + huge_page_size - 1)
+                                                    & ~uintptr_t(huge_page_size - 1));
+            if (aligned != begin) {
+                munmap(begin, size_t(aligned - begin));
+            }
+            munmap(aligned + len, size_t(begin + huge_page_size - aligned));
+#if defined(MADV_HUGEPAGE)
+            madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+            return aligned;
+#else
+            (void)bytes; (void)policy;
+            return 0;
+#endif
+        }
+
+        inline void huge_deallocate(void* p, size_t bytes)
+        {
+#if !defined(_WIN32)
+            munmap(p, huge_length(bytes));
+#else
+            (void)p; (void)bytes;
+#endif
+        }
+
+        // Keeps alive the memory of a mappable_vector that cannot be
+        // freed from its data pointer alone
+        struct owner_base {
+            virtual ~owner_base() {}
+        };
+
+        template <typename Vector>
+        struct vector_owner : owner_base {
+            Vector vec;
+        };
+    }
+
+    // Policy used when none is given. The default is alloc_default;
+    // setting it makes all the builders of the library opt in.
+    inline alloc_policy default_alloc_policy()
+    {
+        return detail::alloc_policy_storage();
+    }
+
+    inline void set_default_alloc_policy(alloc_policy policy)
+    {
+        detail::alloc_policy_storage() = policy;
+    }
+
+    // The payload of a non-empty mappable_vector is always followed by
+    // at least 8 zero bytes (padding_elements elements), whether it is
+    // built in memory or mapped, so that decoders can read a whole
+    // 64-bit word at any position of the payload without bounds
+    // checks.
     template <typename T> // T must be a POD
     class mappable_vector : boost::noncopyable {
     public:
@@ -30,60 +214,84 @@ namespace succinct { namespace mapper {
         typedef const T* iterator;
         typedef const T* const_iterator;
 
+        static const size_t padding_elements = (sizeof(uint64_t) + sizeof(T) - 1) / sizeof(T);
+
         mappable_vector()
             : m_data(0)
             , m_size(0)
-            , m_deleter()
+            , m_owner(owner_none)
         {}
 
         template <typename Range>
-        mappable_vector(Range const& from)
+        mappable_vector(Range const& from, alloc_policy policy = default_alloc_policy())
             : m_data(0)
             , m_size(0)
+            , m_owner(owner_none)
         {
             size_t size = boost::size(from);
-            T* data = new T[size];
-            m_deleter = boost::lambda::bind(boost::lambda::delete_array(), data);
+            size_t padded_size = size + padding_elements;
+            T* data = static_cast<T*>(detail::huge_allocate(padded_size * sizeof(T), policy));
+            uintptr_t owner = owner_huge;
+            if (!data) {
+                data = new T[padded_size];
+                owner = owner_array;
+            }
 
             std::copy(boost::begin(from),
                       boost::end(from),
                       data);
+            std::fill(data + size, data + padded_size, T());
             m_data = data;
             m_size = size;
+            m_owner = owner;
         }
 
         ~mappable_vector() {
-            if (m_deleter) {
-                m_deleter();
-            }
+            release();
         }
 
+        SUCCINCT_MOVE_BY_SWAP(mappable_vector)
+
         void swap(mappable_vector& other) {
             using std::swap;
             swap(m_data, other.m_data);
             swap(m_size, other.m_size);
-            swap(m_deleter, other.m_deleter);
+            swap(m_owner, other.m_owner);
         }
 
         void clear() {
             mappable_vector().swap(*this);
         }
 
-        void steal(std::vector<T>& vec) {
+        // With a huge page policy, large vectors are copied (see
+        // alloc_policy); vec is left empty in any case
+        template <typename Allocator>
+        void steal(std::vector<T, Allocator>& vec, alloc_policy policy = default_alloc_policy()) {
             clear();
+            if (policy != alloc_default && vec.size() * sizeof(T) >= detail::huge_page_size) {
+                mappable_vector(vec, policy).swap(*this);
+                std::vector<T, Allocator>().swap(vec);
+                return;
+            }
             m_size = vec.size();
             if (m_size) {
-                std::vector<T>* new_vec = new std::vector<T>;
-                new_vec->swap(vec);
-                m_deleter = boost::lambda::bind(boost::lambda::delete_ptr(), new_vec);
-                m_data = &(*new_vec)[0];
+                // the buffer cannot be detached from vec, so the
+                // vector itself is kept
+                detail::vector_owner<std::vector<T, Allocator> >* owner =
+                    new detail::vector_owner<std::vector<T, Allocator> >;
+                owner->vec.swap(vec);
+                // reallocates if there is no spare capacity, see
+                // reserve_padded
+                owner->vec.resize(m_size + padding_elements);
+                m_data = &owner->vec[0];
+                m_owner = reinterpret_cast<uintptr_t>(owner) | owner_object;
             }
         }
 
         template <typename Range>
-        void assign(Range const& from) {
+        void assign(Range const& from, alloc_policy policy = default_alloc_policy()) {
             clear();
-            mappable_vector(from).swap(*this);
+            mappable_vector(from, policy).swap(*this);
         }
 
         uint64_t size() const {
@@ -107,6 +315,12 @@ namespace succinct { namespace mapper {
             return m_data;
         }
 
+        // placeholder for a derived vector omitted from the frozen
+        // file, see freeze_flags::omit_derived; only the size is set
+        bool omitted() const {
+            return m_size && !m_data;
+        }
+
         inline void prefetch(size_t i) const {
             succinct::intrinsics::prefetch(m_data + i);
         }
@@ -114,11 +328,48 @@ namespace succinct { namespace mapper {
         friend class detail::freeze_visitor;
         friend class detail::map_visitor;
         friend class detail::sizeof_visitor;
+        friend class detail::layout_visitor;
+        friend class detail::unpack_visitor;
 
     protected:
+        // m_owner says how m_data is freed: not at all (mapped
+        // memory), with delete[], with huge_deallocate, or by
+        // deleting the owner_base it points to, tagged in the low bits
+        enum {
+            owner_none = 0,
+            owner_array = 1,
+            owner_huge = 2,
+            owner_object = 3,
+            owner_tag_mask = 3
+        };
+
+        void release() {
+            switch (m_owner & owner_tag_mask) {
+            case owner_array:
+                delete[] m_data;
+                break;
+            case owner_huge:
+                detail::huge_deallocate(const_cast<T*>(m_data),
+                                        size_t((m_size + padding_elements) * sizeof(T)));
+                break;
+            case owner_object:
+                delete reinterpret_cast<detail::owner_base*>(m_owner & ~uintptr_t(owner_tag_mask));
+                break;
+            }
+        }
+
         const T* m_data;
         uint64_t m_size;
-        deleter_t m_deleter;
+        uintptr_t m_owner;
     };
 
+    // Reserves room in vec for n elements and the padding that
+    // mappable_vector::steal adds, so that a vector built to its exact
+    // size is stolen without reallocating it
+    template <typename T, typename Allocator>
+    void reserve_padded(std::vector<T, Allocator>& vec, size_t n)
+    {
+        vec.reserve(n + mappable_vector<T>::padding_elements);
+    }
+
 }}
@@ -2,28 +2,176 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#endif
 
 #include <boost/make_shared.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/utility/enable_if.hpp>
 #include <boost/utility.hpp>
 #include <boost/type_traits/is_pod.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "mappable_vector.hpp"
+#include "parallel.hpp"
+#include "util.hpp"
 
 namespace succinct { namespace mapper {
 
     struct freeze_flags {
-        // enum {
-        // };
+        enum {
+            // pad the payload of each vector so that it starts at a
+            // multiple of the alignment, stored as its log2 in bits
+            // 8-15; payloads at least as large as the alignment get
+            // it in full, the others are aligned to a cache line
+            aligned = 1,
+
+            align_cache_line = aligned | (6 << 8),
+            align_page = aligned | (12 << 8),
+            align_huge_page = aligned | (21 << 8),
+
+            // write only the size of the fields marked with derived()
+            // (the indices that can be computed from the other
+            // fields); map() rebuilds them in memory
+            omit_derived = 2
+        };
     };
 
     struct map_flags {
         enum {
-            warmup = 1
+            // fault in the pages of the mapped vectors before
+            // returning, one field at a time, splitting each field
+            // among parallel::num_threads() threads
+            warmup = 1,
+            // madvise(MADV_WILLNEED) the mapped vectors, so that the
+            // kernel starts reading them asynchronously
+            warmup_advise = 2,
+            // madvise(MADV_HUGEPAGE) the 2MB pages of the mapped
+            // vectors, see freeze_flags::align_huge_page
+            advise_hugepage = 4
+        };
+    };
+
+    // Per-field advice applied by map() with a map_policy
+    struct field_advice {
+        enum {
+            none = 0,
+            // mlock the payload, so it is never evicted
+            lock = 1,
+            // madvise(MADV_RANDOM), no readahead
+            random = 2,
+            // madvise(MADV_SEQUENTIAL), aggressive readahead
+            sequential = 4
         };
     };
 
+    // Advice for the vectors of a mapped structure, by field name. A
+    // rule matches a vector if its name is the full path of the
+    // vector (as in warmup_timing) or one of the components of the
+    // path; the outermost matching component wins, so that a rule on
+    // a structure applies to all its vectors.
+    class map_policy {
+    public:
+        map_policy()
+            : m_strict(false)
+        {}
+
+        map_policy& set(std::string const& field, uint64_t advice) {
+            m_rules[field] = advice;
+            return *this;
+        }
+
+        // if strict, map() throws std::runtime_error when a lock fails
+        // (for example because of RLIMIT_MEMLOCK), otherwise the
+        // field is left pageable
+        map_policy& set_strict(bool strict) {
+            m_strict = strict;
+            return *this;
+        }
+
+        bool strict() const {
+            return m_strict;
+        }
+
+        uint64_t advice(std::vector<const char*> const& path) const {
+            if (m_rules.empty()) return field_advice::none;
+            std::string full_path;
+            for (size_t i = 0; i < path.size(); ++i) {
+                if (i) full_path += '.';
+                full_path += path[i];
+            }
+            std::map<std::string, uint64_t>::const_iterator it = m_rules.find(full_path);
+            if (it != m_rules.end()) return it->second;
+            for (size_t i = 0; i < path.size(); ++i) {
+                it = m_rules.find(path[i]);
+                if (it != m_rules.end()) return it->second;
+            }
+            return field_advice::none;
+        }
+
+        // Locks the small directories of the library's structures
+        // (rank samples, select hints and inventories, excess
+        // minima, partition directories), which are hit by every
+        // query, and marks the bulk bits as randomly accessed
+        static map_policy lock_directories() {
+            static const char* directories[] = {
+                "m_block_rank_pairs", "m_select_hints", "m_select0_hints",
+                "m_select_inventory", "m_select0_inventory",
+                "m_block_inventory", "m_subblock_inventory", "m_overflow_positions",
+                "m_inventory", "m_select_samples", "m_select0_samples",
+                "m_l0_ranks", "m_l12_ranks",
+                "m_block_excess_min", "m_superblock_excess_min",
+                "m_upper_bounds", "m_endpoints"
+            };
+            static const char* bulk[] = {
+                "m_bits", "m_data", "m_low_bits"
+            };
+            map_policy policy;
+            for (size_t i = 0; i < sizeof(directories) / sizeof(directories[0]); ++i) {
+                policy.set(directories[i], field_advice::lock);
+            }
+            for (size_t i = 0; i < sizeof(bulk) / sizeof(bulk[0]); ++i) {
+                policy.set(bulk[i], field_advice::random);
+            }
+            return policy;
+        }
+
+    private:
+        std::map<std::string, uint64_t> m_rules;
+        bool m_strict;
+    };
+
+    // time spent warming up a mapped vector, identified by the path of
+    // friendly names from the root, e.g. "<TOP>.m_high_bits.m_bits"
+    struct warmup_timing {
+        std::string name;
+        size_t bytes;
+        double seconds;
+    };
+
+    typedef std::vector<warmup_timing> warmup_timings;
+
+    inline void dump_warmup_timings(warmup_timings const& timings, std::ostream& os = std::cerr)
+    {
+        for (size_t i = 0; i < timings.size(); ++i) {
+            os << timings[i].name << ": "
+               << timings[i].bytes << " bytes, "
+               << timings[i].seconds << " s\n";
+        }
+    }
+
     struct size_node;
     typedef boost::shared_ptr<size_node> size_node_ptr;
 
@@ -31,16 +179,41 @@ namespace succinct { namespace mapper {
     {
         size_node()
             : size(0)
+            , data(0)
+            , data_bytes(0)
+            , pages(0)
+            , resident_pages(0)
+            , touched_pages(0)
         {}
 
         std::string name;
         size_t size;
         std::vector<size_node_ptr> children;
 
+        // for vectors, their payload
+        const char* data;
+        size_t data_bytes;
+
+        // pages spanned by the payloads, and how many of them are
+        // resident (see residency_tree_of) or were accessed (see
+        // access_sampler); a page shared by two vectors is counted in
+        // both
+        size_t pages;
+        size_t resident_pages;
+        size_t touched_pages;
+        // for vectors sampled by access_sampler, which of the pages
+        // were accessed
+        std::vector<uint8_t> touched;
+
         void dump(std::ostream& os = std::cerr, size_t depth = 0) {
             os << std::string(depth * 4, ' ')
                << name << ": "
-               << size << '\n';
+               << size;
+            if (pages) {
+                os << " (" << resident_pages << "/" << pages << " pages resident, "
+                   << touched_pages << " touched)";
+            }
+            os << '\n';
             for (size_t i = 0; i < children.size(); ++i) {
                 children[i]->dump(os, depth + 1);
             }
@@ -48,16 +221,67 @@ namespace succinct { namespace mapper {
     };
 
     namespace detail {
+        // The first word of a frozen structure holds the freeze flags
+        // in the low 32 bits and the format version in bits 32-39.
+        // Version 0 is the unpadded layout, version 1 adds
+        // freeze_flags::aligned, version 2 freeze_flags::omit_derived,
+        // version 3 a zero word after each non-empty vector payload
+        // (see mappable_vector), and version 4 (always written) the
+        // select inventories of rs_bit_vector, which change the layout
+        // of every structure containing one. Files older than
+        // min_format_version cannot be told apart from the current
+        // layout, so map() rejects them: they must be frozen again.
+        static const uint64_t format_version_shift = 32;
+        static const uint64_t min_format_version = 4;
+        static const uint64_t max_format_version = 4;
+
+        inline uint64_t format_version(uint64_t header) {
+            return (header >> format_version_shift) & 0xFF;
+        }
+
+        inline uint64_t freeze_header(uint64_t flags) {
+            return flags | (max_format_version << format_version_shift);
+        }
+
+        inline size_t payload_padding(size_t bytes) {
+            return bytes ? sizeof(uint64_t) : 0;
+        }
+
+        // the size of an omitted vector is written with this bit set,
+        // and its payload is not written
+        static const uint64_t omitted_size_bit = uint64_t(1) << 63;
+
+        // alignment of a payload of the given size, or 0 if unaligned
+        inline size_t payload_alignment(uint64_t flags, size_t bytes) {
+            if (!(flags & freeze_flags::aligned)) return 0;
+            size_t alignment = size_t(1) << ((flags >> 8) & 0xFF);
+            return (bytes >= alignment) ? alignment : std::min(alignment, size_t(64));
+        }
+
+        inline size_t padding(size_t offset, size_t alignment) {
+            return alignment ? (alignment - offset % alignment) % alignment : 0;
+        }
+
         class freeze_visitor : boost::noncopyable {
         public:
             freeze_visitor(std::ofstream& fout, uint64_t flags)
                 : m_fout(fout)
                 , m_flags(flags)
                 , m_written(0)
+                , m_derived_depth(0)
             {
-                // Save freezing flags
-                m_fout.write(reinterpret_cast<const char*>(&m_flags), sizeof(m_flags));
-                m_written += sizeof(m_flags);
+                // Save freezing flags, with the format version
+                uint64_t header = freeze_header(m_flags);
+                m_fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                m_written += sizeof(header);
+            }
+
+            template <typename T>
+            freeze_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                ++m_derived_depth;
+                (*this)(field.ref, friendly_name);
+                --m_derived_depth;
+                return *this;
             }
 
             template <typename T>
@@ -78,12 +302,28 @@ namespace succinct { namespace mapper {
             template<typename T>
             freeze_visitor&
             operator()(mappable_vector<T>& vec, const char* /* friendly_name */) {
+                if (omit(vec.m_size)) {
+                    uint64_t size = vec.m_size | omitted_size_bit;
+                    return (*this)(size, "size");
+                }
                 (*this)(vec.m_size, "size");
 
                 size_t n_bytes = static_cast<size_t>(vec.m_size * sizeof(T));
+                size_t pad = padding(m_written, payload_alignment(m_flags, n_bytes));
+                static const char zeros[4096] = {};
+                for (size_t left = pad; left; ) {
+                    size_t n = std::min(left, sizeof(zeros));
+                    m_fout.write(zeros, long(n));
+                    left -= n;
+                }
+                m_written += pad;
+
                 m_fout.write(reinterpret_cast<const char*>(vec.m_data), long(n_bytes));
                 m_written += n_bytes;
 
+                m_fout.write(zeros, long(payload_padding(n_bytes)));
+                m_written += payload_padding(n_bytes);
+
                 return *this;
             }
 
@@ -92,55 +332,245 @@ namespace succinct { namespace mapper {
             }
 
         protected:
+            bool omit(uint64_t size) const {
+                return size && m_derived_depth && (m_flags & freeze_flags::omit_derived);
+            }
+
             std::ofstream& m_fout;
             const uint64_t m_flags;
             uint64_t m_written;
+            size_t m_derived_depth;
+        };
+
+        inline size_t page_size()
+        {
+#if defined(_WIN32)
+            return 4096;
+#else
+            static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+            return size;
+#endif
+        }
+
+        // first page and number of pages of [begin, begin + bytes)
+        inline std::pair<uintptr_t, size_t> page_range(const char* begin, size_t bytes)
+        {
+            if (!bytes) return std::make_pair(uintptr_t(0), size_t(0));
+            uintptr_t mask = uintptr_t(page_size() - 1);
+            uintptr_t first = uintptr_t(begin) & ~mask;
+            uintptr_t last = (uintptr_t(begin) + bytes + mask) & ~mask;
+            return std::make_pair(first, size_t((last - first) / page_size()));
+        }
+
+        // Sets pages and resident_pages of node and its descendants
+        inline void update_residency(size_node& node)
+        {
+            node.pages = node.resident_pages = 0;
+            if (node.data_bytes) {
+                std::pair<uintptr_t, size_t> range = page_range(node.data, node.data_bytes);
+                node.pages = range.second;
+#if !defined(_WIN32)
+                std::vector<unsigned char> vec(range.second);
+                if (mincore(reinterpret_cast<void*>(range.first), range.second * page_size(), &vec[0]) == 0) {
+                    for (size_t i = 0; i < vec.size(); ++i) {
+                        node.resident_pages += vec[i] & 1;
+                    }
+                }
+#endif
+            }
+            for (size_t i = 0; i < node.children.size(); ++i) {
+                update_residency(*node.children[i]);
+                node.pages += node.children[i]->pages;
+                node.resident_pages += node.children[i]->resident_pages;
+            }
+        }
+
+        inline void advise_willneed(const char* begin, size_t bytes)
+        {
+#if !defined(_WIN32)
+            if (!bytes) return;
+            uintptr_t first = uintptr_t(begin) & ~uintptr_t(page_size() - 1);
+            madvise(reinterpret_cast<void*>(first), uintptr_t(begin) + bytes - first, MADV_WILLNEED);
+#else
+            (void)begin; (void)bytes;
+#endif
+        }
+
+        // Applies the field_advice flags to [begin, begin + bytes);
+        // returns false if the lock failed
+        inline bool apply_advice(const char* begin, size_t bytes, uint64_t advice)
+        {
+            bool ok = true;
+#if !defined(_WIN32)
+            if (!advice) return true;
+            std::pair<uintptr_t, size_t> range = page_range(begin, bytes);
+            if (!range.second) return true;
+            void* addr = reinterpret_cast<void*>(range.first);
+            size_t len = range.second * page_size();
+            if (advice & field_advice::random) {
+                madvise(addr, len, MADV_RANDOM);
+            }
+            if (advice & field_advice::sequential) {
+                madvise(addr, len, MADV_SEQUENTIAL);
+            }
+            if (advice & field_advice::lock) {
+                ok = mlock(addr, len) == 0;
+            }
+#else
+            (void)begin; (void)bytes; (void)advice;
+#endif
+            return ok;
+        }
+
+        // madvise(MADV_HUGEPAGE) the 2MB pages fully contained in
+        // [begin, begin + bytes)
+        inline void advise_hugepage(const char* begin, size_t bytes)
+        {
+#if defined(MADV_HUGEPAGE)
+            const uintptr_t huge_page = uintptr_t(1) << 21;
+            uintptr_t first = (uintptr_t(begin) + huge_page - 1) & ~(huge_page - 1);
+            uintptr_t last = (uintptr_t(begin) + bytes) & ~(huge_page - 1);
+            if (first < last) {
+                madvise(reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE);
+            }
+#else
+            (void)begin; (void)bytes;
+#endif
+        }
+
+        // Faults in the pages of [begin, begin + bytes), with
+        // MADV_POPULATE_READ where available, otherwise reading a
+        // byte per page
+        inline void populate(const char* begin, size_t bytes)
+        {
+            if (!bytes) return;
+#if defined(MADV_POPULATE_READ)
+            uintptr_t first = uintptr_t(begin) & ~uintptr_t(page_size() - 1);
+            if (madvise(reinterpret_cast<void*>(first), uintptr_t(begin) + bytes - first,
+                        MADV_POPULATE_READ) == 0) {
+                return;
+            }
+#endif
+            volatile char sink = 0;
+            for (size_t offset = 0; offset < bytes; offset += page_size()) {
+                sink = char(sink + begin[offset]);
+            }
+            sink = char(sink + begin[bytes - 1]);
+        }
+
+        struct populate_worker {
+            static const size_t chunk_bytes = 4 << 20;
+
+            populate_worker(const char* begin, size_t bytes)
+                : m_begin(begin)
+                , m_bytes(bytes)
+            {}
+
+            size_t num_chunks() const {
+                return (m_bytes + chunk_bytes - 1) / chunk_bytes;
+            }
+
+            void operator()(size_t i) {
+                size_t offset = i * chunk_bytes;
+                populate(m_begin + offset, std::min(size_t(chunk_bytes), m_bytes - offset));
+            }
+
+            const char* m_begin;
+            size_t m_bytes;
         };
 
         class map_visitor : boost::noncopyable {
         public:
-            map_visitor(const char* base_address, uint64_t flags)
+            map_visitor(const char* base_address, uint64_t flags, map_policy const* policy = 0)
                 : m_base(base_address)
                 , m_cur(m_base)
                 , m_flags(flags)
+                , m_policy(policy)
+                , m_omitted(false)
             {
-                m_freeze_flags = *reinterpret_cast<const uint64_t*>(m_cur);
-                m_cur += sizeof(m_freeze_flags);
+                uint64_t header = *reinterpret_cast<const uint64_t*>(m_cur);
+                uint64_t version = format_version(header);
+                if (version > max_format_version) {
+                    throw std::runtime_error("Unsupported frozen format version "
+                                             + boost::lexical_cast<std::string>(version));
+                }
+                if (version < min_format_version) {
+                    throw std::runtime_error("Frozen format version "
+                                             + boost::lexical_cast<std::string>(version)
+                                             + " is no longer supported, the structure must be frozen again");
+                }
+                m_freeze_flags = header & 0xFFFFFFFF;
+                m_cur += sizeof(header);
             }
 
             template <typename T>
             typename boost::disable_if<boost::is_pod<T>, map_visitor&>::type
-            operator()(T& val, const char* /* friendly_name */) {
+            operator()(T& val, const char* friendly_name) {
+                m_path.push_back(friendly_name);
                 val.map(*this);
+                m_path.pop_back();
                 return *this;
             }
 
+            template <typename T>
+            map_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                return (*this)(field.ref, friendly_name);
+            }
+
             template <typename T>
             typename boost::enable_if<boost::is_pod<T>, map_visitor&>::type
             operator()(T& val, const char* /* friendly_name */) {
-                val = *reinterpret_cast<const T*>(m_cur);
+                // fields after a vector of small elements can be unaligned
+                memcpy(&val, m_cur, sizeof(T));
                 m_cur += sizeof(T);
                 return *this;
             }
 
             template<typename T>
             map_visitor&
-            operator()(mappable_vector<T>& vec, const char* /* friendly_name */) {
+            operator()(mappable_vector<T>& vec, const char* friendly_name) {
                 vec.clear();
                 (*this)(vec.m_size, "size");
+                if (vec.m_size & omitted_size_bit) {
+                    // placeholder, to be rebuilt
+                    vec.m_size &= ~omitted_size_bit;
+                    m_omitted = true;
+                    return *this;
+                }
 
-                vec.m_data = reinterpret_cast<const T*>(m_cur);
                 size_t bytes = vec.m_size * sizeof(T);
+                m_cur += padding(bytes_read(), payload_alignment(m_freeze_flags, bytes));
+                vec.m_data = reinterpret_cast<const T*>(m_cur);
 
+                if (m_flags & map_flags::advise_hugepage) {
+                    advise_hugepage(m_cur, bytes);
+                }
+                if (m_flags & map_flags::warmup_advise) {
+                    advise_willneed(m_cur, bytes);
+                }
+                if (m_policy) {
+                    m_path.push_back(friendly_name);
+                    uint64_t advice = m_policy->advice(m_path);
+                    m_path.pop_back();
+                    if (!apply_advice(m_cur, bytes, advice) && m_policy->strict()) {
+                        throw std::runtime_error(std::string("Unable to lock field ") + friendly_name);
+                    }
+                }
                 if (m_flags & map_flags::warmup) {
-                    T foo;
-                    volatile T* bar = &foo;
-                    for (size_t i = 0; i < vec.m_size; ++i) {
-                        *bar = vec.m_data[i];
+                    m_path.push_back(friendly_name);
+                    warmup_timing field;
+                    for (size_t i = 0; i < m_path.size(); ++i) {
+                        if (i) field.name += '.';
+                        field.name += m_path[i];
                     }
+                    m_path.pop_back();
+                    field.bytes = bytes;
+                    field.seconds = 0;
+                    m_fields.push_back(field);
+                    m_field_data.push_back(m_cur);
                 }
 
-                m_cur += bytes;
+                m_cur += bytes + payload_padding(bytes);
                 return *this;
             }
 
@@ -148,17 +578,49 @@ namespace succinct { namespace mapper {
                 return size_t(m_cur - m_base);
             }
 
+            // faults in the fields recorded with map_flags::warmup
+            void warmup() {
+                for (size_t i = 0; i < m_fields.size(); ++i) {
+                    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+                    populate_worker worker(m_field_data[i], m_fields[i].bytes);
+                    parallel::for_each(worker.num_chunks(), worker);
+                    m_fields[i].seconds = double((boost::posix_time::microsec_clock::universal_time() - start)
+                                                 .total_microseconds()) / 1000000;
+                }
+            }
+
+            warmup_timings const& timings() const {
+                return m_fields;
+            }
+
+            // whether there were omitted derived fields
+            bool omitted() const {
+                return m_omitted;
+            }
+
         protected:
             const char* m_base;
             const char* m_cur;
             const uint64_t m_flags;
+            map_policy const* m_policy;
+            bool m_omitted;
             uint64_t m_freeze_flags;
+            std::vector<const char*> m_path;
+            warmup_timings m_fields;
+            std::vector<const char*> m_field_data;
         };
 
+        // Counts the bytes freeze_visitor would write with the given
+        // flags, including the header, the payload alignment and
+        // padding, and omitted derived fields; the size of the top
+        // node includes the header
         class sizeof_visitor : boost::noncopyable {
         public:
-            sizeof_visitor(bool with_tree = false)
-                : m_size(0)
+            sizeof_visitor(bool with_tree = false, uint64_t flags = 0)
+                : m_size(sizeof(uint64_t)) // header
+                , m_flags(flags)
+                , m_depth(0)
+                , m_derived_depth(0)
             {
                 if (with_tree) {
                     m_cur_size_node = boost::make_shared<size_node>();
@@ -168,14 +630,16 @@ namespace succinct { namespace mapper {
             template <typename T>
             typename boost::disable_if<boost::is_pod<T>, sizeof_visitor&>::type
             operator()(T& val, const char* friendly_name) {
-                size_t checkpoint = m_size;
+                size_t checkpoint = m_depth ? m_size : 0;
                 size_node_ptr parent_node;
                 if (m_cur_size_node) {
                     parent_node = m_cur_size_node;
                     m_cur_size_node = make_node(friendly_name);
                 }
 
+                ++m_depth;
                 val.map(*this);
+                --m_depth;
 
                 if (m_cur_size_node) {
                     m_cur_size_node->size = m_size - checkpoint;
@@ -184,6 +648,14 @@ namespace succinct { namespace mapper {
                 return *this;
             }
 
+            template <typename T>
+            sizeof_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                ++m_derived_depth;
+                (*this)(field.ref, friendly_name);
+                --m_derived_depth;
+                return *this;
+            }
+
             template <typename T>
             typename boost::enable_if<boost::is_pod<T>, sizeof_visitor&>::type
             operator()(T& /* val */, const char* /* friendly_name */) {
@@ -195,12 +667,19 @@ namespace succinct { namespace mapper {
             template<typename T>
             sizeof_visitor&
             operator()(mappable_vector<T>& vec, const char* friendly_name) {
-                size_t checkpoint = m_size;
+                size_t checkpoint = m_depth ? m_size : 0;
                 (*this)(vec.m_size, "size");
-                m_size += static_cast<size_t>(vec.m_size * sizeof(T));
+                size_t n_bytes = static_cast<size_t>(vec.m_size * sizeof(T));
+                if (!(vec.m_size && m_derived_depth && (m_flags & freeze_flags::omit_derived))) {
+                    m_size += padding(m_size, payload_alignment(m_flags, n_bytes));
+                    m_size += n_bytes + payload_padding(n_bytes);
+                }
 
                 if (m_cur_size_node) {
-                    make_node(friendly_name)->size = m_size - checkpoint;
+                    size_node_ptr node = make_node(friendly_name);
+                    node->size = m_size - checkpoint;
+                    node->data = reinterpret_cast<const char*>(vec.m_data);
+                    node->data_bytes = n_bytes;
                 }
 
                 return *this;
@@ -226,11 +705,258 @@ namespace succinct { namespace mapper {
             }
 
             size_t m_size;
+            const uint64_t m_flags;
+            size_t m_depth;
+            size_t m_derived_depth;
             size_node_ptr m_cur_size_node;
         };
 
+        // A contiguous range of the frozen file: either a payload
+        // (data points to it), zero padding (data is 0), or scalars
+        // collected in the layout_visitor buffer at buffer_pos
+        struct freeze_segment {
+            uint64_t offset;
+            const char* data;
+            size_t bytes;
+            bool buffered;
+            size_t buffer_pos;
+        };
+
+        // Computes the layout freeze_visitor would write, without
+        // copying the payloads
+        class layout_visitor : boost::noncopyable {
+        public:
+            layout_visitor(uint64_t flags)
+                : m_flags(flags)
+                , m_size(0)
+                , m_derived_depth(0)
+            {
+                uint64_t header = freeze_header(m_flags);
+                append_buffered(reinterpret_cast<const char*>(&header), sizeof(header));
+            }
+
+            template <typename T>
+            layout_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                ++m_derived_depth;
+                (*this)(field.ref, friendly_name);
+                --m_derived_depth;
+                return *this;
+            }
+
+            template <typename T>
+            typename boost::disable_if<boost::is_pod<T>, layout_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                val.map(*this);
+                return *this;
+            }
+
+            template <typename T>
+            typename boost::enable_if<boost::is_pod<T>, layout_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                append_buffered(reinterpret_cast<const char*>(&val), sizeof(T));
+                return *this;
+            }
+
+            template<typename T>
+            layout_visitor&
+            operator()(mappable_vector<T>& vec, const char* /* friendly_name */) {
+                if (vec.m_size && m_derived_depth && (m_flags & freeze_flags::omit_derived)) {
+                    uint64_t size = vec.m_size | omitted_size_bit;
+                    return (*this)(size, "size");
+                }
+                (*this)(vec.m_size, "size");
+
+                size_t n_bytes = static_cast<size_t>(vec.m_size * sizeof(T));
+                append(0, padding(m_size, payload_alignment(m_flags, n_bytes)));
+                append(reinterpret_cast<const char*>(vec.m_data), n_bytes);
+                append(0, payload_padding(n_bytes));
+                return *this;
+            }
+
+            uint64_t size() const {
+                return m_size;
+            }
+
+            // the segments, in file order; valid as long as the
+            // visitor and the frozen structure are alive
+            std::vector<freeze_segment> const& segments() {
+                for (size_t i = 0; i < m_segments.size(); ++i) {
+                    if (m_segments[i].buffered) {
+                        m_segments[i].data = &m_buffer[m_segments[i].buffer_pos];
+                        m_segments[i].buffered = false;
+                    }
+                }
+                return m_segments;
+            }
+
+        private:
+            void append(const char* data, size_t bytes) {
+                if (!bytes) return;
+                freeze_segment seg = {m_size, data, bytes, false, 0};
+                m_segments.push_back(seg);
+                m_size += bytes;
+            }
+
+            void append_buffered(const char* data, size_t bytes) {
+                if (m_segments.empty() || !m_segments.back().buffered) {
+                    freeze_segment seg = {m_size, 0, 0, true, m_buffer.size()};
+                    m_segments.push_back(seg);
+                }
+                m_buffer.insert(m_buffer.end(), data, data + bytes);
+                m_segments.back().bytes += bytes;
+                m_size += bytes;
+            }
+
+            const uint64_t m_flags;
+            uint64_t m_size;
+            size_t m_derived_depth;
+            std::vector<char> m_buffer;
+            std::vector<freeze_segment> m_segments;
+        };
+
+        // Calls rebuild_derived() on the structures, children first
+        class rebuild_visitor : boost::noncopyable {
+        public:
+            template <typename T>
+            typename boost::disable_if<boost::is_pod<T>, rebuild_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                val.map(*this);
+                mapper::rebuild_derived(val);
+                return *this;
+            }
+
+            template <typename T>
+            typename boost::enable_if<boost::is_pod<T>, rebuild_visitor&>::type
+            operator()(T& /* val */, const char* /* friendly_name */) {
+                return *this;
+            }
+
+            template <typename T>
+            rebuild_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                return (*this)(field.ref, friendly_name);
+            }
+
+            template<typename T>
+            rebuild_visitor& operator()(mappable_vector<T>& /* vec */, const char* /* friendly_name */) {
+                return *this;
+            }
+        };
+
+        template <typename T>
+        void finish_map(map_visitor& mapper, T& val, const char* friendly_name)
+        {
+            mapper.warmup();
+            if (mapper.omitted()) {
+                rebuild_visitor rebuilder;
+                rebuilder(val, friendly_name);
+            }
+        }
+
+#if !defined(_WIN32)
+        inline bool pwrite_all(int fd, const char* data, size_t bytes, uint64_t offset)
+        {
+            while (bytes) {
+                ssize_t written = pwrite(fd, data, bytes, off_t(offset));
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                data += written;
+                bytes -= size_t(written);
+                offset += uint64_t(written);
+            }
+            return true;
+        }
+
+        // Writes the chunk-th chunk of the file described by
+        // segments. With O_DIRECT the chunk is assembled in an aligned
+        // buffer and padded to a whole number of blocks, otherwise
+        // each segment is written from where it is. Zero padding is
+        // skipped, as the file is preallocated with zeros.
+        struct pwrite_chunk_writer {
+            static const size_t chunk_size = 16 << 20;
+            static const size_t direct_alignment = 4096;
+
+            pwrite_chunk_writer(int fd, bool direct, uint64_t size,
+                                std::vector<freeze_segment> const& segments)
+                : m_fd(fd)
+                , m_direct(direct)
+                , m_size(size)
+                , m_segments(&segments)
+                , m_failed(util::ceil_div(size, chunk_size))
+            {}
+
+            void operator()(size_t chunk) {
+                uint64_t begin = uint64_t(chunk) * chunk_size;
+                uint64_t end = std::min(begin + chunk_size, m_size);
+                char* buf = 0;
+                if (m_direct && posix_memalign(reinterpret_cast<void**>(&buf), direct_alignment, chunk_size)) {
+                    m_failed[chunk] = 1;
+                    return;
+                }
+
+                std::vector<freeze_segment> const& segs = *m_segments;
+                size_t i = first_segment(begin);
+                bool ok = true;
+                for (; ok && i < segs.size() && segs[i].offset < end; ++i) {
+                    uint64_t lo = std::max(begin, segs[i].offset);
+                    uint64_t hi = std::min(end, segs[i].offset + segs[i].bytes);
+                    if (buf) {
+                        char* dest = buf + (lo - begin);
+                        if (segs[i].data) {
+                            std::copy(segs[i].data + (lo - segs[i].offset),
+                                      segs[i].data + (hi - segs[i].offset), dest);
+                        } else {
+                            std::fill(dest, dest + (hi - lo), 0);
+                        }
+                    } else if (segs[i].data) {
+                        ok = pwrite_all(m_fd, segs[i].data + (lo - segs[i].offset), size_t(hi - lo), lo);
+                    }
+                }
+
+                if (buf) {
+                    size_t bytes = size_t(end - begin);
+                    size_t padded = bytes + padding(bytes, direct_alignment);
+                    std::fill(buf + bytes, buf + padded, 0);
+                    ok = ok && pwrite_all(m_fd, buf, padded, begin);
+                    free(buf);
+                }
+                m_failed[chunk] = !ok;
+            }
+
+            size_t first_segment(uint64_t offset) const {
+                // last segment starting at or before offset
+                std::vector<freeze_segment> const& segs = *m_segments;
+                size_t lo = 0, hi = segs.size();
+                while (hi - lo > 1) {
+                    size_t mid = (lo + hi) / 2;
+                    if (segs[mid].offset <= offset) {
+                        lo = mid;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                return lo;
+            }
+
+            bool failed() const {
+                return std::find(m_failed.begin(), m_failed.end(), 1) != m_failed.end();
+            }
+
+            int m_fd;
+            bool m_direct;
+            uint64_t m_size;
+            std::vector<freeze_segment> const* m_segments;
+            std::vector<uint8_t> m_failed;
+        };
+#endif
     }
 
+    // With freeze_flags::aligned the payload offsets are aligned
+    // relative to the start of the frozen structure, so the memory
+    // they are mapped at is aligned only if the base address is: mmap
+    // gives page alignment, 2MB alignment needs a hugetlbfs file or a
+    // mapping placed at a 2MB boundary.
     template <typename T>
     size_t freeze(T& val, std::ofstream& fout, uint64_t flags = 0, const char* friendly_name = "<TOP>")
     {
@@ -246,11 +972,69 @@ namespace succinct { namespace mapper {
         return freeze(val, fout, flags, friendly_name);
     }
 
+    // Same output as freeze(), but the layout is computed first and
+    // the file is written in 16MB chunks with pwrite from
+    // parallel::num_threads() threads, after preallocating it. With
+    // direct the chunks are written with O_DIRECT, if the filesystem
+    // supports it. Throws std::runtime_error if the file cannot be
+    // written.
+    template <typename T>
+    size_t freeze_parallel(T& val, const char* filename, uint64_t flags = 0,
+                           bool direct = false, const char* friendly_name = "<TOP>")
+    {
+#if defined(_WIN32)
+        (void)direct;
+        return freeze(val, filename, flags, friendly_name);
+#else
+        detail::layout_visitor layout(flags);
+        layout(val, friendly_name);
+        uint64_t size = layout.size();
+
+        int fd = -1;
+#if defined(O_DIRECT)
+        if (direct) {
+            fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        }
+#endif
+        direct = fd >= 0;
+        if (!direct) {
+            fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Unable to open file '") + filename + "'.");
+        }
+
+        // preallocate, so that the concurrent writes do not extend
+        // the file and the padding does not need to be written
+        bool ok = true;
+        if (size) {
+            if (posix_fallocate(fd, 0, off_t(size)) != 0) {
+                ok = ftruncate(fd, off_t(size)) == 0;
+            }
+        }
+
+        detail::pwrite_chunk_writer writer(fd, direct, size, layout.segments());
+        if (ok) {
+            parallel::for_each(util::ceil_div(size, writer.chunk_size), writer);
+            ok = !writer.failed();
+        }
+        // O_DIRECT writes whole blocks, so the last one may need to
+        // be trimmed
+        ok = ok && ftruncate(fd, off_t(size)) == 0;
+        ok = (close(fd) == 0) && ok;
+        if (!ok) {
+            throw std::runtime_error(std::string("Error writing file '") + filename + "'.");
+        }
+        return size_t(size);
+#endif
+    }
+
     template <typename T>
     size_t map(T& val, const char* base_address, uint64_t flags = 0, const char* friendly_name = "<TOP>")
     {
         detail::map_visitor mapper(base_address, flags);
         mapper(val, friendly_name);
+        detail::finish_map(mapper, val, friendly_name);
         return mapper.bytes_read();
     }
 
@@ -260,21 +1044,74 @@ namespace succinct { namespace mapper {
         return map(val, m.data(), flags, friendly_name);
     }
 
+    // same as above, and stores in timings the time spent warming up
+    // each field, if flags has map_flags::warmup
+    template <typename T>
+    size_t map(T& val, const char* base_address, uint64_t flags, warmup_timings& timings,
+               const char* friendly_name = "<TOP>")
+    {
+        detail::map_visitor mapper(base_address, flags);
+        mapper(val, friendly_name);
+        detail::finish_map(mapper, val, friendly_name);
+        timings = mapper.timings();
+        return mapper.bytes_read();
+    }
+
     template <typename T>
-    size_t size_of(T& val)
+    size_t map(T& val, boost::iostreams::mapped_file_source const& m, uint64_t flags, warmup_timings& timings,
+               const char* friendly_name = "<TOP>")
     {
-        detail::sizeof_visitor sizer;
+        return map(val, m.data(), flags, timings, friendly_name);
+    }
+
+    // same as above, and applies the advice of policy to each
+    // vector; the locks last as long as the memory is mapped
+    template <typename T>
+    size_t map(T& val, const char* base_address, uint64_t flags, map_policy const& policy,
+               const char* friendly_name = "<TOP>")
+    {
+        detail::map_visitor mapper(base_address, flags, &policy);
+        mapper(val, friendly_name);
+        detail::finish_map(mapper, val, friendly_name);
+        return mapper.bytes_read();
+    }
+
+    template <typename T>
+    size_t map(T& val, boost::iostreams::mapped_file_source const& m, uint64_t flags, map_policy const& policy,
+               const char* friendly_name = "<TOP>")
+    {
+        return map(val, m.data(), flags, policy, friendly_name);
+    }
+
+    // Bytes written by freeze(val) with the given flags
+    template <typename T>
+    size_t size_of(T& val, uint64_t flags = 0)
+    {
+        detail::sizeof_visitor sizer(false, flags);
         sizer(val, "");
         return sizer.size();
     }
 
+    // Sizes of the fields of val as frozen with the given flags, each
+    // with its padding; the root includes the header, so its size is
+    // size_of(val, flags)
     template <typename T>
-    size_node_ptr size_tree_of(T& val, const char* friendly_name = "<TOP>")
+    size_node_ptr size_tree_of(T& val, const char* friendly_name = "<TOP>", uint64_t flags = 0)
     {
-        detail::sizeof_visitor sizer(true);
+        detail::sizeof_visitor sizer(true, flags);
         sizer(val, friendly_name);
         assert(sizer.size_tree()->children.size());
         return sizer.size_tree()->children[0];
     }
 
+    // size_tree_of, with the number of pages of each field and how
+    // many of them are resident (with mincore)
+    template <typename T>
+    size_node_ptr residency_tree_of(T& val, const char* friendly_name = "<TOP>", uint64_t flags = 0)
+    {
+        size_node_ptr tree = size_tree_of(val, friendly_name, flags);
+        detail::update_residency(*tree);
+        return tree;
+    }
+
 }}
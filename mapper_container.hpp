@@ -0,0 +1,267 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "mapper.hpp"
+
+namespace succinct { namespace mapper {
+
+    // A container file holds several named structures, each frozen
+    // with freeze() into its own section, followed by a directory of
+    // the sections:
+    //
+    //   header (magic, version)
+    //   section 0, section 1, ...
+    //   directory (frozen container_directory)
+    //   trailer (directory offset, magic)
+    //
+    // Each section starts at a multiple of its payload alignment, so
+    // the layout of freeze_flags::aligned is preserved. New sections
+    // and a new directory are appended after the old trailer, which is
+    // never overwritten: if an append is interrupted, truncating the
+    // file to its previous size gives back the old container.
+
+    namespace detail {
+        static const uint64_t container_magic = 0x544e4f43435553ULL; // "SUCCONT"
+        static const uint64_t container_version = 1;
+
+        struct container_directory {
+            template <typename Visitor>
+            void map(Visitor& visit) {
+                visit
+                    (names, "names")
+                    (offsets, "offsets")
+                    (sizes, "sizes")
+                    ;
+            }
+
+            // names are concatenated, each terminated by '\0'
+            mappable_vector<char> names;
+            mappable_vector<uint64_t> offsets;
+            mappable_vector<uint64_t> sizes;
+        };
+
+        struct container_section {
+            std::string name;
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        typedef std::vector<container_section> container_sections;
+
+        inline void read_container_directory(const char* base, size_t file_size,
+                                             container_sections& sections)
+        {
+            const uint64_t* header = reinterpret_cast<const uint64_t*>(base);
+            if (file_size < 4 * sizeof(uint64_t) || header[0] != container_magic) {
+                throw std::runtime_error("Not a container file");
+            }
+            if (header[1] > container_version) {
+                throw std::runtime_error("Unsupported container version");
+            }
+            const uint64_t* trailer = reinterpret_cast<const uint64_t*>(base + file_size) - 2;
+            if (trailer[1] != container_magic || trailer[0] >= file_size) {
+                throw std::runtime_error("Corrupted container file");
+            }
+
+            container_directory dir;
+            mapper::map(dir, base + trailer[0]);
+            sections.resize(dir.offsets.size());
+            const char* name = dir.names.data();
+            for (size_t i = 0; i < sections.size(); ++i) {
+                sections[i].name = name;
+                name += sections[i].name.size() + 1;
+                sections[i].offset = dir.offsets[i];
+                sections[i].size = dir.sizes[i];
+            }
+        }
+    }
+
+    class container_writer : boost::noncopyable {
+    public:
+        // Creates the container, or if append is true adds sections
+        // to an existing one
+        container_writer(const char* filename, bool append = false)
+            : m_filename(filename)
+            , m_closed(false)
+        {
+            if (append) {
+                {
+                    boost::iostreams::mapped_file_source m(filename);
+                    detail::read_container_directory(m.data(), m.size(), m_sections);
+                }
+                m_fout.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+                m_fout.seekp(0, std::ios::end);
+            } else {
+                m_fout.open(filename, std::ios::binary | std::ios::trunc);
+                uint64_t header[] = {detail::container_magic, detail::container_version};
+                m_fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+            }
+            if (!m_fout) {
+                throw std::invalid_argument("Unable to open file '" + m_filename + "'.");
+            }
+        }
+
+        // Errors are swallowed here; call close() to see them
+        ~container_writer() {
+            if (!m_closed) {
+                try {
+                    close();
+                } catch (...) {
+                }
+            }
+        }
+
+        // Freezes val in a new section called name, and returns its
+        // size
+        template <typename T>
+        size_t add(T& val, const char* name, uint64_t flags = 0) {
+            assert(!m_closed);
+            for (size_t i = 0; i < m_sections.size(); ++i) {
+                if (m_sections[i].name == name) {
+                    throw std::invalid_argument(std::string("Duplicate section '") + name + "'.");
+                }
+            }
+
+            size_t alignment = (flags & freeze_flags::aligned)
+                ? size_t(1) << ((flags >> 8) & 0xFF)
+                : sizeof(uint64_t);
+            pad(alignment);
+
+            detail::container_section section;
+            section.name = name;
+            section.offset = uint64_t(m_fout.tellp());
+            section.size = freeze(val, m_fout, flags, name);
+            m_sections.push_back(section);
+            return section.size;
+        }
+
+        // Writes the directory; called by the destructor if needed
+        void close() {
+            assert(!m_closed);
+            m_closed = true;
+            std::vector<char> names;
+            std::vector<uint64_t> offsets, sizes;
+            for (size_t i = 0; i < m_sections.size(); ++i) {
+                names.insert(names.end(), m_sections[i].name.begin(), m_sections[i].name.end());
+                names.push_back('\0');
+                offsets.push_back(m_sections[i].offset);
+                sizes.push_back(m_sections[i].size);
+            }
+            detail::container_directory dir;
+            dir.names.steal(names);
+            dir.offsets.steal(offsets);
+            dir.sizes.steal(sizes);
+
+            pad(sizeof(uint64_t));
+            uint64_t trailer[] = {uint64_t(m_fout.tellp()), detail::container_magic};
+            freeze(dir, m_fout);
+            m_fout.write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+            m_fout.close();
+            if (!m_fout) {
+                throw std::runtime_error("Error writing file '" + m_filename + "'.");
+            }
+        }
+
+    private:
+        void pad(size_t alignment) {
+            uint64_t offset = uint64_t(m_fout.tellp());
+            size_t n = size_t(detail::padding(size_t(offset), alignment));
+            static const char zeros[4096] = {};
+            while (n) {
+                size_t l = std::min(n, sizeof(zeros));
+                m_fout.write(zeros, long(l));
+                n -= l;
+            }
+        }
+
+        std::string m_filename;
+        std::ofstream m_fout;
+        detail::container_sections m_sections;
+        bool m_closed;
+    };
+
+    // Read-only view of a container file. The file is memory mapped
+    // as a whole, but mapping a section only touches its own pages
+    // (and the warmup flags of map() apply to that section only).
+    class container : boost::noncopyable {
+    public:
+        container(const char* filename)
+            : m_file(filename)
+        {
+            detail::read_container_directory(m_file.data(), m_file.size(), m_sections);
+            for (size_t i = 0; i < m_sections.size(); ++i) {
+                m_index[m_sections[i].name] = i;
+            }
+        }
+
+        size_t size() const {
+            return m_sections.size();
+        }
+
+        std::string const& name(size_t i) const {
+            return m_sections[i].name;
+        }
+
+        bool contains(std::string const& name) const {
+            return m_index.count(name) != 0;
+        }
+
+        // Maps the section called name into val
+        template <typename T>
+        size_t map(T& val, std::string const& name, uint64_t flags = 0) const {
+            detail::container_section const& s = section(name);
+            size_t read = mapper::map(val, m_file.data() + s.offset, flags, name.c_str());
+            assert(read == s.size);
+            return read;
+        }
+
+        template <typename T>
+        size_t map(T& val, std::string const& name, uint64_t flags,
+                   warmup_timings& timings) const {
+            detail::container_section const& s = section(name);
+            return mapper::map(val, m_file.data() + s.offset, flags, timings, name.c_str());
+        }
+
+        // Start of the section called name, for mapping it elsewhere
+        // (as with background_map)
+        const char* data(std::string const& name) const {
+            return m_file.data() + section(name).offset;
+        }
+
+        // Sizes of the sections, as children of the root; use
+        // size_tree_of on a mapped structure for its fields
+        size_node_ptr size_tree() const {
+            size_node_ptr root = boost::make_shared<size_node>();
+            root->name = "<CONTAINER>";
+            for (size_t i = 0; i < m_sections.size(); ++i) {
+                size_node_ptr node = boost::make_shared<size_node>();
+                node->name = m_sections[i].name;
+                node->size = m_sections[i].size;
+                root->children.push_back(node);
+                root->size += node->size;
+            }
+            return root;
+        }
+
+    private:
+        detail::container_section const& section(std::string const& name) const {
+            std::map<std::string, size_t>::const_iterator it = m_index.find(name);
+            if (it == m_index.end()) {
+                throw std::invalid_argument("No section '" + name + "' in container.");
+            }
+            return m_sections[it->second];
+        }
+
+        boost::iostreams::mapped_file_source m_file;
+        detail::container_sections m_sections;
+        std::map<std::string, size_t> m_index;
+    };
+
+}}
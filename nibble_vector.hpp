@@ -46,6 +46,8 @@ namespace succinct {
                 (m_nibbles, "m_nibbles");
         }
 
+        SUCCINCT_MOVE_BY_SWAP(nibble_vector)
+
         void swap(nibble_vector& other) {
             std::swap(other.m_size, m_size);
             other.m_nibbles.swap(m_nibbles);
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/thread/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+
+#include "mapper.hpp"
+
+namespace succinct { namespace mapper {
+
+    // One copy of a frozen structure per NUMA node, so that queries
+    // read node-local memory. Each replica is allocated with its
+    // memory bound to the node (mbind), then filled and mapped by a
+    // thread running on the node's CPUs; local() returns the replica of the node the
+    // calling thread runs on. On non-NUMA systems (or outside Linux)
+    // there is a single replica. POSIX only.
+
+    namespace detail {
+        // parses a list such as "0-3,8,10-11"
+        inline std::vector<size_t> parse_id_list(std::string const& s)
+        {
+            std::vector<size_t> ids;
+            size_t i = 0;
+            while (i < s.size()) {
+                char* end;
+                size_t first = strtoul(s.c_str() + i, &end, 10);
+                size_t last = first;
+                if (*end == '-') {
+                    last = strtoul(end + 1, &end, 10);
+                }
+                if (end == s.c_str() + i) break;
+                for (size_t id = first; id <= last; ++id) {
+                    ids.push_back(id);
+                }
+                i = size_t(end - s.c_str());
+                if (i < s.size() && s[i] == ',') ++i;
+                else break;
+            }
+            return ids;
+        }
+
+        inline std::string read_sysfs(std::string const& path)
+        {
+            std::ifstream fin(path.c_str());
+            std::string line;
+            std::getline(fin, line);
+            return line;
+        }
+
+        inline std::vector<size_t> numa_nodes()
+        {
+            std::vector<size_t> nodes;
+#if defined(__linux__)
+            nodes = parse_id_list(read_sysfs("/sys/devices/system/node/online"));
+#endif
+            if (nodes.empty()) {
+                nodes.push_back(0);
+            }
+            return nodes;
+        }
+
+        inline std::vector<size_t> numa_node_cpus(size_t node)
+        {
+            return parse_id_list(read_sysfs("/sys/devices/system/node/node"
+                                            + boost::lexical_cast<std::string>(node)
+                                            + "/cpulist"));
+        }
+
+        // CPU the calling thread runs on, or -1 if unknown;
+        // sched_getcpu goes through the vDSO, without a system call
+        inline int current_cpu()
+        {
+#if defined(__linux__)
+            return sched_getcpu();
+#else
+            return -1;
+#endif
+        }
+
+        // Binds the pages of [addr, addr + len) to node; best effort
+        inline void bind_to_node(void* addr, size_t len, size_t node)
+        {
+#if defined(__linux__) && defined(SYS_mbind)
+            const int mpol_bind = 2; // MPOL_BIND in numaif.h
+            const unsigned long max_nodes = 1024;
+            unsigned long mask[max_nodes / (8 * sizeof(unsigned long))] = {};
+            if (node >= max_nodes) return;
+            mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            syscall(SYS_mbind, addr, len, mpol_bind, mask, max_nodes, 0);
+#else
+            (void)addr; (void)len; (void)node;
+#endif
+        }
+
+        // Copies the image into the replica and maps a T from it, from
+        // a thread running on the replica's node, so that the pages of
+        // the copy and of the derived indices rebuilt by map() (see
+        // freeze_flags::omit_derived) are faulted there; the threads
+        // of parallel::for_each inherit the affinity. An exception is
+        // stored in error, to be rethrown by the constructing thread.
+        template <typename T>
+        struct replica_filler {
+            replica_filler(const char* image, size_t size, char* replica, size_t replica_size,
+                           size_t node, uint64_t flags, T& target, boost::exception_ptr& error)
+                : m_image(image)
+                , m_size(size)
+                , m_replica(replica)
+                , m_replica_size(replica_size)
+                , m_node(node)
+                , m_flags(flags)
+                , m_target(&target)
+                , m_error(&error)
+            {}
+
+            void operator()() const {
+                try {
+#if defined(__linux__)
+                    std::vector<size_t> cpus = numa_node_cpus(m_node);
+                    if (!cpus.empty()) {
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        for (size_t i = 0; i < cpus.size(); ++i) {
+                            if (cpus[i] < CPU_SETSIZE) CPU_SET(cpus[i], &set);
+                        }
+                        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                    }
+#endif
+                    memcpy(m_replica, m_image, m_size);
+                    mprotect(m_replica, m_replica_size, PROT_READ);
+                    mapper::map(*m_target, m_replica, m_flags);
+                } catch (...) {
+                    *m_error = boost::current_exception();
+                }
+            }
+
+            const char* m_image;
+            size_t m_size;
+            char* m_replica;
+            size_t m_replica_size;
+            size_t m_node;
+            uint64_t m_flags;
+            T* m_target;
+            boost::exception_ptr* m_error;
+        };
+    }
+
+    template <typename T>
+    class numa_replicas : boost::noncopyable {
+    public:
+        // Replicates the frozen image [image, image + size) on each
+        // node, and maps a T from each replica with the given map
+        // flags
+        numa_replicas(const char* image, size_t size, uint64_t flags = 0)
+        {
+            init(image, size, flags);
+        }
+
+        numa_replicas(boost::iostreams::mapped_file_source const& m, uint64_t flags = 0)
+        {
+            init(m.data(), m.size(), flags);
+        }
+
+        ~numa_replicas() {
+            release();
+        }
+
+        size_t num_replicas() const {
+            return m_replicas.size();
+        }
+
+        // replica on the i-th online node
+        T const& replica(size_t i) const {
+            return *m_replicas[i];
+        }
+
+        size_t node(size_t i) const {
+            return m_nodes[i];
+        }
+
+        // replica of the node the calling thread runs on
+        T const& local() const {
+            int cpu = detail::current_cpu();
+            return (cpu >= 0 && size_t(cpu) < m_cpu_replica.size())
+                ? *m_replicas[m_cpu_replica[size_t(cpu)]]
+                : *m_replicas[0];
+        }
+
+    private:
+        void init(const char* image, size_t size, uint64_t flags) {
+            try {
+                m_nodes = detail::numa_nodes();
+                m_size = std::max(size, size_t(1));
+                for (size_t i = 0; i < m_nodes.size(); ++i) {
+                    void* p = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (p == MAP_FAILED) {
+                        throw std::bad_alloc();
+                    }
+                    m_memory.push_back(static_cast<char*>(p));
+                    detail::bind_to_node(p, m_size, m_nodes[i]);
+                    m_replicas.push_back(boost::make_shared<T>());
+                }
+
+                // fill and map the replicas concurrently, one thread per
+                // node
+                std::vector<boost::exception_ptr> errors(m_nodes.size());
+                boost::thread_group group;
+                try {
+                    for (size_t i = 0; i < m_nodes.size(); ++i) {
+                        group.create_thread(detail::replica_filler<T>(image, size, m_memory[i], m_size, m_nodes[i],
+                                                                      flags, *m_replicas[i], errors[i]));
+                    }
+                } catch (...) {
+                    // the started threads write to the replicas
+                    group.join_all();
+                    throw;
+                }
+                group.join_all();
+                for (size_t i = 0; i < errors.size(); ++i) {
+                    if (errors[i]) {
+                        boost::rethrow_exception(errors[i]);
+                    }
+                }
+
+                // the cpu to replica table of local()
+                for (size_t i = 0; i < m_nodes.size(); ++i) {
+                    std::vector<size_t> cpus = detail::numa_node_cpus(m_nodes[i]);
+                    for (size_t j = 0; j < cpus.size(); ++j) {
+                        if (cpus[j] >= m_cpu_replica.size()) {
+                            m_cpu_replica.resize(cpus[j] + 1, 0);
+                        }
+                        m_cpu_replica[cpus[j]] = i;
+                    }
+                }
+            } catch (...) {
+                // the destructor does not run if the constructor throws
+                release();
+                throw;
+            }
+        }
+
+        void release() {
+            // the replicas first, they point into the memory
+            m_replicas.clear();
+            for (size_t i = 0; i < m_memory.size(); ++i) {
+                munmap(m_memory[i], m_size);
+            }
+            m_memory.clear();
+        }
+
+        size_t m_size;
+        std::vector<size_t> m_nodes;
+        std::vector<char*> m_memory;
+        std::vector<boost::shared_ptr<T> > m_replicas;
+        std::vector<size_t> m_cpu_replica;
+    };
+
+}}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#include "mapper.hpp"
+#include "elias_fano.hpp"
+#include "vbyte.hpp"
+
+namespace succinct {
+
+    // Many small structures of type T (such as one elias_fano or
+    // gamma_vector per term) packed into a single byte arena, with an
+    // elias_fano directory of the item offsets. Each item is stored
+    // with a compact framing: integer fields and vector sizes are
+    // vbyte-encoded and the payloads follow, padded only to the
+    // alignment of their elements (relative to the arena, which is
+    // stored as 64-bit words), so a tiny item costs a few bytes besides its
+    // payload and the directory, instead of a mappable_vector per
+    // field in memory and the 64-bit words of freeze() on disk.
+    //
+    // get() maps an item into a view, a T whose vectors point into
+    // the arena; it does not allocate, and the view must not outlive
+    // the collection. The collection is frozen and mapped as a
+    // whole. Items with derived fields (see mapper::derived) are
+    // stored in full. Each non-empty payload is followed by the zero
+    // padding of mappable_vector, so views can be read a word at a
+    // time like any other vector.
+
+    namespace mapper { namespace detail {
+
+        // zero bytes after each payload, as in mappable_vector
+        template <typename T>
+        size_t item_padding(mappable_vector<T> const& vec) {
+            return vec.size() ? mappable_vector<T>::padding_elements * sizeof(T) : 0;
+        }
+
+        class pack_visitor : boost::noncopyable {
+        public:
+            pack_visitor(std::vector<uint8_t>& arena)
+                : m_arena(arena)
+            {}
+
+            template <typename T>
+            typename boost::disable_if<boost::is_pod<T>, pack_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                val.map(*this);
+                return *this;
+            }
+
+            template <typename T>
+            pack_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                return (*this)(field.ref, friendly_name);
+            }
+
+            template <typename T>
+            typename boost::enable_if<boost::is_pod<T>, pack_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                write(val, boost::is_integral<T>());
+                return *this;
+            }
+
+            template<typename T>
+            pack_visitor& operator()(mappable_vector<T>& vec, const char* /* friendly_name */) {
+                append_vbyte(m_arena, size_t(vec.size()));
+                m_arena.resize(m_arena.size() + padding(m_arena.size(), boost::alignment_of<T>::value), 0);
+                const uint8_t* data = reinterpret_cast<const uint8_t*>(vec.data());
+                m_arena.insert(m_arena.end(), data, data + vec.size() * sizeof(T));
+                m_arena.resize(m_arena.size() + item_padding(vec), 0);
+                return *this;
+            }
+
+        private:
+            template <typename T>
+            void write(T val, boost::true_type /* is_integral */) {
+                append_vbyte(m_arena, size_t(uint64_t(val)));
+            }
+
+            template <typename T>
+            void write(T const& val, boost::false_type /* is_integral */) {
+                const uint8_t* data = reinterpret_cast<const uint8_t*>(&val);
+                m_arena.insert(m_arena.end(), data, data + sizeof(T));
+            }
+
+            std::vector<uint8_t>& m_arena;
+        };
+
+        class unpack_visitor : boost::noncopyable {
+        public:
+            // reads the item at offset of the arena
+            unpack_visitor(const uint8_t* arena, size_t offset)
+                : m_arena(arena)
+                , m_cur(arena + offset)
+            {}
+
+            template <typename T>
+            typename boost::disable_if<boost::is_pod<T>, unpack_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                val.map(*this);
+                return *this;
+            }
+
+            template <typename T>
+            unpack_visitor& operator()(derived_field<T> field, const char* friendly_name) {
+                return (*this)(field.ref, friendly_name);
+            }
+
+            template <typename T>
+            typename boost::enable_if<boost::is_pod<T>, unpack_visitor&>::type
+            operator()(T& val, const char* /* friendly_name */) {
+                read(val, boost::is_integral<T>());
+                return *this;
+            }
+
+            template<typename T>
+            unpack_visitor& operator()(mappable_vector<T>& vec, const char* /* friendly_name */) {
+                vec.clear();
+                size_t size;
+                m_cur += decode_vbyte(m_cur, 0, size);
+                m_cur += padding(size_t(m_cur - m_arena), boost::alignment_of<T>::value);
+                vec.m_size = size;
+                vec.m_data = reinterpret_cast<const T*>(m_cur);
+                m_cur += size * sizeof(T) + item_padding(vec);
+                return *this;
+            }
+
+            const uint8_t* position() const {
+                return m_cur;
+            }
+
+        private:
+            template <typename T>
+            void read(T& val, boost::true_type /* is_integral */) {
+                size_t v;
+                m_cur += decode_vbyte(m_cur, 0, v);
+                val = T(uint64_t(v));
+            }
+
+            template <typename T>
+            void read(T& val, boost::false_type /* is_integral */) {
+                memcpy(&val, m_cur, sizeof(T));
+                m_cur += sizeof(T);
+            }
+
+            const uint8_t* m_arena;
+            const uint8_t* m_cur;
+        };
+    }}
+
+    template <typename T>
+    class packed_collection {
+    public:
+        typedef T value_type;
+
+        class builder : boost::noncopyable {
+        public:
+            builder()
+            {
+                m_offsets.push_back(0);
+            }
+
+            void push_back(T& item) {
+                mapper::detail::pack_visitor packer(m_arena);
+                packer(item, "<ITEM>");
+                m_offsets.push_back(m_arena.size());
+            }
+
+            size_t size() const {
+                return m_offsets.size() - 1;
+            }
+
+            friend class packed_collection;
+        private:
+            std::vector<uint8_t> m_arena;
+            std::vector<uint64_t> m_offsets;
+        };
+
+        packed_collection()
+        {}
+
+        // takes the items of b, which is left empty
+        packed_collection(builder* b)
+        {
+            elias_fano::elias_fano_builder offsets(b->m_arena.size(), b->m_offsets.size());
+            for (size_t i = 0; i < b->m_offsets.size(); ++i) {
+                offsets.push_back(b->m_offsets[i]);
+            }
+            elias_fano(&offsets, false).swap(m_offsets);
+            // stored as words to keep the payloads aligned when mapped
+            size_t n_words = util::ceil_div(b->m_arena.size(), sizeof(uint64_t));
+            std::vector<uint64_t> words;
+            mapper::reserve_padded(words, n_words);
+            words.resize(n_words);
+            if (!b->m_arena.empty()) {
+                memcpy(&words[0], &b->m_arena[0], b->m_arena.size());
+            }
+            m_arena.steal(words);
+            std::vector<uint8_t>().swap(b->m_arena);
+            std::vector<uint64_t>(1, 0).swap(b->m_offsets);
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(packed_collection)
+
+        void swap(packed_collection& other) {
+            m_offsets.swap(other.m_offsets);
+            m_arena.swap(other.m_arena);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit
+                (m_offsets, "m_offsets")
+                (m_arena, "m_arena")
+                ;
+        }
+
+        size_t size() const {
+            return m_offsets.num_ones() ? size_t(m_offsets.num_ones() - 1) : 0;
+        }
+
+        // maps the i-th item into view
+        void get(size_t i, T& view) const {
+            assert(i < size());
+            mapper::detail::unpack_visitor unpacker(arena(), size_t(m_offsets.select(i)));
+            unpacker(view, "<ITEM>");
+            assert(unpacker.position() == arena() + m_offsets.select(i + 1));
+        }
+
+        // bytes taken by the i-th item in the arena
+        size_t item_bytes(size_t i) const {
+            assert(i < size());
+            return size_t(m_offsets.select(i + 1) - m_offsets.select(i));
+        }
+
+    private:
+        const uint8_t* arena() const {
+            return reinterpret_cast<const uint8_t*>(m_arena.data());
+        }
+
+        elias_fano m_offsets;
+        mapper::mappable_vector<uint64_t> m_arena;
+    };
+}
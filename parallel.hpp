@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+#include <boost/exception_ptr.hpp>
+
+namespace succinct { namespace parallel {
+
+    namespace detail {
+        inline size_t& num_threads_storage()
+        {
+            static size_t num_threads = 1;
+            return num_threads;
+        }
+
+        // An exception thrown by f is stored in error, to be
+        // rethrown by the calling thread after the join
+        template <typename Function>
+        struct range_runner {
+            range_runner(Function& f, size_t begin, size_t end, boost::exception_ptr& error)
+                : m_f(&f)
+                , m_begin(begin)
+                , m_end(end)
+                , m_error(&error)
+            {}
+
+            void operator()() const {
+                try {
+                    for (size_t i = m_begin; i < m_end; ++i) {
+                        (*m_f)(i);
+                    }
+                } catch (...) {
+                    *m_error = boost::current_exception();
+                }
+            }
+
+            Function* m_f;
+            size_t m_begin;
+            size_t m_end;
+            boost::exception_ptr* m_error;
+        };
+    }
+
+    // Number of threads used to build the indices of rs_bit_vector,
+    // darray and the select inventories. The default is 1 (serial);
+    // the built structures do not depend on it.
+    inline size_t num_threads()
+    {
+        return detail::num_threads_storage();
+    }
+
+    inline void set_num_threads(size_t num_threads)
+    {
+        detail::num_threads_storage() = std::max(num_threads, size_t(1));
+    }
+
+    // Calls f(i) for each i in [0, n), splitting the range in
+    // contiguous parts among at most num_threads() threads; the
+    // calling thread runs the first part. If f throws, the other
+    // parts still run to completion and the exception of the first
+    // failing part is rethrown.
+    template <typename Function>
+    void for_each(size_t n, Function& f)
+    {
+        size_t threads = std::min(num_threads(), n);
+        if (threads <= 1) {
+            for (size_t i = 0; i < n; ++i) {
+                f(i);
+            }
+            return;
+        }
+
+        std::vector<boost::exception_ptr> errors(threads);
+        boost::thread_group group;
+        try {
+            for (size_t t = 1; t < threads; ++t) {
+                group.create_thread(detail::range_runner<Function>(f, n * t / threads, n * (t + 1) / threads,
+                                                                   errors[t]));
+            }
+        } catch (...) {
+            // the started threads use f
+            group.join_all();
+            throw;
+        }
+        detail::range_runner<Function>(f, 0, n / threads, errors[0])();
+        group.join_all();
+        for (size_t t = 0; t < threads; ++t) {
+            if (errors[t]) {
+                boost::rethrow_exception(errors[t]);
+            }
+        }
+    }
+
+}}
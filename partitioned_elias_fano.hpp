@@ -0,0 +1,549 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/range.hpp>
+
+#include "bit_vector.hpp"
+#include "elias_fano.hpp"
+
+namespace succinct {
+
+    // Partitioned Elias-Fano representation of a strictly increasing
+    // sequence of integers in [0, size()), seen as the positions of
+    // the ones of a bit vector like in elias_fano. The sequence is
+    // split in chunks of at most max_chunk_size elements, with the
+    // boundaries chosen to approximately minimize the total space
+    // (the dynamic programming of Ottaviano and Venturini, "Partitioned
+    // Elias-Fano Indexes"). The values of a chunk are encoded relative
+    // to the last value of the previous chunk, either as
+    // - nothing, if the chunk is a run of consecutive integers;
+    // - a bitmap of its range, if smaller than Elias-Fano;
+    // - Elias-Fano, with its own number of low bits.
+    // The encoding is determined by the chunk size and range, so it
+    // is not stored. The last value, the end index and the bit offset
+    // of each chunk are stored in three elias_fano sequences.
+    class partitioned_elias_fano {
+    public:
+        partitioned_elias_fano()
+            : m_size(0)
+            , m_num_ones(0)
+        {}
+
+        // values must be strictly increasing and smaller than universe
+        template <typename Range>
+        partitioned_elias_fano(Range const& values, uint64_t universe)
+        {
+            std::vector<uint64_t> v(boost::begin(values), boost::end(values));
+            build(v, universe);
+        }
+
+        partitioned_elias_fano(bit_vector_builder* bvb)
+        {
+            bit_vector_builder::bits_type& bits = bvb->move_bits();
+            uint64_t n = bvb->size();
+            uint64_t m = broadword::popcount_sum(bits.data(), bits.size());
+
+            bit_vector bv(bvb);
+            std::vector<uint64_t> v(m);
+            uint64_t i = 0;
+            for (uint64_t pos = 0; pos < m; ++pos) {
+                i = bv.successor1(i);
+                v[pos] = i++;
+            }
+            build(v, n);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            visit
+                (m_size, "m_size")
+                (m_num_ones, "m_num_ones")
+                (m_upper_bounds, "m_upper_bounds")
+                (m_endpoints, "m_endpoints")
+                (m_offsets, "m_offsets")
+                (m_data, "m_data")
+                ;
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(partitioned_elias_fano)
+
+        void swap(partitioned_elias_fano& other) {
+            std::swap(other.m_size, m_size);
+            std::swap(other.m_num_ones, m_num_ones);
+            other.m_upper_bounds.swap(m_upper_bounds);
+            other.m_endpoints.swap(m_endpoints);
+            other.m_offsets.swap(m_offsets);
+            other.m_data.swap(m_data);
+        }
+
+        inline uint64_t size() const {
+            return m_size;
+        }
+
+        inline uint64_t num_ones() const {
+            return m_num_ones;
+        }
+
+        inline uint64_t num_chunks() const {
+            return m_endpoints.num_ones();
+        }
+
+        inline bool operator[](uint64_t pos) const {
+            assert(pos < size());
+            uint64_t r = rank(pos);
+            return r < num_ones() && select(r) == pos;
+        }
+
+        inline uint64_t select(uint64_t n) const {
+            assert(n < num_ones());
+            chunk c = get_chunk(m_endpoints.rank(n + 1));
+            return c.select(m_data, n - c.begin);
+        }
+
+        inline uint64_t rank(uint64_t pos) const {
+            assert(pos <= size());
+            if (pos == size()) {
+                return num_ones();
+            }
+
+            uint64_t chunk_idx = m_upper_bounds.rank(pos);
+            if (chunk_idx == num_chunks()) {
+                return num_ones();
+            }
+            chunk c = get_chunk(chunk_idx);
+            return c.begin + c.rank(m_data, pos);
+        }
+
+        inline uint64_t predecessor1(uint64_t pos) const {
+            return select(rank(pos + 1) - 1);
+        }
+
+        inline uint64_t successor1(uint64_t pos) const {
+            return select(rank(pos));
+        }
+
+        static const uint64_t max_chunk_size = 1024;
+        // estimated space of the top-level entries of a chunk
+        static const uint64_t chunk_fixed_cost = 64;
+
+        enum chunk_type {
+            chunk_full,
+            chunk_bitmap,
+            chunk_ef
+        };
+
+        static inline uint64_t ef_low_bits(uint64_t n, uint64_t universe) {
+            return (universe / n) ? broadword::msb(universe / n) : 0;
+        }
+
+        static inline uint64_t ef_bits(uint64_t n, uint64_t universe) {
+            uint64_t l = ef_low_bits(n, universe);
+            return n * l + n + (universe >> l) + 1;
+        }
+
+        static inline chunk_type type_for(uint64_t n, uint64_t universe) {
+            assert(n && n <= universe);
+            if (n == universe) {
+                return chunk_full;
+            } else if (universe <= ef_bits(n, universe)) {
+                return chunk_bitmap;
+            } else {
+                return chunk_ef;
+            }
+        }
+
+        // bits used to encode a chunk of n values in a range of size universe
+        static inline uint64_t chunk_bits(uint64_t n, uint64_t universe) {
+            switch (type_for(n, universe)) {
+            case chunk_full: return 0;
+            case chunk_bitmap: return universe;
+            default: return ef_bits(n, universe);
+            }
+        }
+
+    protected:
+
+        struct chunk {
+            uint64_t begin;    // index of the first element
+            uint64_t end;
+            uint64_t base;     // the values are in [base, base + universe)
+            uint64_t universe;
+            uint64_t offset;   // position of the encoding in m_data
+            chunk_type type;
+            uint64_t l;        // low bits, for chunk_ef
+
+            inline uint64_t size() const {
+                return end - begin;
+            }
+
+            inline uint64_t high_offset() const {
+                return offset + size() * l;
+            }
+
+            inline uint64_t select(bit_vector const& data, uint64_t k) const {
+                assert(k < size());
+                if (type == chunk_full) {
+                    return base + k;
+                }
+
+                uint64_t start = (type == chunk_bitmap) ? offset : high_offset();
+                bit_vector::unary_enumerator e(data, start);
+                e.skip(k);
+                if (type == chunk_bitmap) {
+                    return base + e.position() - offset;
+                }
+                return base
+                    + (((e.position() - start - k) << l)
+                       | data.get_bits(offset + k * l, l));
+            }
+
+            // number of values smaller than x, for x >= base
+            inline uint64_t rank(bit_vector const& data, uint64_t x) const {
+                assert(x >= base);
+                x -= base;
+                if (x >= universe) {
+                    return size();
+                }
+
+                if (type == chunk_full) {
+                    return x;
+                } else if (type == chunk_bitmap) {
+                    uint64_t r = 0;
+                    uint64_t pos = offset;
+                    for (; x >= 64; x -= 64, pos += 64) {
+                        r += broadword::popcount(data.get_bits(pos, 64));
+                    }
+                    return r + broadword::popcount(data.get_bits(pos, x));
+                }
+
+                uint64_t high_x = x >> l;
+                uint64_t low_x = x & ((uint64_t(1) << l) - 1);
+                // position after the high_x-th zero of the high bits
+                uint64_t pos = high_offset();
+                if (high_x) {
+                    pos = next_zero(data, pos, high_x - 1) + 1;
+                }
+                uint64_t r = pos - high_offset() - high_x;
+                while (r < size() && data[pos]
+                       && data.get_bits(offset + r * l, l) < low_x) {
+                    ++r;
+                    ++pos;
+                }
+                return r;
+            }
+
+            // position of the k-th zero starting from pos
+            static inline uint64_t next_zero(bit_vector const& data, uint64_t pos, uint64_t k) {
+                uint64_t const* words = data.data().data();
+                uint64_t word_idx = pos / 64;
+                uint64_t buf = ~words[word_idx] & (uint64_t(-1) << (pos % 64));
+                uint64_t w;
+                while ((w = broadword::popcount(buf)) <= k) {
+                    k -= w;
+                    buf = ~words[++word_idx];
+                }
+                return word_idx * 64 + broadword::select_in_word(buf, k);
+            }
+        };
+
+    public:
+
+        struct select_enumerator {
+
+            select_enumerator(partitioned_elias_fano const& pef, uint64_t i)
+                : m_pef(&pef)
+                , m_i(i)
+                , m_chunk_idx(0)
+            {
+                m_chunk.begin = m_chunk.end = 0;
+                if (i < m_pef->num_ones()) {
+                    load_chunk(m_pef->m_endpoints.rank(i + 1));
+                    seek(i);
+                }
+            }
+
+            // index of the element returned by the next call to next()
+            uint64_t index() const {
+                return m_i;
+            }
+
+            uint64_t next() {
+                assert(m_i < m_pef->num_ones());
+                if (m_i == m_chunk.end) {
+                    load_chunk(m_chunk_idx + 1);
+                    seek(m_i);
+                }
+
+                uint64_t k = m_i - m_chunk.begin;
+                uint64_t val;
+                switch (m_chunk.type) {
+                case chunk_full:
+                    val = m_chunk.base + k;
+                    break;
+                case chunk_bitmap:
+                    val = m_chunk.base + m_enum.next() - m_chunk.offset;
+                    break;
+                default:
+                    val = m_chunk.base
+                        + (((m_enum.next() - m_chunk.high_offset() - k) << m_chunk.l)
+                           | m_pef->m_data.get_bits(m_chunk.offset + k * m_chunk.l, m_chunk.l));
+                }
+                ++m_i;
+                return val;
+            }
+
+            // moves to the i-th element, which is returned by the
+            // next call to next()
+            void move(uint64_t i) {
+                assert(i <= m_pef->num_ones());
+                if (i == m_i) return;
+                if (i == m_pef->num_ones()) {
+                    m_i = i;
+                } else if (i >= m_chunk.begin && i < m_chunk.end) {
+                    move_in_chunk(i);
+                } else {
+                    load_chunk(m_pef->m_endpoints.rank(i + 1));
+                    seek(i);
+                }
+            }
+
+            // skips the next k elements
+            void skip(uint64_t k) {
+                move(m_i + k);
+            }
+
+            // returns the first element greater than or equal to x,
+            // starting from the current one, and moves past it as
+            // next() does; returns size() if there is none. The
+            // current chunk is searched directly if it contains the
+            // result, otherwise the chunk is located with the upper
+            // bounds.
+            uint64_t next_geq(uint64_t x) {
+                uint64_t n = m_pef->num_ones();
+                if (m_i == n || x >= m_pef->size()) {
+                    m_i = n;
+                    return m_pef->size();
+                }
+
+                if (m_i == m_chunk.end) {
+                    load_chunk(m_chunk_idx + 1);
+                    seek(m_i);
+                }
+
+                if (x >= m_chunk.base + m_chunk.universe) {
+                    uint64_t chunk_idx = m_pef->m_upper_bounds.rank(x);
+                    if (chunk_idx == m_pef->num_chunks()) {
+                        m_i = n;
+                        return m_pef->size();
+                    }
+                    load_chunk(chunk_idx);
+                    seek(m_chunk.begin + m_chunk.rank(m_pef->m_data, x));
+                } else if (x > m_chunk.base) {
+                    uint64_t i = m_chunk.begin + m_chunk.rank(m_pef->m_data, x);
+                    if (i > m_i) {
+                        move_in_chunk(i);
+                    }
+                }
+
+                return next();
+            }
+
+        private:
+
+            void load_chunk(uint64_t chunk_idx) {
+                m_chunk_idx = chunk_idx;
+                m_chunk = m_pef->get_chunk(chunk_idx);
+            }
+
+            // positions the enumerator on the i-th element, which
+            // must be in the current chunk
+            void seek(uint64_t i) {
+                assert(i >= m_chunk.begin && i < m_chunk.end);
+                m_i = i;
+                if (m_chunk.type == chunk_full) return;
+                uint64_t start = (m_chunk.type == chunk_bitmap)
+                    ? m_chunk.offset : m_chunk.high_offset();
+                m_enum = bit_vector::unary_enumerator(m_pef->m_data, start);
+                if (i > m_chunk.begin) {
+                    m_enum.skip(i - m_chunk.begin);
+                }
+            }
+
+            void move_in_chunk(uint64_t i) {
+                if (i > m_i && m_i < m_chunk.end && m_chunk.type != chunk_full) {
+                    m_enum.skip(i - m_i);
+                    m_i = i;
+                } else {
+                    seek(i);
+                }
+            }
+
+            partitioned_elias_fano const* m_pef;
+            uint64_t m_i;
+            uint64_t m_chunk_idx;
+            chunk m_chunk;
+            bit_vector::unary_enumerator m_enum;
+        };
+
+    protected:
+
+        chunk get_chunk(uint64_t chunk_idx) const {
+            chunk c;
+            c.begin = chunk_idx ? m_endpoints.select(chunk_idx - 1) : 0;
+            c.end = m_endpoints.select(chunk_idx);
+            c.base = chunk_idx ? m_upper_bounds.select(chunk_idx - 1) + 1 : 0;
+            c.universe = m_upper_bounds.select(chunk_idx) + 1 - c.base;
+            c.offset = m_offsets.select(chunk_idx);
+            c.type = type_for(c.size(), c.universe);
+            c.l = (c.type == chunk_ef) ? ef_low_bits(c.size(), c.universe) : 0;
+            return c;
+        }
+
+        // cost in bits of the chunk of values [begin, end)
+        static inline uint64_t chunk_cost(std::vector<uint64_t> const& values,
+                                          uint64_t begin, uint64_t end) {
+            uint64_t base = begin ? values[begin - 1] + 1 : 0;
+            return chunk_fixed_cost + chunk_bits(end - begin, values[end - 1] + 1 - base);
+        }
+
+        // Approximately optimal partition of values, as the list of
+        // chunk end indices. This is a shortest path on the DAG of
+        // the chunks [i, j), where for each i only the edges of
+        // maximal j for the costs bounds chunk_fixed_cost * (1 +
+        // eps)^h are relaxed; the windows of the bounds only move
+        // forward, so the time is linear in the number of values and
+        // logarithmic in the bounds.
+        static void partition(std::vector<uint64_t> const& values,
+                              std::vector<uint64_t>& endpoints)
+        {
+            const double eps = 0.3;
+            uint64_t n = values.size();
+            endpoints.clear();
+            if (!n) return;
+
+            // a chunk costs at most 66 bits per value
+            uint64_t max_cost = chunk_fixed_cost + 66 * max_chunk_size + 1;
+            std::vector<uint64_t> bounds;
+            for (double b = double(chunk_fixed_cost); ; b *= 1 + eps) {
+                bounds.push_back(uint64_t(b));
+                if (uint64_t(b) >= max_cost) break;
+            }
+
+            std::vector<uint64_t> min_cost(n + 1, uint64_t(-1));
+            std::vector<uint64_t> prev(n + 1);
+            std::vector<uint64_t> window_ends(bounds.size(), 0);
+            min_cost[0] = 0;
+
+            for (uint64_t i = 0; i < n; ++i) {
+                // unreachable, its cost would wrap around
+                if (min_cost[i] == uint64_t(-1)) continue;
+                // the chunk of a single value, so that the next node
+                // is always reachable
+                uint64_t single_cost = min_cost[i] + chunk_cost(values, i, i + 1);
+                if (single_cost < min_cost[i + 1]) {
+                    min_cost[i + 1] = single_cost;
+                    prev[i + 1] = i;
+                }
+
+                uint64_t max_end = std::min(n, i + max_chunk_size);
+                for (size_t h = 0; h < bounds.size(); ++h) {
+                    uint64_t& j = window_ends[h];
+                    j = std::max(j, i + 1);
+                    while (j < max_end && chunk_cost(values, i, j + 1) <= bounds[h]) {
+                        ++j;
+                    }
+                    // the last chunk within the bound, and the first
+                    // one over it
+                    for (uint64_t end = j; end <= std::min(j + 1, max_end); ++end) {
+                        uint64_t cost = min_cost[i] + chunk_cost(values, i, end);
+                        if (cost < min_cost[end]) {
+                            min_cost[end] = cost;
+                            prev[end] = i;
+                        }
+                    }
+                }
+            }
+
+            for (uint64_t j = n; j; j = prev[j]) {
+                endpoints.push_back(j);
+            }
+            std::reverse(endpoints.begin(), endpoints.end());
+        }
+
+        void build(std::vector<uint64_t> const& values, uint64_t universe)
+        {
+            m_size = universe;
+            m_num_ones = values.size();
+
+            std::vector<uint64_t> endpoints;
+            partition(values, endpoints);
+
+            uint64_t chunks = endpoints.size();
+            elias_fano_builder upper_bounds(universe, chunks);
+            elias_fano_builder ends(m_num_ones + 1, chunks);
+            std::vector<uint64_t> offsets;
+            offsets.reserve(chunks);
+            bit_vector_builder data;
+
+            uint64_t begin = 0;
+            uint64_t base = 0;
+            for (uint64_t c = 0; c < chunks; ++c) {
+                uint64_t end = endpoints[c];
+                uint64_t n = end - begin;
+                uint64_t last = values[end - 1];
+                assert(last < universe);
+                uint64_t chunk_universe = last + 1 - base;
+                offsets.push_back(data.size());
+
+                switch (type_for(n, chunk_universe)) {
+                case chunk_full:
+                    break;
+                case chunk_bitmap: {
+                    uint64_t offset = data.size();
+                    data.zero_extend(chunk_universe);
+                    for (uint64_t i = begin; i < end; ++i) {
+                        data.set(offset + values[i] - base, 1);
+                    }
+                    break;
+                }
+                default: {
+                    uint64_t l = ef_low_bits(n, chunk_universe);
+                    uint64_t low_mask = (uint64_t(1) << l) - 1;
+                    for (uint64_t i = begin; i < end; ++i) {
+                        data.append_bits((values[i] - base) & low_mask, l);
+                    }
+                    uint64_t high_offset = data.size();
+                    data.zero_extend(n + (chunk_universe >> l) + 1);
+                    for (uint64_t i = begin; i < end; ++i) {
+                        data.set(high_offset + ((values[i] - base) >> l) + (i - begin), 1);
+                    }
+                }
+                }
+
+                upper_bounds.push_back(last);
+                ends.push_back(end);
+                begin = end;
+                base = last + 1;
+            }
+
+            elias_fano_builder offsets_builder(data.size() + 1, chunks);
+            for (uint64_t c = 0; c < chunks; ++c) {
+                offsets_builder.push_back(offsets[c]);
+            }
+
+            elias_fano(&upper_bounds).swap(m_upper_bounds);
+            elias_fano(&ends).swap(m_endpoints);
+            elias_fano(&offsets_builder, false).swap(m_offsets);
+            bit_vector(&data).swap(m_data);
+        }
+
+        uint64_t m_size;
+        uint64_t m_num_ones;
+        elias_fano m_upper_bounds; // last value of each chunk
+        elias_fano m_endpoints;    // end index of each chunk
+        elias_fano m_offsets;      // position in m_data of each chunk
+        bit_vector m_data;
+    };
+}
@@ -85,22 +85,35 @@ void bp_benchmark(size_t runs)
     srand(42); // make everything deterministic
     static const size_t sample_size = 10000000;
     
+    // find_close is timed with each of the supported kernel sets
+    std::vector<succinct::bp_kernels> const& kernels = succinct::supported_bp_kernels();
+
     std::cout << BpVectorTraits::log_header() << std::endl;
-    std::cout << "log_height" "\t" "find_close_us" "\t" "bits_per_bp" << std::endl;
+    std::cout << "log_height";
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        std::cout << "\t" "find_close_us_" << kernels[k].name;
+    }
+    std::cout << "\t" "bits_per_bp" << std::endl;
     
     for (size_t ln = 10; ln <= 28; ln += 2) {
 	size_t n = 1 << ln;
-	double elapsed = 0;
+	std::vector<double> elapsed(kernels.size());
 	double bits_per_bp = 0;
 	for (size_t run = 0; run < runs; ++run) {
 	    typename BpVectorTraits::bp_vector_type bp;
 	    build_random_binary_tree<BpVectorTraits>(bp, n);
-	    elapsed += time_visit(bp, sample_size);
+	    for (size_t k = 0; k < kernels.size(); ++k) {
+		succinct::scoped_bp_kernels scoped(kernels[k]);
+		srand(unsigned(ln + run)); // same visit for all the kernels
+		elapsed[k] += time_visit(bp, sample_size);
+	    }
 	    bits_per_bp += BpVectorTraits::bits_per_bp(bp);
 	}
-	std::cout << ln 
-                  << "\t" << elapsed / double(runs)
-                  << "\t" << bits_per_bp / double(runs)
+	std::cout << ln;
+	for (size_t k = 0; k < kernels.size(); ++k) {
+	    std::cout << "\t" << elapsed[k] / double(runs);
+	}
+	std::cout << "\t" << bits_per_bp / double(runs)
                   << std::endl;
     }
 }
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include <boost/lexical_cast.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -94,6 +95,24 @@ void ef_enumeration_benchmark(uint64_t m, uint8_t bits)
 	    foo ^= it.next();
 	}
     }
+
+    std::cerr << "select_enumerator::next" << std::endl
+	      << "Elapsed: " << elapsed / 1000 << " msec\n"
+	      << double(m) / elapsed << " Mcodes/s" << std::endl;
+
+    std::cerr << "decode (" << succinct::broadword::best_bulk_kernels().name
+	      << " kernels)" << std::endl;
+    const size_t block_size = 1024;
+    std::vector<uint64_t> buf(block_size);
+    SUCCINCT_TIMEIT(elapsed) {
+	for (size_t i = 0; i < m; i += block_size) {
+	    size_t count = std::min(block_size, size_t(m - i));
+	    ef.decode(i, count, &buf[0]);
+	    for (size_t k = 0; k < count; ++k) {
+		foo ^= buf[k];
+	    }
+	}
+    }
     volatile uint64_t vfoo = foo;
     (void)vfoo; // silence warning
 
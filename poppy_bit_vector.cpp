@@ -0,0 +1,79 @@
+#include "poppy_bit_vector.hpp"
+
+namespace succinct {
+
+    void poppy_bit_vector::build_indices(bool with_select_hints, bool with_select0_hints)
+    {
+        // basic blocks must be cache lines, so that the words scanned
+        // by rank and select do not straddle two of them
+        if (uintptr_t(m_bits.data()) % 64) {
+            std::vector<uint64_t, util::aligned_allocator<uint64_t, 64> >
+                aligned_bits(m_bits.begin(), m_bits.end());
+            m_bits.steal(aligned_bits);
+        }
+
+        {
+            std::vector<uint64_t> l0_ranks;
+            std::vector<uint64_t> l12_ranks;
+            uint64_t n_l1_blocks = util::ceil_div(m_bits.size(), l1_words);
+            mapper::reserve_padded(l12_ranks, n_l1_blocks + 1);
+
+            uint64_t cur_rank = 0;
+            for (uint64_t l1_block = 0; l1_block < n_l1_blocks; ++l1_block) {
+                if (l1_block % l0_l1_blocks == 0) {
+                    l0_ranks.push_back(cur_rank);
+                }
+                uint64_t entry = cur_rank - l0_ranks.back();
+                assert(entry <= l1_rank_mask);
+                for (uint64_t basic_block = 0; basic_block < l1_basic_blocks; ++basic_block) {
+                    uint64_t begin = l1_block * l1_words + basic_block * basic_block_words;
+                    uint64_t end = std::min(begin + basic_block_words, uint64_t(m_bits.size()));
+                    uint64_t count = begin < end
+                        ? broadword::popcount_sum(m_bits.data() + begin, end - begin)
+                        : 0;
+                    if (basic_block < l1_basic_blocks - 1) {
+                        entry |= count << (32 + 10 * basic_block);
+                    }
+                    cur_rank += count;
+                }
+                l12_ranks.push_back(entry);
+            }
+
+            // sentinel
+            if (n_l1_blocks % l0_l1_blocks == 0) {
+                l0_ranks.push_back(cur_rank);
+            }
+            l12_ranks.push_back(cur_rank - l0_ranks.back());
+
+            m_l0_ranks.steal(l0_ranks);
+            m_l12_ranks.steal(l12_ranks);
+        }
+
+        if (with_select_hints && num_l1_blocks()) {
+            std::vector<uint64_t> select_samples;
+            uint64_t cur_threshold = 0;
+            for (uint64_t i = 0; i < num_l1_blocks(); ++i) {
+                while (cur_threshold < l1_rank(i + 1) && cur_threshold < num_ones()) {
+                    select_samples.push_back(i);
+                    cur_threshold += select_ones_per_sample;
+                }
+            }
+            select_samples.push_back(num_l1_blocks() - 1);
+            m_select_samples.steal(select_samples);
+        }
+
+        if (with_select0_hints && num_l1_blocks()) {
+            std::vector<uint64_t> select0_samples;
+            uint64_t cur_threshold = 0;
+            for (uint64_t i = 0; i < num_l1_blocks(); ++i) {
+                while (cur_threshold < l1_rank0(i + 1) && cur_threshold < num_zeros()) {
+                    select0_samples.push_back(i);
+                    cur_threshold += select_zeros_per_sample;
+                }
+            }
+            select0_samples.push_back(num_l1_blocks() - 1);
+            m_select0_samples.steal(select0_samples);
+        }
+    }
+
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "bit_vector.hpp"
+#include "broadword.hpp"
+
+namespace succinct {
+
+    // Rank/select bit vector with a Poppy-style three-level rank
+    // directory, trading some latency for space. The bits are divided
+    // in L1 blocks of 2048 bits, each made of 4 basic blocks of 512
+    // bits; for each L1 block a single word packs the rank of the
+    // block relative to its L0 block (32 bits) and the counts of its
+    // first three basic blocks (3 x 10 bits). An L0 block (2^32 bits)
+    // stores its absolute rank. The directory overhead is 1/32 of the
+    // data bits; the select samples store one L1 block every 8192
+    // ones (or zeros). The bits are copied to cache-line aligned
+    // storage when built, so that each basic block is a cache line.
+    //
+    // It exposes the same interface as rs_bit_vector, except for the
+    // select inventory and the batched queries.
+    class poppy_bit_vector : public bit_vector {
+    public:
+        poppy_bit_vector()
+            : bit_vector()
+        {}
+
+        template <class Range>
+        poppy_bit_vector(Range const& from,
+                         bool with_select_hints = false,
+                         bool with_select0_hints = false)
+            : bit_vector(from)
+        {
+            build_indices(with_select_hints, with_select0_hints);
+        }
+
+        template <typename Visitor>
+        void map(Visitor& visit) {
+            bit_vector::map(visit);
+            visit
+                (m_l0_ranks, "m_l0_ranks")
+                (m_l12_ranks, "m_l12_ranks")
+                (m_select_samples, "m_select_samples")
+                (m_select0_samples, "m_select0_samples")
+                ;
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(poppy_bit_vector)
+
+        void swap(poppy_bit_vector& other) {
+            bit_vector::swap(other);
+            m_l0_ranks.swap(other.m_l0_ranks);
+            m_l12_ranks.swap(other.m_l12_ranks);
+            m_select_samples.swap(other.m_select_samples);
+            m_select0_samples.swap(other.m_select0_samples);
+        }
+
+        inline uint64_t num_ones() const {
+            return l1_rank(num_l1_blocks());
+        }
+
+        inline uint64_t num_zeros() const {
+            return size() - num_ones();
+        }
+
+        inline uint64_t rank(uint64_t pos) const {
+            assert(pos <= size());
+            if (pos == size()) {
+                return num_ones();
+            }
+
+            uint64_t sub_block = pos / 64;
+            uint64_t r = sub_block_rank(sub_block);
+            uint64_t sub_left = pos % 64;
+            if (sub_left) {
+                r += broadword::popcount(m_bits[sub_block] << (64 - sub_left));
+            }
+            return r;
+        }
+
+        inline uint64_t rank0(uint64_t pos) const {
+            return pos - rank(pos);
+        }
+
+        inline uint64_t select(uint64_t n) const {
+            using broadword::popcount;
+            using broadword::select_in_word;
+            assert(n < num_ones());
+            uint64_t a = 0;
+            uint64_t b = num_l1_blocks();
+            if (m_select_samples.size()) {
+                uint64_t sample = n / select_ones_per_sample;
+                a = m_select_samples[sample];
+                b = m_select_samples[sample + 1] + 1;
+            }
+
+            while (b - a > 1) {
+                uint64_t mid = a + (b - a) / 2;
+                if (l1_rank(mid) <= n) {
+                    a = mid;
+                } else {
+                    b = mid;
+                }
+            }
+
+            uint64_t entry = m_l12_ranks[a];
+            uint64_t r = n - l1_rank(a);
+            uint64_t basic_block = 0;
+            for (; basic_block < l1_basic_blocks - 1; ++basic_block) {
+                uint64_t count = basic_block_count(entry, basic_block);
+                if (r < count) break;
+                r -= count;
+            }
+
+            uint64_t word_idx = a * l1_words + basic_block * basic_block_words;
+            while (true) {
+                assert(word_idx < m_bits.size());
+                uint64_t word_pop = popcount(m_bits[word_idx]);
+                if (r < word_pop) break;
+                r -= word_pop;
+                ++word_idx;
+            }
+            return word_idx * 64 + select_in_word(m_bits[word_idx], r);
+        }
+
+        inline uint64_t select0(uint64_t n) const {
+            using broadword::popcount;
+            using broadword::select_in_word;
+            assert(n < num_zeros());
+            uint64_t a = 0;
+            uint64_t b = num_l1_blocks();
+            if (m_select0_samples.size()) {
+                uint64_t sample = n / select_zeros_per_sample;
+                a = m_select0_samples[sample];
+                b = m_select0_samples[sample + 1] + 1;
+            }
+
+            while (b - a > 1) {
+                uint64_t mid = a + (b - a) / 2;
+                if (l1_rank0(mid) <= n) {
+                    a = mid;
+                } else {
+                    b = mid;
+                }
+            }
+
+            uint64_t entry = m_l12_ranks[a];
+            uint64_t r = n - l1_rank0(a);
+            uint64_t basic_block = 0;
+            for (; basic_block < l1_basic_blocks - 1; ++basic_block) {
+                uint64_t count0 = basic_block_bits - basic_block_count(entry, basic_block);
+                if (r < count0) break;
+                r -= count0;
+            }
+
+            uint64_t word_idx = a * l1_words + basic_block * basic_block_words;
+            while (true) {
+                assert(word_idx < m_bits.size());
+                uint64_t word_pop0 = popcount(~m_bits[word_idx]);
+                if (r < word_pop0) break;
+                r -= word_pop0;
+                ++word_idx;
+            }
+            return word_idx * 64 + select_in_word(~m_bits[word_idx], r);
+        }
+
+    protected:
+
+        // interface shared with rs_bit_vector, used by basic_bp_vector
+
+        inline uint64_t num_words() const {
+            return m_bits.size();
+        }
+
+        inline uint64_t word(uint64_t i) const {
+            return m_bits[i];
+        }
+
+        inline uint64_t sub_block_rank(uint64_t sub_block) const {
+            uint64_t l1_block = sub_block / l1_words;
+            uint64_t entry = m_l12_ranks[l1_block];
+            uint64_t r = l1_rank(l1_block);
+            uint64_t basic_block = sub_block % l1_words / basic_block_words;
+            // counts of the basic blocks before basic_block, branch-free
+            uint64_t counts = (entry >> 32) & ((uint64_t(1) << (10 * basic_block)) - 1);
+            r += (counts & 0x3FF) + (counts >> 10 & 0x3FF) + (counts >> 20);
+            for (uint64_t i = sub_block - sub_block % basic_block_words; i < sub_block; ++i) {
+                r += broadword::popcount(m_bits[i]);
+            }
+            return r;
+        }
+
+        inline uint64_t num_l1_blocks() const {
+            return m_l12_ranks.size() - 1;
+        }
+
+        inline uint64_t l1_rank(uint64_t l1_block) const {
+            return m_l0_ranks[l1_block / l0_l1_blocks]
+                + (m_l12_ranks[l1_block] & l1_rank_mask);
+        }
+
+        inline uint64_t l1_rank0(uint64_t l1_block) const {
+            return l1_block * l1_bits - l1_rank(l1_block);
+        }
+
+        static inline uint64_t basic_block_count(uint64_t entry, uint64_t basic_block) {
+            assert(basic_block < l1_basic_blocks - 1);
+            return entry >> (32 + 10 * basic_block) & 0x3FF;
+        }
+
+        void build_indices(bool with_select_hints, bool with_select0_hints);
+
+        static const uint64_t basic_block_words = 8;
+        static const uint64_t basic_block_bits = basic_block_words * 64;
+        static const uint64_t l1_basic_blocks = 4;
+        static const uint64_t l1_words = basic_block_words * l1_basic_blocks;
+        static const uint64_t l1_bits = l1_words * 64;
+        static const uint64_t l0_l1_blocks = (uint64_t(1) << 32) / l1_bits;
+        static const uint64_t l1_rank_mask = (uint64_t(1) << 32) - 1;
+        static const uint64_t select_ones_per_sample = 8192; // must be > l1_bits
+        static const uint64_t select_zeros_per_sample = select_ones_per_sample;
+
+        typedef mapper::mappable_vector<uint64_t> uint64_vec;
+        uint64_vec m_l0_ranks;  // absolute rank of each L0 block, plus num_ones()
+        uint64_vec m_l12_ranks; // one entry per L1 block, plus a sentinel
+        uint64_vec m_select_samples;
+        uint64_vec m_select0_samples;
+    };
+}
@@ -1,72 +1,237 @@
 #include "rs_bit_vector.hpp"
+#include "parallel.hpp"
 
 namespace succinct {
 
-    void rs_bit_vector::build_indices(bool with_select_hints, bool with_select0_hints)
-    {
-        {
-            using broadword::popcount;
-            std::vector<uint64_t> block_rank_pairs;
-            uint64_t next_rank = 0;
-            uint64_t cur_subrank = 0;
-            uint64_t subranks = 0;
-            block_rank_pairs.push_back(0);
-            for (uint64_t i = 0; i < m_bits.size(); ++i) {
-                uint64_t word_pop = popcount(m_bits[i]);
-                uint64_t shift = i % block_size;
-                if (shift) {
-                    subranks <<= 9;
-                    subranks |= cur_subrank;
-                }
-                next_rank += word_pop;
-                cur_subrank += word_pop;
-
-                if (shift == block_size - 1) {
-                    block_rank_pairs.push_back(subranks);
-                    block_rank_pairs.push_back(next_rank);
-                    subranks = 0;
-                    cur_subrank = 0;
+    namespace {
+
+        // The blocks are split in contiguous chunks, one per thread,
+        // built in two passes: first the sub-block ranks and the
+        // popcount of each block, then, after a prefix sum of the
+        // chunk popcounts, the absolute block ranks and the hints.
+
+        struct block_counts_builder {
+            uint64_t const* bits;
+            uint64_t n_words;
+            uint64_t block_size;
+            std::vector<uint64_t> const* chunk_blocks;
+            uint64_t* block_rank_pairs;
+            uint64_t* chunk_ones;
+
+            void operator()(size_t chunk) const {
+                // word popcounts are computed in chunks with the bulk kernel
+                static const size_t counts_chunk = 1024 * 8;
+                uint8_t counts[counts_chunk];
+                uint64_t begin = (*chunk_blocks)[chunk] * block_size;
+                uint64_t end = std::min((*chunk_blocks)[chunk + 1] * block_size, n_words);
+                uint64_t ones = 0;
+                uint64_t block_ones = 0;
+                uint64_t subranks = 0;
+                for (uint64_t i = begin; i < end; ++i) {
+                    uint64_t counts_pos = (i - begin) % counts_chunk;
+                    if (counts_pos == 0) {
+                        broadword::popcount_each(bits + i,
+                                                 std::min(size_t(end - i), counts_chunk),
+                                                 counts);
+                    }
+                    uint64_t shift = i % block_size;
+                    if (shift) {
+                        subranks <<= 9;
+                        subranks |= block_ones;
+                    }
+                    block_ones += counts[counts_pos];
+
+                    if (shift == block_size - 1 || i == n_words - 1) {
+                        // padding of the last block
+                        for (uint64_t j = shift + 1; j < block_size; ++j) {
+                            subranks <<= 9;
+                            subranks |= block_ones;
+                        }
+                        // the block popcount is replaced by the block
+                        // rank in the second pass
+                        uint64_t block = i / block_size;
+                        block_rank_pairs[block * 2] = block_ones;
+                        block_rank_pairs[block * 2 + 1] = subranks;
+                        ones += block_ones;
+                        subranks = 0;
+                        block_ones = 0;
+                    }
                 }
+                chunk_ones[chunk] = ones;
             }
-            uint64_t left = block_size - m_bits.size() % block_size;
-            for (uint64_t i = 0; i < left; ++i) {
-                subranks <<= 9;
-                subranks |= cur_subrank;
-            }
-            block_rank_pairs.push_back(subranks);
+        };
 
-            if (m_bits.size() % block_size) {
-                block_rank_pairs.push_back(next_rank);
-                block_rank_pairs.push_back(0);
+        struct block_ranks_builder {
+            uint64_t block_bits;
+            uint64_t ones_per_hint;
+            std::vector<uint64_t> const* chunk_blocks;
+            uint64_t const* chunk_ranks;
+            uint64_t* block_rank_pairs;
+            uint64_t* select_hints;  // may be null
+            uint64_t* select0_hints; // may be null
+
+            void operator()(size_t chunk) const {
+                uint64_t begin = (*chunk_blocks)[chunk];
+                uint64_t end = (*chunk_blocks)[chunk + 1];
+                uint64_t cur_rank = chunk_ranks[chunk];
+                // hint k - 1 is the block i with block_rank(i) <=
+                // k * ones_per_hint < block_rank(i + 1), and similarly
+                // for zeros
+                uint64_t next_hint = std::max(util::ceil_div(cur_rank, ones_per_hint), uint64_t(1));
+                uint64_t next_hint0 = std::max(util::ceil_div(begin * block_bits - cur_rank, ones_per_hint),
+                                               uint64_t(1));
+                for (uint64_t block = begin; block < end; ++block) {
+                    uint64_t block_ones = block_rank_pairs[block * 2];
+                    block_rank_pairs[block * 2] = cur_rank;
+                    cur_rank += block_ones;
+                    if (select_hints) {
+                        while (next_hint * ones_per_hint < cur_rank) {
+                            select_hints[next_hint - 1] = block;
+                            ++next_hint;
+                        }
+                    }
+                    if (select0_hints) {
+                        while (next_hint0 * ones_per_hint < (block + 1) * block_bits - cur_rank) {
+                            select0_hints[next_hint0 - 1] = block;
+                            ++next_hint0;
+                        }
+                    }
+                }
             }
+        };
+    }
+
+    void rs_bit_vector::build_indices(select_index_type select_index, select_index_type select0_index)
+    {
+        uint64_t n_blocks = util::ceil_div(m_bits.size(), block_size);
+        size_t n_chunks = std::max(std::min(parallel::num_threads(), size_t(n_blocks)), size_t(1));
+        std::vector<uint64_t> chunk_blocks(n_chunks + 1);
+        for (size_t chunk = 0; chunk <= n_chunks; ++chunk) {
+            chunk_blocks[chunk] = n_blocks * chunk / n_chunks;
+        }
+
+        // the last pair is a sentinel
+        std::vector<uint64_t> block_rank_pairs;
+        mapper::reserve_padded(block_rank_pairs, (n_blocks + 1) * 2);
+        block_rank_pairs.resize((n_blocks + 1) * 2);
+        std::vector<uint64_t> chunk_ranks(n_chunks + 1);
+
+        block_counts_builder counts_builder;
+        counts_builder.bits = m_bits.data();
+        counts_builder.n_words = m_bits.size();
+        counts_builder.block_size = block_size;
+        counts_builder.chunk_blocks = &chunk_blocks;
+        counts_builder.block_rank_pairs = block_rank_pairs.data();
+        counts_builder.chunk_ones = chunk_ranks.data() + 1;
+        parallel::for_each(n_chunks, counts_builder);
+
+        for (size_t chunk = 0; chunk < n_chunks; ++chunk) {
+            chunk_ranks[chunk + 1] += chunk_ranks[chunk];
+        }
+        uint64_t ones = chunk_ranks[n_chunks];
+        uint64_t zeros = n_blocks * block_size * 64 - ones; // including padding
+        block_rank_pairs[n_blocks * 2] = ones;
+
+        std::vector<uint64_t> select_hints;
+        std::vector<uint64_t> select0_hints;
+        if (select_index == select_index_hints) {
+            mapper::reserve_padded(select_hints, (ones ? (ones - 1) / select_ones_per_hint : 0) + 1);
+            select_hints.resize((ones ? (ones - 1) / select_ones_per_hint : 0) + 1);
+            select_hints.back() = n_blocks;
+        }
+        if (select0_index == select_index_hints) {
+            mapper::reserve_padded(select0_hints, (zeros ? (zeros - 1) / select_zeros_per_hint : 0) + 1);
+            select0_hints.resize((zeros ? (zeros - 1) / select_zeros_per_hint : 0) + 1);
+            select0_hints.back() = n_blocks;
+        }
+
+        block_ranks_builder ranks_builder;
+        ranks_builder.block_bits = block_size * 64;
+        ranks_builder.ones_per_hint = select_ones_per_hint;
+        ranks_builder.chunk_blocks = &chunk_blocks;
+        ranks_builder.chunk_ranks = chunk_ranks.data();
+        ranks_builder.block_rank_pairs = block_rank_pairs.data();
+        ranks_builder.select_hints = select_hints.size() ? select_hints.data() : 0;
+        ranks_builder.select0_hints = select0_hints.size() ? select0_hints.data() : 0;
+        parallel::for_each(n_chunks, ranks_builder);
+
+        m_block_rank_pairs.steal(block_rank_pairs);
+        m_select_hints.steal(select_hints);
+        m_select0_hints.steal(select0_hints);
+
+        if (select_index == select_index_inventory) {
+            detail::select_inventory(*this, false, block_size * 64).swap(m_select_inventory);
+        }
+
+        if (select0_index == select_index_inventory) {
+            detail::select_inventory(*this, true, block_size * 64).swap(m_select0_inventory);
+        }
+    }
 
-            m_block_rank_pairs.steal(block_rank_pairs);
+    void rs_bit_vector::rank_batch(const uint64_t* pos, size_t n, uint64_t* out) const
+    {
+        const size_t d = batch_prefetch_distance;
+        for (size_t i = 0; i < n; ++i) {
+            // stage 1: fetch the rank pair of query i + 2d
+            if (i + 2 * d < n) {
+                assert(pos[i + 2 * d] <= size());
+                m_block_rank_pairs.prefetch(pos[i + 2 * d] / (block_size * 64) * 2);
+            }
+            // stage 2: fetch the data word of query i + d
+            if (i + d < n) {
+                m_bits.prefetch(pos[i + d] / 64);
+            }
+            // stage 3: complete query i
+            out[i] = rank(pos[i]);
         }
+    }
 
-        if (with_select_hints) {
-            std::vector<uint64_t> select_hints;
-            uint64_t cur_ones_threshold = select_ones_per_hint;
-            for (uint64_t i = 0; i < num_blocks(); ++i) {
-                if (block_rank(i + 1) > cur_ones_threshold) {
-                    select_hints.push_back(i);
-                    cur_ones_threshold += select_ones_per_hint;
+    void rs_bit_vector::select_batch(const uint64_t* ns, size_t n, uint64_t* out) const
+    {
+        const size_t d = batch_prefetch_distance;
+        uint64_t a, b;
+        for (size_t i = 0; i < n; ++i) {
+            // stage 1: fetch the inventory entry or hint of query i + 2d
+            if (i + 2 * d < n) {
+                assert(ns[i + 2 * d] < num_ones());
+                if (!m_select_inventory.empty()) {
+                    m_select_inventory.prefetch(ns[i + 2 * d]);
+                } else if (m_select_hints.size()) {
+                    m_select_hints.prefetch(ns[i + 2 * d] / select_ones_per_hint);
                 }
             }
-            select_hints.push_back(num_blocks());
-            m_select_hints.steal(select_hints);
+            // stage 2: fetch the first probe of the block search of query i + d
+            if (i + d < n && select_block_range(ns[i + d], a, b)) {
+                m_block_rank_pairs.prefetch((a + (b - a) / 2) * 2);
+            }
+            // stage 3: complete query i
+            assert(ns[i] < num_ones());
+            out[i] = select_block_range(ns[i], a, b)
+                ? select_in_block_range(ns[i], a, b)
+                : a;
         }
+    }
 
-        if (with_select0_hints) {
-            std::vector<uint64_t> select0_hints;
-            uint64_t cur_zeros_threshold = select_zeros_per_hint;
-            for (uint64_t i = 0; i < num_blocks(); ++i) {
-                if (block_rank0(i + 1) > cur_zeros_threshold) {
-                    select0_hints.push_back(i);
-                    cur_zeros_threshold += select_zeros_per_hint;
+    void rs_bit_vector::select0_batch(const uint64_t* ns, size_t n, uint64_t* out) const
+    {
+        const size_t d = batch_prefetch_distance;
+        uint64_t a, b;
+        for (size_t i = 0; i < n; ++i) {
+            if (i + 2 * d < n) {
+                assert(ns[i + 2 * d] < num_zeros());
+                if (!m_select0_inventory.empty()) {
+                    m_select0_inventory.prefetch(ns[i + 2 * d]);
+                } else if (m_select0_hints.size()) {
+                    m_select0_hints.prefetch(ns[i + 2 * d] / select_zeros_per_hint);
                 }
             }
-            select0_hints.push_back(num_blocks());
-            m_select0_hints.steal(select0_hints);
+            if (i + d < n && select0_block_range(ns[i + d], a, b)) {
+                m_block_rank_pairs.prefetch((a + (b - a) / 2) * 2);
+            }
+            assert(ns[i] < num_zeros());
+            out[i] = select0_block_range(ns[i], a, b)
+                ? select0_in_block_range(ns[i], a, b)
+                : a;
         }
     }
 
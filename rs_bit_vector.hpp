@@ -5,6 +5,7 @@
 
 #include "bit_vector.hpp"
 #include "broadword.hpp"
+#include "select_inventory.hpp"
 
 namespace succinct {
 
@@ -20,24 +21,62 @@ namespace succinct {
                       bool with_select0_hints = false)
             : bit_vector(from)
         {
-            build_indices(with_select_hints, with_select0_hints);
+            build_indices(with_select_hints ? select_index_hints : select_index_none,
+                          with_select0_hints ? select_index_hints : select_index_none);
+        }
+
+        template <class Range>
+        rs_bit_vector(Range const& from,
+                      select_index_type select_index,
+                      select_index_type select0_index = select_index_none)
+            : bit_vector(from)
+        {
+            build_indices(select_index, select0_index);
+        }
+
+        // takes the bits of from, which is left empty
+        rs_bit_vector(bit_vector* from,
+                      select_index_type select_index = select_index_none,
+                      select_index_type select0_index = select_index_none)
+        {
+            bit_vector::swap(*from);
+            build_indices(select_index, select0_index);
         }
 
         template <typename Visitor>
         void map(Visitor& visit) {
             bit_vector::map(visit);
             visit
-                (m_block_rank_pairs, "m_block_rank_pairs")
-                (m_select_hints, "m_select_hints")
-                (m_select0_hints, "m_select0_hints")
+                (mapper::derived(m_block_rank_pairs), "m_block_rank_pairs")
+                (mapper::derived(m_select_hints), "m_select_hints")
+                (mapper::derived(m_select0_hints), "m_select0_hints")
+                (mapper::derived(m_select_inventory), "m_select_inventory")
+                (mapper::derived(m_select0_inventory), "m_select0_inventory")
                 ;
         }
 
+        // after mapping a file frozen with omit_derived; the kind of
+        // select indices is recovered from the sizes of the omitted
+        // vectors
+        void rebuild_derived() {
+            if (!m_block_rank_pairs.omitted()) return;
+            build_indices(m_select_hints.size() ? select_index_hints
+                          : m_select_inventory.empty() ? select_index_none
+                          : select_index_inventory,
+                          m_select0_hints.size() ? select_index_hints
+                          : m_select0_inventory.empty() ? select_index_none
+                          : select_index_inventory);
+        }
+
+        SUCCINCT_MOVE_BY_SWAP(rs_bit_vector)
+
         void swap(rs_bit_vector& other) {
             bit_vector::swap(other);
             m_block_rank_pairs.swap(other.m_block_rank_pairs);
             m_select_hints.swap(other.m_select_hints);
             m_select0_hints.swap(other.m_select0_hints);
+            m_select_inventory.swap(other.m_select_inventory);
+            m_select0_inventory.swap(other.m_select0_inventory);
         }
 
         inline uint64_t num_ones() const {
@@ -68,11 +107,55 @@ namespace succinct {
         }
 
         inline uint64_t select(uint64_t n) const {
-            using broadword::popcount;
-            using broadword::select_in_word;
             assert(n < num_ones());
-            uint64_t a = 0;
-            uint64_t b = num_blocks();
+            uint64_t a, b;
+            if (!select_block_range(n, a, b)) {
+                return a;
+            }
+            return select_in_block_range(n, a, b);
+        }
+
+        // TODO(ot): share code between select and select0
+        inline uint64_t select0(uint64_t n) const {
+            assert(n < num_zeros());
+            uint64_t a, b;
+            if (!select0_block_range(n, a, b)) {
+                return a;
+            }
+            return select0_in_block_range(n, a, b);
+        }
+
+        // Batched versions of rank(), select() and select0(): out[i]
+        // is the result for the i-th query. The queries are
+        // software-pipelined, prefetching the directory and the data
+        // of the queries ahead while the current one is completed, so
+        // that several cache misses are in flight at once. The
+        // results are identical to the scalar versions.
+        void rank_batch(const uint64_t* pos, size_t n, uint64_t* out) const;
+        void select_batch(const uint64_t* ns, size_t n, uint64_t* out) const;
+        void select0_batch(const uint64_t* ns, size_t n, uint64_t* out) const;
+
+    protected:
+
+        // interface shared with interleaved_rs_bit_vector, used by
+        // basic_bp_vector
+
+        inline uint64_t num_words() const {
+            return m_bits.size();
+        }
+
+        inline uint64_t word(uint64_t i) const {
+            return m_bits[i];
+        }
+
+        // blocks [a, b) that contain the n-th one; returns false if
+        // the inventory stores its position explicitly, and sets a to it
+        inline bool select_block_range(uint64_t n, uint64_t& a, uint64_t& b) const {
+            if (!m_select_inventory.empty()) {
+                return m_select_inventory.block_range(n, a, b);
+            }
+            a = 0;
+            b = num_blocks();
             if (m_select_hints.size()) {
                 uint64_t chunk = n / select_ones_per_hint;
                 if (chunk != 0) {
@@ -80,7 +163,27 @@ namespace succinct {
                 }
                 b = m_select_hints[chunk] + 1;
             }
+            return true;
+        }
+
+        inline bool select0_block_range(uint64_t n, uint64_t& a, uint64_t& b) const {
+            if (!m_select0_inventory.empty()) {
+                return m_select0_inventory.block_range(n, a, b);
+            }
+            a = 0;
+            b = num_blocks();
+            if (m_select0_hints.size()) {
+                uint64_t chunk = n / select_zeros_per_hint;
+                if (chunk != 0) {
+                    a = m_select0_hints[chunk - 1];
+                }
+                b = m_select0_hints[chunk] + 1;
+            }
+            return true;
+        }
 
+        inline uint64_t select_in_block_range(uint64_t n, uint64_t a, uint64_t b) const {
+            using broadword::select_in_word;
             uint64_t block = 0;
             while (b - a > 1) {
                 uint64_t mid = a + (b - a) / 2;
@@ -109,21 +212,8 @@ namespace succinct {
             return word_offset * 64 + select_in_word(m_bits[word_offset], n - cur_rank);
         }
 
-        // TODO(ot): share code between select and select0
-        inline uint64_t select0(uint64_t n) const {
-            using broadword::popcount;
+        inline uint64_t select0_in_block_range(uint64_t n, uint64_t a, uint64_t b) const {
             using broadword::select_in_word;
-            assert(n < num_zeros());
-            uint64_t a = 0;
-            uint64_t b = num_blocks();
-            if (m_select0_hints.size()) {
-                uint64_t chunk = n / select_zeros_per_hint;
-                if (chunk != 0) {
-                    a = m_select0_hints[chunk - 1];
-                }
-                b = m_select0_hints[chunk] + 1;
-            }
-
             uint64_t block = 0;
             while (b - a > 1) {
                 uint64_t mid = a + (b - a) / 2;
@@ -151,8 +241,6 @@ namespace succinct {
             return word_offset * 64 + select_in_word(~m_bits[word_offset], n - cur_rank0);
         }
 
-    protected:
-
         inline uint64_t num_blocks() const {
             return m_block_rank_pairs.size() / 2 - 1;
         }
@@ -178,15 +266,18 @@ namespace succinct {
             return block * block_size * 64 - m_block_rank_pairs[block * 2];
         }
 
-        void build_indices(bool with_select_hints, bool with_select0_hints);
+        void build_indices(select_index_type select_index, select_index_type select0_index);
 
         static const uint64_t block_size = 8; // in 64bit words
         static const uint64_t select_ones_per_hint = 64 * block_size * 2; // must be > block_size * 64
         static const uint64_t select_zeros_per_hint = select_ones_per_hint;
+        static const size_t batch_prefetch_distance = 8; // queries between pipeline stages
 
         typedef mapper::mappable_vector<uint64_t> uint64_vec;
         uint64_vec m_block_rank_pairs;
         uint64_vec m_select_hints;
         uint64_vec m_select0_hints;
+        detail::select_inventory m_select_inventory;
+        detail::select_inventory m_select0_inventory;
     };
 }
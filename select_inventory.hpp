@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vector>
+
+#include "bit_vector.hpp"
+#include "broadword.hpp"
+#include "darray.hpp"
+
+namespace succinct {
+
+    // Select acceleration structures for the rank directories of
+    // rs_bit_vector and interleaved_rs_bit_vector: either no index
+    // (binary search on the whole directory), sparse hints (binary
+    // search between two hints) or a sampled inventory (constant
+    // number of memory accesses, more space).
+    enum select_index_type {
+        select_index_none,
+        select_index_hints,
+        select_index_inventory
+    };
+
+    namespace detail {
+
+        // darray-style select inventory built on top of a rank
+        // directory of fixed-size blocks. The positions of the ones
+        // (or zeros) are split into groups of ones_per_sample; for
+        // each group two words are stored:
+        // - if the group spans less than max_span_blocks blocks, the
+        //   block of its first position, and the offsets (8 bits
+        //   each) of the blocks of the positions ones_per_subsample *
+        //   (j + 1) for j < 7, plus the block of the last position,
+        //   so that any position is narrowed to a short range of
+        //   blocks [a, b);
+        // - otherwise (sparse group) the positions are stored
+        //   explicitly in m_overflow_positions, and the first word is
+        //   -(offset in m_overflow_positions) - 1.
+        class select_inventory {
+        public:
+            select_inventory()
+            {}
+
+            select_inventory(bit_vector const& bv, bool zeros, uint64_t block_bits)
+            {
+                groups_builder builder;
+                builder.block_bits = block_bits;
+                if (zeros) {
+                    build_position_blocks<negating_getter>(bv, ones_per_sample, builder);
+                } else {
+                    build_position_blocks<identity_getter>(bv, ones_per_sample, builder);
+                }
+
+                m_inventory.steal(builder.inventory);
+                m_overflow_positions.steal(builder.overflow_positions);
+            }
+
+            template <typename Visitor>
+            void map(Visitor& visit) {
+                visit
+                    (m_inventory, "m_inventory")
+                    (m_overflow_positions, "m_overflow_positions")
+                    ;
+            }
+
+            SUCCINCT_MOVE_BY_SWAP(select_inventory)
+
+            void swap(select_inventory& other) {
+                m_inventory.swap(other.m_inventory);
+                m_overflow_positions.swap(other.m_overflow_positions);
+            }
+
+            inline bool empty() const {
+                return m_inventory.size() == 0;
+            }
+
+            // If the position of the n-th one is stored explicitly,
+            // returns false and sets a to it; otherwise returns true
+            // and sets [a, b) to the blocks that contain it
+            inline bool block_range(uint64_t n, uint64_t& a, uint64_t& b) const {
+                uint64_t group = n / ones_per_sample;
+                assert(group * 2 < m_inventory.size());
+                int64_t base = int64_t(m_inventory[group * 2]);
+                if (base < 0) {
+                    a = m_overflow_positions[uint64_t(-base - 1) + n % ones_per_sample];
+                    return false;
+                }
+
+                uint64_t offsets = m_inventory[group * 2 + 1];
+                uint64_t sub = n % ones_per_sample / ones_per_subsample;
+                a = uint64_t(base);
+                if (sub) {
+                    a += offsets >> (8 * (sub - 1)) & 0xFF;
+                }
+                b = uint64_t(base) + (offsets >> (8 * sub) & 0xFF) + 1;
+                return true;
+            }
+
+            inline void prefetch(uint64_t n) const {
+                m_inventory.prefetch(n / ones_per_sample * 2);
+            }
+
+            static const uint64_t ones_per_sample = 512;
+            static const uint64_t ones_per_subsample = ones_per_sample / 8;
+            static const uint64_t max_span_blocks = 256;
+
+        protected:
+
+            struct groups_builder {
+                uint64_t block_bits;
+                std::vector<uint64_t> inventory;
+                std::vector<uint64_t> overflow_positions;
+
+                void reserve(uint64_t positions) {
+                    mapper::reserve_padded(inventory, 2 * util::ceil_div(positions, ones_per_sample));
+                }
+
+                void flush(std::vector<uint64_t>& group) {
+                    uint64_t first_block = group.front() / block_bits;
+                    uint64_t last_block = group.back() / block_bits;
+                    if (last_block - first_block < max_span_blocks) {
+                        uint64_t offsets = 0;
+                        for (uint64_t j = 0; j < 8; ++j) {
+                            uint64_t i = (j + 1) * ones_per_subsample;
+                            if (j == 7 || i >= group.size()) {
+                                i = group.size() - 1;
+                            }
+                            offsets |= (group[i] / block_bits - first_block) << (8 * j);
+                        }
+                        inventory.push_back(first_block);
+                        inventory.push_back(offsets);
+                    } else {
+                        inventory.push_back(uint64_t(-int64_t(overflow_positions.size()) - 1));
+                        inventory.push_back(0);
+                        overflow_positions.insert(overflow_positions.end(), group.begin(), group.end());
+                    }
+                    group.clear();
+                }
+
+                void append(groups_builder const& other) {
+                    int64_t overflow_offset = int64_t(overflow_positions.size());
+                    for (size_t i = 0; i < other.inventory.size(); i += 2) {
+                        int64_t base = int64_t(other.inventory[i]);
+                        inventory.push_back(uint64_t(base < 0 ? base - overflow_offset : base));
+                        inventory.push_back(other.inventory[i + 1]);
+                    }
+                    overflow_positions.insert(overflow_positions.end(),
+                                              other.overflow_positions.begin(), other.overflow_positions.end());
+                }
+            };
+
+            mapper::mappable_vector<uint64_t> m_inventory;
+            mapper::mappable_vector<uint64_t> m_overflow_positions;
+        };
+    }
+}
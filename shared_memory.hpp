@@ -0,0 +1,246 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "mapper.hpp"
+
+namespace succinct { namespace mapper {
+
+    // Frozen structures in shared memory, so that several processes
+    // on a host can map the same copy: a structure (or a frozen file)
+    // is written once to a memfd or POSIX shared memory segment, and
+    // the other processes map it by descriptor (inherited, or passed
+    // with send_fd) or by name. POSIX only.
+
+    namespace detail {
+        inline void throw_errno(std::string const& what) {
+            throw std::runtime_error(what + ": " + strerror(errno));
+        }
+
+        // Closes a segment that could not be filled, and removes its
+        // name if any; errno is preserved for throw_errno
+        inline void discard_segment(int fd, const char* name)
+        {
+            int saved_errno = errno;
+            close(fd);
+            if (name) {
+                shm_unlink(name);
+            }
+            errno = saved_errno;
+        }
+
+        // Creates a segment of size bytes; with a name it can be
+        // opened by shm_open, otherwise it is anonymous (a memfd where
+        // available)
+        inline int create_segment(uint64_t size, const char* name)
+        {
+            int fd = -1;
+            if (name) {
+                fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+            } else {
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+                fd = memfd_create("succinct", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+                std::string tmp_name = "/succinct." + boost::lexical_cast<std::string>(getpid());
+                fd = shm_open(tmp_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+                if (fd >= 0) {
+                    shm_unlink(tmp_name.c_str());
+                }
+#endif
+            }
+            if (fd < 0) {
+                throw_errno("Unable to create shared memory segment");
+            }
+            if (ftruncate(fd, off_t(size)) != 0) {
+                discard_segment(fd, name);
+                throw_errno("Unable to resize shared memory segment");
+            }
+            return fd;
+        }
+
+        // Makes a memfd segment immutable, so that readers can rely
+        // on its content; a no-op for the others
+        inline void seal_segment(int fd)
+        {
+#if defined(F_ADD_SEALS)
+            fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#else
+            (void)fd;
+#endif
+        }
+    }
+
+    // Read-only mapping of a shared memory segment
+    class shared_mapping : boost::noncopyable {
+    public:
+        // maps the segment referred to by fd; fd is not closed
+        explicit shared_mapping(int fd)
+            : m_data(0)
+            , m_size(0)
+        {
+            init(fd);
+        }
+
+        // maps the segment created with the given name
+        explicit shared_mapping(const char* name)
+            : m_data(0)
+            , m_size(0)
+        {
+            int fd = shm_open(name, O_RDONLY, 0);
+            if (fd < 0) {
+                detail::throw_errno(std::string("Unable to open shared memory segment '") + name + "'");
+            }
+            try {
+                init(fd);
+            } catch (...) {
+                close(fd);
+                throw;
+            }
+            close(fd);
+        }
+
+        ~shared_mapping() {
+            if (m_data) {
+                munmap(const_cast<char*>(m_data), m_size);
+            }
+        }
+
+        const char* data() const {
+            return m_data;
+        }
+
+        size_t size() const {
+            return m_size;
+        }
+
+        template <typename T>
+        size_t map(T& val, uint64_t flags = 0, const char* friendly_name = "<TOP>") const {
+            return mapper::map(val, m_data, flags, friendly_name);
+        }
+
+    private:
+        void init(int fd) {
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                detail::throw_errno("Unable to stat shared memory segment");
+            }
+            m_size = size_t(st.st_size);
+            void* data = mmap(0, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                detail::throw_errno("Unable to map shared memory segment");
+            }
+            m_data = static_cast<const char*>(data);
+        }
+
+        const char* m_data;
+        size_t m_size;
+    };
+
+    // Freezes val into a new shared memory segment, and returns its
+    // descriptor. With a name the segment can be opened with
+    // shared_mapping(name) and must be removed with shm_unlink;
+    // otherwise it lives as long as a descriptor or mapping refers to
+    // it.
+    template <typename T>
+    int freeze_shared(T& val, uint64_t flags = 0, const char* name = 0,
+                      const char* friendly_name = "<TOP>")
+    {
+        detail::layout_visitor layout(flags);
+        layout(val, friendly_name);
+        std::vector<detail::freeze_segment> const& segs = layout.segments();
+
+        int fd = detail::create_segment(layout.size(), name);
+        if (layout.size()) {
+            void* data = mmap(0, size_t(layout.size()), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                detail::discard_segment(fd, name);
+                detail::throw_errno("Unable to map shared memory segment");
+            }
+            char* base = static_cast<char*>(data);
+            for (size_t i = 0; i < segs.size(); ++i) {
+                // padding is already zero
+                if (segs[i].data) {
+                    memcpy(base + segs[i].offset, segs[i].data, segs[i].bytes);
+                }
+            }
+            munmap(data, size_t(layout.size()));
+        }
+        detail::seal_segment(fd);
+        return fd;
+    }
+
+    // Copies a frozen file into a new shared memory segment, as
+    // freeze_shared
+    inline int load_shared(const char* filename, const char* name = 0)
+    {
+        boost::iostreams::mapped_file_source m(filename);
+        int fd = detail::create_segment(m.size(), name);
+        if (!detail::pwrite_all(fd, m.data(), m.size(), 0)) {
+            detail::discard_segment(fd, name);
+            detail::throw_errno("Unable to write shared memory segment");
+        }
+        detail::seal_segment(fd);
+        return fd;
+    }
+
+    // Pass a descriptor to another process over a Unix domain socket
+    inline void send_fd(int socket, int fd)
+    {
+        char byte = 0;
+        struct iovec iov = {&byte, 1};
+        char control[CMSG_SPACE(sizeof(int))];
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+        if (sendmsg(socket, &msg, 0) != 1) {
+            detail::throw_errno("Unable to send descriptor");
+        }
+    }
+
+    inline int receive_fd(int socket)
+    {
+        char byte;
+        struct iovec iov = {&byte, 1};
+        char control[CMSG_SPACE(sizeof(int))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(socket, &msg, 0) != 1) {
+            detail::throw_errno("Unable to receive descriptor");
+        }
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS) {
+            throw std::runtime_error("No descriptor received");
+        }
+        int fd;
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        return fd;
+    }
+
+}}
@@ -0,0 +1,99 @@
+#define BOOST_TEST_MODULE access_sampler
+#include "test_common.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include "rs_bit_vector.hpp"
+#include "access_sampler.hpp"
+
+succinct::mapper::size_node_ptr find_node(succinct::mapper::size_node_ptr node, std::string const& name)
+{
+    if (node->name == name) return node;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        succinct::mapper::size_node_ptr ret = find_node(node->children[i], name);
+        if (ret) return ret;
+    }
+    return succinct::mapper::size_node_ptr();
+}
+
+BOOST_AUTO_TEST_CASE(access_sampler)
+{
+    size_t n = 1 << 24;
+    succinct::bit_vector_builder bvb(n);
+    for (size_t i = 0; i < n; i += 3) {
+        bvb.set(i, 1);
+    }
+    succinct::rs_bit_vector bv(&bvb);
+    succinct::mapper::freeze(bv, TEMP_FILE("temp.bin"));
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::rs_bit_vector mapped;
+        succinct::mapper::map(mapped, m);
+
+        succinct::mapper::size_node_ptr tree = succinct::mapper::residency_tree_of(mapped);
+        succinct::mapper::access_sampler sampler(tree);
+        sampler.start();
+        uint64_t sum = 0;
+        // a few queries in the first half
+        for (uint64_t pos = 0; pos < n / 2; pos += n / 64) {
+            sum += mapped.rank(pos);
+        }
+        sampler.stop();
+        BOOST_REQUIRE(sum > 0);
+
+        succinct::mapper::size_node_ptr bits = find_node(tree, "m_bits");
+        BOOST_REQUIRE(bits);
+        BOOST_REQUIRE_EQUAL(bits->pages, bits->touched.size());
+        BOOST_REQUIRE(bits->touched_pages > 0);
+        BOOST_REQUIRE(bits->touched_pages <= 32);
+        // nothing in the second half, except the last page which is
+        // shared with m_block_rank_pairs
+        BOOST_REQUIRE(std::count(bits->touched.begin() + ptrdiff_t(bits->pages / 2 + 1),
+                                 bits->touched.end() - 1, 1) == 0);
+
+        succinct::mapper::size_node_ptr ranks = find_node(tree, "m_block_rank_pairs");
+        BOOST_REQUIRE(ranks->touched_pages > 0);
+        BOOST_REQUIRE(tree->touched_pages >= bits->touched_pages + ranks->touched_pages);
+
+        // protection is restored
+        BOOST_REQUIRE_EQUAL(bv.rank(n - 1), mapped.rank(n - 1));
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(access_sampler_omit_derived)
+{
+    size_t n = 1 << 20;
+    succinct::bit_vector_builder bvb(n);
+    for (size_t i = 0; i < n; i += 5) {
+        bvb.set(i, 1);
+    }
+    succinct::rs_bit_vector bv(&bvb);
+    succinct::mapper::freeze(bv, TEMP_FILE("temp.bin"),
+                             succinct::mapper::freeze_flags::omit_derived);
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::rs_bit_vector mapped;
+        succinct::mapper::map(mapped, m);
+
+        // the rank pairs are rebuilt on the heap
+        succinct::mapper::size_node_ptr tree = succinct::mapper::residency_tree_of(mapped);
+        succinct::mapper::size_node_ptr ranks = find_node(tree, "m_block_rank_pairs");
+        BOOST_REQUIRE(ranks && ranks->data_bytes);
+        succinct::mapper::access_sampler sampler(tree);
+        sampler.start();
+        uint64_t rank = mapped.rank(n / 2);
+        sampler.stop();
+        BOOST_REQUIRE_EQUAL(bv.rank(n / 2), rank);
+        BOOST_REQUIRE(ranks->touched_pages > 0);
+
+        // the heap pages are writable again
+        volatile char* heap = const_cast<char*>(ranks->data);
+        heap[0] = heap[0];
+        heap[ranks->data_bytes - 1] = heap[ranks->data_bytes - 1];
+        BOOST_REQUIRE_EQUAL(bv.rank(n - 1), mapped.rank(n - 1));
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
@@ -4,6 +4,7 @@
 
 #include <cstdlib>
 #include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
 
 #include "mapper.hpp"
 #include "bit_vector.hpp"
@@ -174,8 +175,8 @@ BOOST_AUTO_TEST_CASE(bit_vector_unary_enumerator)
                     ee.skip0(skip);
 
                     uint64_t expected_pos = pos + d;
-                    for (; !v[expected_pos] && expected_pos < v.size(); ++expected_pos);
-                    if (!v[expected_pos]) break;
+                    for (; expected_pos < v.size() && !v[expected_pos]; ++expected_pos);
+                    if (expected_pos == v.size()) break;
                     uint64_t pos = ee.next();
                     MY_REQUIRE_EQUAL(expected_pos, pos,
                                      "pos = " << pos << " skip = " << skip);
@@ -212,3 +213,44 @@ BOOST_AUTO_TEST_CASE(bvb_reverse)
     test_bvb_reverse(1000);
     test_bvb_reverse(1024);
 }
+
+BOOST_AUTO_TEST_CASE(bit_vector_get_word)
+{
+    srand(42);
+    // sizes ending within and at the end of a word
+    size_t sizes[] = {1, 63, 64, 65, 1000, 1024};
+    for (size_t t = 0; t < sizeof(sizes) / sizeof(sizes[0]); ++t) {
+        std::vector<bool> v(sizes[t]);
+        for (size_t i = 0; i < v.size(); ++i) {
+            v[i] = rand() % 2;
+        }
+        // built, stolen from a builder, and mapped
+        succinct::bit_vector bv(v);
+        succinct::bit_vector_builder bvb;
+        for (size_t i = 0; i < v.size(); ++i) {
+            bvb.push_back(v[i]);
+        }
+        succinct::bit_vector stolen(&bvb);
+        succinct::mapper::freeze(bv, TEMP_FILE("temp.bin"));
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::bit_vector mapped;
+        succinct::mapper::map(mapped, m);
+
+        succinct::bit_vector const* bvs[] = {&bv, &stolen, &mapped};
+        for (size_t b = 0; b < 3; ++b) {
+            for (size_t pos = 0; pos < v.size(); ++pos) {
+                uint64_t expected = 0;
+                for (size_t i = 0; i < 64 && pos + i < v.size(); ++i) {
+                    expected |= uint64_t(v[pos + i]) << i;
+                }
+                // the bits past the end are zero
+                MY_REQUIRE_EQUAL(expected, bvs[b]->get_word(pos), "b = " << b << " pos = " << pos);
+                uint64_t mask56 = (uint64_t(1) << 56) - 1;
+                uint64_t word56 = bvs[b]->get_word56(pos) & mask56;
+                uint64_t expected56 = expected & mask56;
+                MY_REQUIRE_EQUAL(expected56, word56, "b = " << b << " pos = " << pos);
+            }
+        }
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
@@ -48,20 +48,20 @@ void test_parentheses(std::vector<char> const& v, BPVector const& bitmap, std::s
     }
 }
 
-BOOST_AUTO_TEST_CASE(bp_vector)
+template <class BPVector>
+void test_bp_vector()
 {
-    srand(42);
 
     {
         std::vector<char> v;
-        succinct::bp_vector bitmap(v);
+        BPVector bitmap(v);
         test_parentheses(v, bitmap, "Empty vector");
     }
 
     {
         std::vector<char> v;
         succinct::random_bp(v, 100000);
-        succinct::bp_vector bitmap(v);
+        BPVector bitmap(v);
         test_parentheses(v, bitmap, "Random parentheses");
     }
 
@@ -70,7 +70,7 @@ BOOST_AUTO_TEST_CASE(bp_vector)
         for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
             std::vector<char> v;
             succinct::random_binary_tree(v, sizes[i]);
-            succinct::bp_vector bitmap(v);
+            BPVector bitmap(v);
             test_parentheses(v, bitmap, "Random binary tree");
         }
     }
@@ -84,9 +84,109 @@ BOOST_AUTO_TEST_CASE(bp_vector)
                 for (size_t i = 0; i < iterations[r]; ++i) {
                     succinct::bp_path(v, sizes[s]);
                 }
-                succinct::bp_vector bitmap(v);
+                BPVector bitmap(v);
                 test_parentheses(v, bitmap, "Nested parentheses");
             }
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(bp_vector)
+{
+    srand(42);
+    test_bp_vector<succinct::bp_vector>();
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_bp_vector)
+{
+    srand(42);
+    test_bp_vector<succinct::interleaved_bp_vector>();
+}
+
+BOOST_AUTO_TEST_CASE(poppy_bp_vector)
+{
+    srand(42);
+    test_bp_vector<succinct::poppy_bp_vector>();
+}
+
+// naive reference for the bp_kernels
+bool naive_find_close(uint64_t const* words, size_t n, int32_t excess, uint64_t& ret)
+{
+    for (uint64_t p = 0; p < n * 64; ++p) {
+        excess += ((words[p / 64] >> (p % 64)) & 1) ? 1 : -1;
+        if (excess == 0) {
+            ret = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool naive_find_open(uint64_t const* words, size_t n, int32_t excess, uint64_t& ret)
+{
+    for (uint64_t p = n * 64; p-- > 0; ) {
+        excess -= ((words[p / 64] >> (p % 64)) & 1) ? 1 : -1;
+        if (excess == 0) {
+            ret = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(bp_kernels)
+{
+    srand(42);
+    std::vector<succinct::bp_kernels> const& kernels = succinct::supported_bp_kernels();
+    BOOST_REQUIRE(kernels.size() >= 1);
+    BOOST_TEST_MESSAGE("Best bp kernels: " << kernels.back().name);
+
+    for (size_t iter = 0; iter < 2000; ++iter) {
+        size_t n = 1 + iter % 4;
+        uint64_t words[4];
+        // skew the density so that the excess can drift far
+        int density = rand() % 9;
+        for (size_t i = 0; i < n; ++i) {
+            words[i] = 0;
+            for (size_t b = 0; b < 64; ++b) {
+                words[i] |= uint64_t(rand() % 8 < density) << b;
+            }
+        }
+        int32_t excess = 1 + int32_t(iter % 7 == 0 ? rand() % (64 * n) : rand() % 8);
+
+        uint64_t expected_close = uint64_t(-1), expected_open = uint64_t(-1);
+        bool found_close = naive_find_close(words, n, excess, expected_close);
+        bool found_open = naive_find_open(words, n, excess, expected_open);
+        for (size_t k = 0; k < kernels.size(); ++k) {
+            uint64_t ret = uint64_t(-1);
+            bool found = kernels[k].find_close(words, n, excess, ret);
+            MY_REQUIRE_EQUAL(found_close, found,
+                             "find_close (" << kernels[k].name << "): iter = " << iter);
+            if (found) {
+                MY_REQUIRE_EQUAL(expected_close, ret,
+                                 "find_close (" << kernels[k].name << "): iter = " << iter);
+            }
+            found = kernels[k].find_open(words, n, excess, ret);
+            MY_REQUIRE_EQUAL(found_open, found,
+                             "find_open (" << kernels[k].name << "): iter = " << iter);
+            if (found) {
+                MY_REQUIRE_EQUAL(expected_open, ret,
+                                 "find_open (" << kernels[k].name << "): iter = " << iter);
+            }
+        }
+    }
+
+    // the whole structure with each kernel set
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        succinct::scoped_bp_kernels scoped(kernels[k]);
+        BOOST_REQUIRE_EQUAL(kernels[k].name, succinct::active_bp_kernels().name);
+        std::vector<char> v;
+        succinct::random_binary_tree(v, 100000);
+        succinct::bp_vector bitmap(v);
+        test_parentheses(v, bitmap, std::string("Random binary tree, ") + kernels[k].name);
+    }
+
+    // AVX2 is never the default, it is slower than the generic search
+    std::string active = succinct::active_bp_kernels().name;
+    BOOST_REQUIRE(active == "generic" || active == "avx512");
+}
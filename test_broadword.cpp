@@ -0,0 +1,159 @@
+#define BOOST_TEST_MODULE broadword
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+
+#include "broadword.hpp"
+
+uint64_t random_word()
+{
+    return uint64_t(rand()) ^ (uint64_t(rand()) << 21) ^ (uint64_t(rand()) << 42);
+}
+
+BOOST_AUTO_TEST_CASE(select_in_word)
+{
+    srand(42);
+    using succinct::broadword::select_kernel;
+    std::vector<select_kernel> const& kernels = succinct::broadword::supported_select_kernels();
+    BOOST_REQUIRE(kernels.size() >= 1);
+    BOOST_TEST_MESSAGE("Best select kernel: " << kernels.back().name);
+    // bound at static initialization, when PDEP is usable
+    BOOST_REQUIRE_EQUAL(kernels.size() > 1, succinct::broadword::detail::select_in_word_pdep != 0);
+
+    for (size_t t = 0; t < 10000; ++t) {
+        uint64_t x = random_word();
+        if (t % 4 == 0) x &= random_word(); // sparser words
+        uint64_t k = 0;
+        for (uint64_t i = 0; i < 64; ++i) {
+            if ((x >> i) & 1) {
+                MY_REQUIRE_EQUAL(i, succinct::broadword::select_in_word(x, k),
+                                 "x = " << x << " k = " << k);
+                for (size_t j = 0; j < kernels.size(); ++j) {
+                    MY_REQUIRE_EQUAL(i, kernels[j].select_in_word(x, k),
+                                     kernels[j].name << ": x = " << x << " k = " << k);
+                }
+                ++k;
+            }
+        }
+        MY_REQUIRE_EQUAL(k, succinct::broadword::popcount(x), "x = " << x);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bulk_kernels)
+{
+    srand(42);
+    using succinct::broadword::bulk_kernels;
+
+    std::vector<bulk_kernels> const& kernels = succinct::broadword::supported_bulk_kernels();
+    BOOST_REQUIRE(kernels.size() >= 1);
+    BOOST_TEST_MESSAGE("Best bulk kernels: " << succinct::broadword::best_bulk_kernels().name);
+
+    size_t sizes[] = {0, 1, 3, 4, 7, 8, 9, 63, 1000};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<uint64_t> data(sizes[s] + 1); // avoid empty vector data()
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = (i % 5 == 0) ? uint64_t(-1) : random_word();
+        }
+        size_t n = sizes[s];
+
+        uint64_t expected_sum = 0;
+        std::vector<uint8_t> expected_counts(n);
+        for (size_t i = 0; i < n; ++i) {
+            expected_counts[i] = uint8_t(succinct::broadword::popcount(data[i]));
+            expected_sum += expected_counts[i];
+        }
+
+        for (size_t k = 0; k < kernels.size(); ++k) {
+            MY_REQUIRE_EQUAL(expected_sum, kernels[k].popcount_sum(&data[0], n),
+                             "popcount_sum (" << kernels[k].name << "): n = " << n);
+
+            std::vector<uint8_t> counts(n + 1, 0xFF);
+            kernels[k].popcount_each(&data[0], n, &counts[0]);
+            BOOST_REQUIRE_EQUAL(0xFF, counts[n]); // no writes past the end
+            for (size_t i = 0; i < n; ++i) {
+                MY_REQUIRE_EQUAL(unsigned(expected_counts[i]), unsigned(counts[i]),
+                                 "popcount_each (" << kernels[k].name << "): n = " << n << " i = " << i);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unpack_bits)
+{
+    srand(42);
+    using succinct::broadword::bulk_kernels;
+    std::vector<bulk_kernels> const& kernels = succinct::broadword::supported_bulk_kernels();
+
+    std::vector<uint64_t> data(200);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = random_word();
+    }
+
+    size_t widths[] = {0, 1, 3, 7, 8, 13, 31, 32, 33, 57, 63};
+    size_t positions[] = {0, 1, 63, 64, 100};
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+        for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); ++p) {
+            size_t width = widths[w];
+            uint64_t pos = positions[p];
+            uint64_t mask = (uint64_t(1) << width) - 1;
+            // up to the end of the array
+            size_t n = width ? (data.size() * 64 - pos) / width : 1000;
+
+            for (size_t k = 0; k < kernels.size(); ++k) {
+                std::vector<uint64_t> out(n + 1, 0xFF);
+                kernels[k].unpack_bits(&data[0], data.size(), pos, width, n, &out[0]);
+                BOOST_REQUIRE_EQUAL(0xFFU, out[n]); // no writes past the end
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t bit = pos + i * width;
+                    uint64_t expected = data[bit / 64] >> (bit % 64);
+                    if (bit % 64 && bit / 64 + 1 < data.size()) {
+                        expected |= data[bit / 64 + 1] << (64 - bit % 64);
+                    }
+                    expected &= mask;
+                    MY_REQUIRE_EQUAL(expected, out[i],
+                                     "unpack_bits (" << kernels[k].name << "): width = " << width
+                                     << " pos = " << pos << " i = " << i);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ones_positions)
+{
+    srand(42);
+    using succinct::broadword::bulk_kernels;
+    std::vector<bulk_kernels> const& kernels = succinct::broadword::supported_bulk_kernels();
+
+    std::vector<uint64_t> data(200);
+    for (size_t i = 0; i < data.size(); ++i) {
+        // mix of dense, sparse and empty words
+        data[i] = (i % 7 == 0) ? uint64_t(-1) : (i % 7 == 1) ? 0 : random_word() & random_word();
+    }
+    std::vector<uint64_t> positions;
+    for (uint64_t i = 0; i < data.size() * 64; ++i) {
+        if (data[i / 64] >> (i % 64) & 1) positions.push_back(i);
+    }
+
+    size_t starts[] = {0, 1, 7, 63, 64, 65, 1000};
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); ++s) {
+        uint64_t pos = starts[s];
+        size_t first = size_t(std::lower_bound(positions.begin(), positions.end(), pos) - positions.begin());
+        size_t max_n = positions.size() - first;
+        size_t sizes[] = {0, 1, 7, 8, 9, 63, 64, 65, 500, max_n};
+        for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); ++z) {
+            size_t n = std::min(sizes[z], max_n);
+            for (size_t k = 0; k < kernels.size(); ++k) {
+                std::vector<uint64_t> out(n + 1, 0xFF);
+                kernels[k].ones_positions(&data[0], pos, n, &out[0]);
+                BOOST_REQUIRE_EQUAL(0xFFU, out[n]); // no writes past the end
+                for (size_t i = 0; i < n; ++i) {
+                    MY_REQUIRE_EQUAL(positions[first + i], out[i],
+                                     "ones_positions (" << kernels[k].name << "): pos = " << pos
+                                     << " n = " << n << " i = " << i);
+                }
+            }
+        }
+    }
+}
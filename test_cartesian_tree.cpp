@@ -11,8 +11,8 @@ typedef uint64_t value_type;
 
 // XXX test (de)serialization
 
-template <typename Comparator>
-void test_rmq(std::vector<value_type> const& v, succinct::cartesian_tree const& tree,
+template <typename CartesianTree, typename Comparator>
+void test_rmq(std::vector<value_type> const& v, CartesianTree const& tree,
               Comparator const& comp, std::string test_name)
 {
     BOOST_REQUIRE_EQUAL(v.size(), tree.size());
@@ -59,13 +59,13 @@ void test_rmq(std::vector<value_type> const& v, succinct::cartesian_tree const&
     }
 }
 
-BOOST_AUTO_TEST_CASE(cartesian_tree)
+template <typename CartesianTree>
+void test_cartesian_tree()
 {
-    srand(42);
 
     {
         std::vector<value_type> v;
-        succinct::cartesian_tree t(v);
+        CartesianTree t(v);
         test_rmq(v, t, std::less<value_type>(), "Empty vector");
     }
 
@@ -76,11 +76,11 @@ BOOST_AUTO_TEST_CASE(cartesian_tree)
         }
 
         {
-            succinct::cartesian_tree t(v);
+            CartesianTree t(v);
             test_rmq(v, t, std::less<value_type>(), "Increasing values");
         }
         {
-            succinct::cartesian_tree t(v, std::greater<value_type>());
+            CartesianTree t(v, std::greater<value_type>());
             test_rmq(v, t, std::greater<value_type>(), "Decreasing values");
         }
     }
@@ -96,12 +96,12 @@ BOOST_AUTO_TEST_CASE(cartesian_tree)
         }
 
         {
-            succinct::cartesian_tree t(v);
+            CartesianTree t(v);
             test_rmq(v, t, std::less<value_type>(), "Convex values");
         }
 
         {
-            succinct::cartesian_tree t(v, std::greater<value_type>());
+            CartesianTree t(v, std::greater<value_type>());
             test_rmq(v, t, std::greater<value_type>(), "Concave values");
         }
     }
@@ -114,8 +114,20 @@ BOOST_AUTO_TEST_CASE(cartesian_tree)
                 v[i] = size_t(rand()) % 1024;
             }
 
-            succinct::cartesian_tree t(v);
+            CartesianTree t(v);
             test_rmq(v, t, std::less<value_type>(), "Random values");
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(cartesian_tree)
+{
+    srand(42);
+    test_cartesian_tree<succinct::cartesian_tree>();
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_cartesian_tree)
+{
+    srand(42);
+    test_cartesian_tree<succinct::interleaved_cartesian_tree>();
+}
@@ -4,12 +4,22 @@
 #include <boost/test/unit_test.hpp>
 
 #include <stdint.h>
+#include <cstdio>
 #include <vector>
 #include <stack>
+#include <string>
+#include <fstream>
+#include <iterator>
+
+#include "mapper.hpp"
 
 #define MY_REQUIRE_EQUAL(A, B, MSG)                                     \
     BOOST_REQUIRE_MESSAGE((A) == (B), BOOST_PP_STRINGIZE(A) << " == " << BOOST_PP_STRINGIZE(B) << " [" << A  << " != " << B << "] " << MSG)
 
+// temporary file names unique to each test binary, so that the tests
+// can run in parallel (ctest -j)
+#define TEMP_FILE(NAME) BOOST_PP_STRINGIZE(BOOST_TEST_MODULE) "_" NAME
+
 inline std::vector<bool> random_bit_vector(size_t n = 10000, double density = 0.5)
 {
     std::vector<bool> v;
@@ -18,3 +28,17 @@ inline std::vector<bool> random_bit_vector(size_t n = 10000, double density = 0.
     }
     return v;
 }
+
+// serialized representation of val, to check that two structures are
+// identical
+template <typename T>
+std::string frozen_bytes(T& val)
+{
+    const char* filename = TEMP_FILE("frozen.bin");
+    succinct::mapper::freeze(val, filename);
+    std::ifstream fin(filename, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    fin.close();
+    std::remove(filename);
+    return bytes;
+}
@@ -74,3 +74,37 @@ BOOST_AUTO_TEST_CASE(darray)
         test_darray(v, "sparse");
     }
 }
+
+BOOST_AUTO_TEST_CASE(darray_parallel_build)
+{
+    srand(42);
+
+    // dense and sparse blocks, the latter are stored in the overflow
+    std::vector<bool> v = random_bit_vector(300000);
+    for (size_t i = 0; i < 3000000; ++i) {
+        v.push_back(i % 1021 == 0);
+    }
+    std::vector<bool> dense = random_bit_vector(200000);
+    v.insert(v.end(), dense.begin(), dense.end());
+    succinct::bit_vector bv(v);
+
+    succinct::parallel::set_num_threads(1);
+    succinct::darray1 serial_d1(bv);
+    succinct::darray0 serial_d0(bv);
+    std::string d1_bytes = frozen_bytes(serial_d1);
+    std::string d0_bytes = frozen_bytes(serial_d0);
+
+    size_t threads[] = {2, 3, 8};
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        succinct::parallel::set_num_threads(threads[t]);
+        succinct::darray1 parallel_d1(bv);
+        succinct::darray0 parallel_d0(bv);
+        BOOST_REQUIRE_MESSAGE(d1_bytes == frozen_bytes(parallel_d1),
+                              "threads = " << threads[t]);
+        BOOST_REQUIRE_MESSAGE(d0_bytes == frozen_bytes(parallel_d0),
+                              "threads = " << threads[t]);
+    }
+    succinct::parallel::set_num_threads(1);
+
+    test_darray(v, "dense and sparse");
+}
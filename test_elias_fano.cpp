@@ -3,14 +3,40 @@
 #include "test_rank_select_common.hpp"
 
 #include <cstdlib>
+#include <algorithm>
 #include <boost/foreach.hpp>
 
 #include "mapper.hpp"
 #include "elias_fano.hpp"
 
-BOOST_AUTO_TEST_CASE(elias_fano)
+template <typename EliasFano>
+void test_decode(EliasFano const& bitmap, const char* test_name)
+{
+    uint64_t n = bitmap.num_ones();
+    std::vector<uint64_t> out(n + 1);
+    size_t counts[] = {0, 1, 5, 64, 1000};
+    for (uint64_t i = 0; i < n; i += n / 7 + 1) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+            size_t count = std::min(counts[c], size_t(n - i));
+            out[count] = 0xFF;
+            bitmap.decode(i, count, &out[0]);
+            BOOST_REQUIRE_EQUAL(0xFFU, out[count]);
+            for (size_t k = 0; k < count; ++k) {
+                MY_REQUIRE_EQUAL(bitmap.select(i + k), out[k],
+                                 "decode (" << test_name << "), i = " << i << ", k = " << k);
+            }
+        }
+    }
+
+    bitmap.decode(0, n, &out[0]);
+    for (size_t k = 0; k < n; ++k) {
+        MY_REQUIRE_EQUAL(bitmap.select(k), out[k], "decode all (" << test_name << "), k = " << k);
+    }
+}
+
+template <typename EliasFano>
+void test_elias_fano()
 {
-    srand(42);
     size_t N = 10000;
 
     {
@@ -24,21 +50,31 @@ BOOST_AUTO_TEST_CASE(elias_fano)
                 bvb.push_back(v[i]);
             }
 
-            succinct::elias_fano bitmap(&bvb);
+            EliasFano bitmap(&bvb);
             test_equal_bits(v, bitmap, "Random bitmap");
             test_rank_select1(v, bitmap, "Random bitmap");
             test_delta(bitmap, "Random bitmap");
             test_select_enumeration(v, bitmap, "Random bitmap");
+            test_enumerator_seek(v, bitmap, "Random bitmap");
+            test_decode(bitmap, "Random bitmap");
+
+            succinct::bit_vector_builder bvb_no_rank;
+            for (size_t i = 0; i < v.size(); ++i) {
+                bvb_no_rank.push_back(v[i]);
+            }
+            EliasFano bitmap_no_rank(&bvb_no_rank, false);
+            test_enumerator_seek(v, bitmap_no_rank, "Random bitmap, no rank index");
         }
     }
 
     {
         // Empty bitmap
         succinct::bit_vector_builder bvb(N);
-        succinct::elias_fano bitmap(&bvb);
+        EliasFano bitmap(&bvb);
         BOOST_REQUIRE_EQUAL(0U, bitmap.num_ones());
         test_equal_bits(std::vector<bool>(N), bitmap, "Empty bitmap");
         test_select_enumeration(std::vector<bool>(N), bitmap, "Empty bitmap");
+        test_enumerator_seek(std::vector<bool>(N), bitmap, "Empty bitmap");
     }
 
     {
@@ -47,11 +83,13 @@ BOOST_AUTO_TEST_CASE(elias_fano)
         succinct::bit_vector_builder bvb(N);
         bvb.set(37, 1);
         v[37] = 1;
-        succinct::elias_fano bitmap(&bvb);
+        EliasFano bitmap(&bvb);
         test_equal_bits(v, bitmap, "Only one value");
         test_rank_select1(v, bitmap, "Only one value");
         test_delta(bitmap, "Only one value");
         test_select_enumeration(v, bitmap, "Only one value");
+        test_enumerator_seek(v, bitmap, "Only one value");
+        test_decode(bitmap, "Only one value");
         BOOST_REQUIRE_EQUAL(1U, bitmap.num_ones());
     }
 
@@ -62,10 +100,24 @@ BOOST_AUTO_TEST_CASE(elias_fano)
         for (size_t i = 0; i < N; ++i) {
             bvb.push_back(1);
         }
-        succinct::elias_fano bitmap(&bvb);
+        EliasFano bitmap(&bvb);
         test_equal_bits(v, bitmap, "Full bitmap");
         test_rank_select1(v, bitmap, "Full bitmap");
         test_delta(bitmap, "Full bitmap");
         test_select_enumeration(v, bitmap, "Full bitmap");
+        test_enumerator_seek(v, bitmap, "Full bitmap");
+        test_decode(bitmap, "Full bitmap");
     }
 }
+
+BOOST_AUTO_TEST_CASE(elias_fano)
+{
+    srand(42);
+    test_elias_fano<succinct::elias_fano>();
+}
+
+BOOST_AUTO_TEST_CASE(poppy_elias_fano)
+{
+    srand(42);
+    test_elias_fano<succinct::poppy_elias_fano>();
+}
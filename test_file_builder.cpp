@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE file_builder
+#include "test_common.hpp"
+#include "test_rank_select_common.hpp"
+
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "mapper.hpp"
+#include "rs_bit_vector.hpp"
+#include "elias_fano.hpp"
+#include "file_builder.hpp"
+
+std::vector<char> read_file(const char* filename)
+{
+    boost::iostreams::mapped_file_source m(filename);
+    return std::vector<char>(m.data(), m.data() + m.size());
+}
+
+BOOST_AUTO_TEST_CASE(file_rs_bit_vector)
+{
+    srand(42);
+    std::vector<bool> v = random_bit_vector(1000000, 0.3);
+
+    succinct::bit_vector_builder bvb;
+    {
+        succinct::file_bit_vector_builder fbvb(TEMP_FILE("temp.bin"));
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (i % 1000 == 999) {
+                // mix the appending operations
+                fbvb.append_bits(uint64_t(v[i]), 1);
+            } else {
+                fbvb.push_back(v[i]);
+            }
+            bvb.push_back(v[i]);
+        }
+        fbvb.zero_extend(100);
+        fbvb.one_extend(70);
+        bvb.zero_extend(100);
+        bvb.one_extend(70);
+        BOOST_REQUIRE_EQUAL(bvb.size(), fbvb.size());
+
+        succinct::bit_vector bits;
+        fbvb.build(bits);
+        // the bits are used in place, not copied out of the file
+        BOOST_REQUIRE(bits.data().data() == fbvb.data());
+        succinct::rs_bit_vector rs(&bits, succinct::select_index_hints);
+        BOOST_REQUIRE_EQUAL(0U, bits.size());
+        fbvb.finish(rs);
+    }
+
+    succinct::rs_bit_vector expected(&bvb, true);
+    succinct::mapper::freeze(expected, TEMP_FILE("temp2.bin"));
+    BOOST_REQUIRE(read_file(TEMP_FILE("temp.bin")) == read_file(TEMP_FILE("temp2.bin")));
+
+    {
+        v.resize(v.size() + 100, 0);
+        v.resize(v.size() + 70, 1);
+        succinct::rs_bit_vector mapped;
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::map(mapped, m);
+        test_equal_bits(v, mapped, "Mapped");
+        test_rank_select1(v, mapped, "Mapped");
+    }
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+    boost::filesystem::remove(TEMP_FILE("temp2.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(file_elias_fano)
+{
+    srand(42);
+    uint64_t n = 10000000;
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < n; i += uint64_t(rand()) % 1000) {
+        values.push_back(i);
+    }
+
+    succinct::elias_fano_builder builder(n, values.size());
+    {
+        succinct::file_elias_fano_builder fbuilder(TEMP_FILE("temp.bin"), n, values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            builder.push_back(values[i]);
+            fbuilder.push_back(values[i]);
+        }
+        succinct::elias_fano ef;
+        fbuilder.finish(ef);
+        BOOST_REQUIRE_EQUAL(values.size(), ef.num_ones());
+        BOOST_REQUIRE_EQUAL(values[42], ef.select(42));
+    }
+    BOOST_REQUIRE(!boost::filesystem::exists(TEMP_FILE("temp.bin.low")));
+
+    succinct::elias_fano expected(&builder);
+    succinct::mapper::freeze(expected, TEMP_FILE("temp2.bin"));
+    BOOST_REQUIRE(read_file(TEMP_FILE("temp.bin")) == read_file(TEMP_FILE("temp2.bin")));
+
+    {
+        succinct::elias_fano mapped;
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::map(mapped, m);
+        for (size_t i = 0; i < values.size(); ++i) {
+            MY_REQUIRE_EQUAL(values[i], mapped.select(i), "i = " << i);
+        }
+    }
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+    boost::filesystem::remove(TEMP_FILE("temp2.bin"));
+}
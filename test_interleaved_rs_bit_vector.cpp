@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE interleaved_rs_bit_vector
+#include "test_common.hpp"
+#include "test_rank_select_common.hpp"
+
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+
+#include "mapper.hpp"
+#include "interleaved_rs_bit_vector.hpp"
+
+BOOST_AUTO_TEST_CASE(interleaved_rs_bit_vector)
+{
+    srand(42);
+
+    // empty vector
+    std::vector<bool> v;
+    succinct::interleaved_rs_bit_vector bitmap;
+
+    succinct::interleaved_rs_bit_vector(v).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    BOOST_REQUIRE_EQUAL(0U, bitmap.rank(0));
+    succinct::interleaved_rs_bit_vector(v, true).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+
+    // random vector
+    v = random_bit_vector();
+
+    succinct::interleaved_rs_bit_vector(v).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_equal_bits(v, bitmap, "IRS - Uniform bits");
+    test_rank_select(v, bitmap, "Uniform bits");
+
+    succinct::interleaved_rs_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Uniform bits - with hints");
+
+    v.resize(10000);
+    v[9999] = 1;
+    v[9000] = 1;
+    succinct::interleaved_rs_bit_vector(v).swap(bitmap);
+
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_rank_select(v, bitmap, "Long runs of 0");
+    succinct::interleaved_rs_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Long runs of 0 - with hints");
+
+    // corner cases, around word, word pair and line boundaries
+    v.clear();
+    v.resize(10000);
+    v[0] = 1;
+    v[63] = 1;
+    v[64] = 1;
+    v[127] = 1;
+    v[128] = 1;
+    v[447] = 1;
+    v[448] = 1;
+    v[895] = 1;
+    v[2112] = 1;
+    succinct::interleaved_rs_bit_vector(v).swap(bitmap);
+
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_rank_select(v, bitmap, "Corner cases");
+    succinct::interleaved_rs_bit_vector(v, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Corner cases - with hints");
+
+    // sizes multiple of the line size
+    v = random_bit_vector(448 * 5);
+    succinct::interleaved_rs_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Full lines");
+    BOOST_REQUIRE_EQUAL(bitmap.num_ones(), bitmap.rank(v.size()));
+
+    // select inventory, dense and sparse regions
+    using succinct::select_index_inventory;
+    v = random_bit_vector();
+    succinct::interleaved_rs_bit_vector(v, select_index_inventory, select_index_inventory).swap(bitmap);
+    test_rank_select(v, bitmap, "Uniform bits - with inventory");
+
+    for (size_t i = 0; i < 1000000; ++i) {
+        v.push_back(i % 997 == 0);
+    }
+    succinct::interleaved_rs_bit_vector(v, select_index_inventory, select_index_inventory).swap(bitmap);
+    test_rank_select(v, bitmap, "Dense and sparse - with inventory");
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_rs_bit_vector_map)
+{
+    srand(42);
+    std::vector<bool> v = random_bit_vector();
+    succinct::interleaved_rs_bit_vector bitmap(v, succinct::select_index_inventory,
+                                               succinct::select_index_inventory);
+    succinct::mapper::freeze(bitmap, TEMP_FILE("temp.bin"));
+
+    {
+        succinct::interleaved_rs_bit_vector mapped_bitmap;
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::map(mapped_bitmap, m);
+        test_equal_bits(v, mapped_bitmap, "Mapped");
+        test_rank_select(v, mapped_bitmap, "Mapped");
+    }
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
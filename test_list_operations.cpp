@@ -0,0 +1,122 @@
+#define BOOST_TEST_MODULE list_operations
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+
+#include "elias_fano.hpp"
+#include "partitioned_elias_fano.hpp"
+#include "list_operations.hpp"
+
+template <typename Sequence>
+struct lists_fixture {
+    lists_fixture(size_t num_lists, uint64_t universe)
+    {
+        for (size_t l = 0; l < num_lists; ++l) {
+            // lists of very different densities
+            double density = 1.0 / double(1 << (l * 3 % 10));
+            std::vector<uint64_t> values;
+            for (uint64_t i = 0; i < universe; ++i) {
+                if (rand() < RAND_MAX * density) values.push_back(i);
+            }
+            succinct::bit_vector_builder bvb(universe);
+            for (size_t i = 0; i < values.size(); ++i) {
+                bvb.set(values[i], 1);
+            }
+            sequences.push_back(new Sequence(&bvb));
+            lists.push_back(values);
+        }
+    }
+
+    ~lists_fixture()
+    {
+        for (size_t i = 0; i < sequences.size(); ++i) {
+            delete sequences[i];
+        }
+    }
+
+    // values in at least k lists
+    std::vector<uint64_t> expected(size_t k) const
+    {
+        std::map<uint64_t, size_t> counts;
+        for (size_t l = 0; l < lists.size(); ++l) {
+            for (size_t i = 0; i < lists[l].size(); ++i) {
+                counts[lists[l][i]] += 1;
+            }
+        }
+        std::vector<uint64_t> ret;
+        for (std::map<uint64_t, size_t>::const_iterator it = counts.begin(); it != counts.end(); ++it) {
+            if (it->second >= k) ret.push_back(it->first);
+        }
+        return ret;
+    }
+
+    size_t total() const
+    {
+        size_t ret = 0;
+        for (size_t l = 0; l < lists.size(); ++l) {
+            ret += lists[l].size();
+        }
+        return ret;
+    }
+
+    std::vector<Sequence const*> sequences;
+    std::vector<std::vector<uint64_t> > lists;
+};
+
+void check_result(std::vector<uint64_t> const& expected, std::vector<uint64_t> const& out,
+                  size_t n, const char* test_name)
+{
+    MY_REQUIRE_EQUAL(expected.size(), n, test_name);
+    for (size_t i = 0; i < n; ++i) {
+        MY_REQUIRE_EQUAL(expected[i], out[i], test_name << ", i = " << i);
+    }
+}
+
+template <typename Sequence>
+void test_list_operations()
+{
+    srand(42);
+    uint64_t universes[] = {1000, 100000};
+    for (size_t u = 0; u < 2; ++u) {
+        for (size_t num_lists = 1; num_lists <= 5; ++num_lists) {
+            lists_fixture<Sequence> f(num_lists, universes[u]);
+            std::vector<uint64_t> out(f.total() + 1);
+
+            size_t n = succinct::intersect_lists(f.sequences, &out[0]);
+            check_result(f.expected(num_lists), out, n, "intersection");
+
+            n = succinct::union_lists(f.sequences, &out[0]);
+            check_result(f.expected(1), out, n, "union");
+
+            for (size_t k = 1; k <= num_lists + 1; ++k) {
+                n = succinct::threshold_lists(f.sequences, k, &out[0]);
+                check_result(f.expected(k), out, n, "threshold");
+            }
+        }
+    }
+
+    // empty inputs
+    std::vector<Sequence const*> no_lists;
+    uint64_t out;
+    BOOST_REQUIRE_EQUAL(0U, succinct::intersect_lists(no_lists, &out));
+    BOOST_REQUIRE_EQUAL(0U, succinct::union_lists(no_lists, &out));
+
+    succinct::bit_vector_builder bvb(100);
+    Sequence empty(&bvb);
+    std::vector<Sequence const*> empty_lists(3, &empty);
+    BOOST_REQUIRE_EQUAL(0U, succinct::intersect_lists(empty_lists, &out));
+    BOOST_REQUIRE_EQUAL(0U, succinct::union_lists(empty_lists, &out));
+    BOOST_REQUIRE_EQUAL(0U, succinct::threshold_lists(empty_lists, 2, &out));
+}
+
+BOOST_AUTO_TEST_CASE(elias_fano_list_operations)
+{
+    test_list_operations<succinct::elias_fano>();
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano_list_operations)
+{
+    test_list_operations<succinct::partitioned_elias_fano>();
+}
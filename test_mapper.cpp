@@ -4,6 +4,11 @@
 #include <boost/filesystem.hpp>
 
 #include "mapper.hpp"
+#include "mapper_container.hpp"
+#include "background_map.hpp"
+#include "rs_bit_vector.hpp"
+#include "elias_fano.hpp"
+#include "bp_vector.hpp"
 
 BOOST_AUTO_TEST_CASE(basic_map)
 {
@@ -17,17 +22,17 @@ BOOST_AUTO_TEST_CASE(basic_map)
     BOOST_REQUIRE_EQUAL(1, vec[0]);
     BOOST_REQUIRE_EQUAL(4, vec[3]);
 
-    succinct::mapper::freeze(vec, "temp.bin");
+    succinct::mapper::freeze(vec, TEMP_FILE("temp.bin"));
 
     {
         succinct::mapper::mappable_vector<int> mapped_vec;
-        boost::iostreams::mapped_file_source m("temp.bin");
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
         succinct::mapper::map(mapped_vec, m);
         BOOST_REQUIRE_EQUAL(vec.size(), mapped_vec.size());
         BOOST_REQUIRE(std::equal(vec.begin(), vec.end(), mapped_vec.begin()));
     }
 
-    boost::filesystem::remove("temp.bin");
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
 }
 
 class complex_struct {
@@ -58,20 +63,563 @@ BOOST_AUTO_TEST_CASE(complex_struct_map)
 {
     complex_struct s;
     s.init();
-    succinct::mapper::freeze(s, "temp.bin");
+    size_t written = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
 
-    BOOST_REQUIRE_EQUAL(24, succinct::mapper::size_of(s));
+    // header, m_a, m_b size, m_b payload and its padding word
+    BOOST_REQUIRE_EQUAL(40, succinct::mapper::size_of(s));
+    BOOST_REQUIRE_EQUAL(written, succinct::mapper::size_of(s));
 
     complex_struct mapped_s;
     BOOST_REQUIRE_EQUAL(0, mapped_s.m_a);
     BOOST_REQUIRE_EQUAL(0U, mapped_s.m_b.size());
 
     {
-        boost::iostreams::mapped_file_source m("temp.bin");
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
         succinct::mapper::map(mapped_s, m);
         BOOST_REQUIRE_EQUAL(s.m_a, mapped_s.m_a);
         BOOST_REQUIRE_EQUAL(s.m_b.size(), mapped_s.m_b.size());
     }
 
-    boost::filesystem::remove("temp.bin");
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(map_warmup)
+{
+    complex_struct s;
+    s.init();
+    std::vector<uint32_t> big(3 << 20);
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = uint32_t(i);
+    }
+    s.m_b.assign(big);
+    succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
+
+    size_t threads[] = {1, 4};
+    for (size_t t = 0; t < 2; ++t) {
+        succinct::parallel::set_num_threads(threads[t]);
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+
+        complex_struct mapped_s;
+        succinct::mapper::warmup_timings timings;
+        succinct::mapper::map(mapped_s, m,
+                              succinct::mapper::map_flags::warmup
+                              | succinct::mapper::map_flags::warmup_advise,
+                              timings);
+        BOOST_REQUIRE_EQUAL(s.m_a, mapped_s.m_a);
+        BOOST_REQUIRE(std::equal(s.m_b.begin(), s.m_b.end(), mapped_s.m_b.begin()));
+
+        BOOST_REQUIRE_EQUAL(1U, timings.size());
+        BOOST_REQUIRE_EQUAL("<TOP>.m_b", timings[0].name);
+        BOOST_REQUIRE_EQUAL(big.size() * sizeof(uint32_t), timings[0].bytes);
+        BOOST_REQUIRE(timings[0].seconds >= 0);
+
+        // no timings without warmup
+        complex_struct mapped_s2;
+        succinct::mapper::map(mapped_s2, m, succinct::mapper::map_flags::warmup_advise, timings);
+        BOOST_REQUIRE_EQUAL(0U, timings.size());
+        BOOST_REQUIRE_EQUAL(s.m_b.size(), mapped_s2.m_b.size());
+    }
+    succinct::parallel::set_num_threads(1);
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(aligned_freeze)
+{
+    using succinct::mapper::freeze_flags;
+    complex_struct s;
+    s.init();
+    size_t unaligned_size = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
+
+    uint64_t flags[] = {freeze_flags::align_cache_line,
+                        freeze_flags::align_page,
+                        freeze_flags::align_huge_page};
+    size_t alignments[] = {64, 4096, 2 << 20};
+    size_t sizes[] = {1, 5000, 1 << 20}; // small and large payloads
+
+    for (size_t f = 0; f < 3; ++f) {
+        for (size_t sz = 0; sz < 3; ++sz) {
+            std::vector<uint32_t> b(sizes[sz]);
+            for (size_t i = 0; i < b.size(); ++i) {
+                b[i] = uint32_t(i * 7);
+            }
+            s.m_b.assign(b);
+            size_t written = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"), flags[f]);
+            BOOST_REQUIRE_EQUAL(boost::filesystem::file_size(TEMP_FILE("temp.bin")), written);
+            BOOST_REQUIRE_EQUAL(written, succinct::mapper::size_of(s, flags[f]));
+            BOOST_REQUIRE_EQUAL(written, succinct::mapper::size_tree_of(s, "s", flags[f])->size);
+
+            boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+            complex_struct mapped_s;
+            BOOST_REQUIRE_EQUAL(written, succinct::mapper::map(mapped_s, m,
+                                                               succinct::mapper::map_flags::advise_hugepage));
+            BOOST_REQUIRE_EQUAL(s.m_a, mapped_s.m_a);
+            BOOST_REQUIRE_EQUAL(s.m_b.size(), mapped_s.m_b.size());
+            BOOST_REQUIRE(std::equal(s.m_b.begin(), s.m_b.end(), mapped_s.m_b.begin()));
+
+            // large payloads get the full alignment, the others a cache line
+            size_t bytes = b.size() * sizeof(uint32_t);
+            size_t alignment = bytes >= alignments[f] ? alignments[f] : 64;
+            size_t offset = size_t(reinterpret_cast<const char*>(mapped_s.m_b.data()) - m.data());
+            MY_REQUIRE_EQUAL(0U, offset % alignment, "alignment = " << alignments[f] << ", size = " << sizes[sz]);
+        }
+    }
+
+    // unaligned files are unchanged
+    s.init();
+    BOOST_REQUIRE_EQUAL(unaligned_size, succinct::mapper::freeze(s, TEMP_FILE("temp.bin")));
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(unsupported_format_version)
+{
+    uint64_t header = uint64_t(0xFF) << 32;
+    {
+        std::ofstream fout(TEMP_FILE("temp.bin"), std::ios::binary);
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::mappable_vector<int> vec;
+        BOOST_REQUIRE_THROW(succinct::mapper::map(vec, m), std::runtime_error);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(container)
+{
+    using succinct::mapper::freeze_flags;
+    complex_struct s1, s2;
+    s1.init();
+    s2.init();
+    s2.m_a = 43;
+    std::vector<uint32_t> big(5000, 7);
+    s2.m_b.assign(big);
+    succinct::mapper::mappable_vector<int> vec;
+    int nums[] = {1, 2, 3};
+    vec.assign(nums);
+
+    {
+        succinct::mapper::container_writer writer(TEMP_FILE("temp.bin"));
+        writer.add(s1, "s1");
+        writer.add(vec, "vec");
+        BOOST_REQUIRE_THROW(writer.add(vec, "vec"), std::invalid_argument);
+    }
+    uint64_t old_size = boost::filesystem::file_size(TEMP_FILE("temp.bin"));
+    {
+        succinct::mapper::container_writer writer(TEMP_FILE("temp.bin"), true);
+        writer.add(s2, "s2", freeze_flags::align_page);
+    }
+
+    {
+        // the old container is left intact before the appended data
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        BOOST_REQUIRE_LT(old_size, m.size());
+        succinct::mapper::detail::container_sections old_sections;
+        succinct::mapper::detail::read_container_directory(m.data(), size_t(old_size), old_sections);
+        BOOST_REQUIRE_EQUAL(2U, old_sections.size());
+        BOOST_REQUIRE_EQUAL("vec", old_sections[1].name);
+    }
+
+    succinct::mapper::container c(TEMP_FILE("temp.bin"));
+    BOOST_REQUIRE_EQUAL(3U, c.size());
+    BOOST_REQUIRE_EQUAL("s1", c.name(0));
+    BOOST_REQUIRE_EQUAL("s2", c.name(2));
+    BOOST_REQUIRE(c.contains("vec"));
+    BOOST_REQUIRE(!c.contains("s3"));
+
+    complex_struct mapped_s1, mapped_s2;
+    succinct::mapper::mappable_vector<int> mapped_vec;
+    c.map(mapped_s2, "s2");
+    BOOST_REQUIRE_EQUAL(s2.m_a, mapped_s2.m_a);
+    BOOST_REQUIRE(std::equal(s2.m_b.begin(), s2.m_b.end(), mapped_s2.m_b.begin()));
+    BOOST_REQUIRE_EQUAL(0U, uintptr_t(mapped_s2.m_b.data()) % 4096);
+    c.map(mapped_s1, "s1");
+    BOOST_REQUIRE_EQUAL(s1.m_a, mapped_s1.m_a);
+    BOOST_REQUIRE(std::equal(s1.m_b.begin(), s1.m_b.end(), mapped_s1.m_b.begin()));
+    c.map(mapped_vec, "vec");
+    BOOST_REQUIRE(std::equal(vec.begin(), vec.end(), mapped_vec.begin()));
+    BOOST_REQUIRE_THROW(c.map(mapped_vec, "s3"), std::invalid_argument);
+
+    succinct::mapper::size_node_ptr tree = c.size_tree();
+    BOOST_REQUIRE_EQUAL(3U, tree->children.size());
+    BOOST_REQUIRE_EQUAL("vec", tree->children[1]->name);
+    BOOST_REQUIRE_EQUAL(succinct::mapper::size_of(vec), tree->children[1]->size);
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+std::vector<char> read_file(const char* filename)
+{
+    boost::iostreams::mapped_file_source m(filename);
+    return std::vector<char>(m.data(), m.data() + m.size());
+}
+
+BOOST_AUTO_TEST_CASE(old_format_version)
+{
+    // files older than the select inventories of rs_bit_vector are
+    // rejected, not misparsed
+    succinct::rs_bit_vector bv(random_bit_vector());
+    succinct::mapper::freeze(bv, TEMP_FILE("temp.bin"));
+    std::vector<char> file = read_file(TEMP_FILE("temp.bin"));
+    for (uint64_t version = 0; version < succinct::mapper::detail::min_format_version; ++version) {
+        uint64_t header = version << succinct::mapper::detail::format_version_shift;
+        memcpy(&file[0], &header, sizeof(header));
+        succinct::rs_bit_vector mapped_bv;
+        BOOST_REQUIRE_THROW(succinct::mapper::map(mapped_bv, &file[0]), std::runtime_error);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(freeze_parallel)
+{
+    using succinct::mapper::freeze_flags;
+    complex_struct s;
+    s.init();
+    // spans more than one write chunk
+    std::vector<uint32_t> big(5 << 20);
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = uint32_t(i * 3);
+    }
+    s.m_b.assign(big);
+
+    uint64_t flags[] = {0, freeze_flags::align_page};
+    size_t threads[] = {1, 4};
+    for (size_t f = 0; f < 2; ++f) {
+        size_t written = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"), flags[f]);
+        std::vector<char> expected = read_file(TEMP_FILE("temp.bin"));
+
+        for (size_t t = 0; t < 2; ++t) {
+            succinct::parallel::set_num_threads(threads[t]);
+            for (int direct = 0; direct < 2; ++direct) {
+                BOOST_REQUIRE_EQUAL(written, succinct::mapper::freeze_parallel(s, TEMP_FILE("temp2.bin"), flags[f], direct));
+                std::vector<char> out = read_file(TEMP_FILE("temp2.bin"));
+                BOOST_REQUIRE_EQUAL(expected.size(), out.size());
+                BOOST_REQUIRE(expected == out);
+            }
+        }
+    }
+    succinct::parallel::set_num_threads(1);
+
+    // small structure, single partial chunk
+    int nums[] = {1, 2, 3};
+    succinct::mapper::mappable_vector<int> vec;
+    vec.assign(nums);
+    succinct::mapper::freeze(vec, TEMP_FILE("temp.bin"));
+    succinct::mapper::freeze_parallel(vec, TEMP_FILE("temp2.bin"), 0, true);
+    BOOST_REQUIRE(read_file(TEMP_FILE("temp.bin")) == read_file(TEMP_FILE("temp2.bin")));
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+    boost::filesystem::remove(TEMP_FILE("temp2.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(hugepage_alloc_policy)
+{
+    using namespace succinct::mapper;
+    const uintptr_t huge_page = uintptr_t(1) << 21;
+    std::vector<uint64_t> big(3 << 18); // 6MB
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = i * i;
+    }
+
+    alloc_policy policies[] = {alloc_hugepage, alloc_hugetlb};
+    for (size_t p = 0; p < 2; ++p) {
+        mappable_vector<uint64_t> vec(big, policies[p]);
+        BOOST_REQUIRE_EQUAL(0U, uintptr_t(vec.data()) % huge_page);
+        BOOST_REQUIRE(std::equal(big.begin(), big.end(), vec.begin()));
+
+        std::vector<uint64_t> copy(big);
+        mappable_vector<uint64_t> stolen;
+        stolen.steal(copy, policies[p]);
+        BOOST_REQUIRE_EQUAL(0U, copy.size());
+        BOOST_REQUIRE_EQUAL(0U, uintptr_t(stolen.data()) % huge_page);
+        BOOST_REQUIRE(std::equal(big.begin(), big.end(), stolen.begin()));
+    }
+
+    // the default policy applies to the builders
+    set_default_alloc_policy(alloc_hugepage);
+    {
+        std::vector<uint64_t> copy(big);
+        mappable_vector<uint64_t> stolen;
+        stolen.steal(copy);
+        BOOST_REQUIRE_EQUAL(0U, uintptr_t(stolen.data()) % huge_page);
+
+        // small vectors are unaffected
+        int nums[] = {1, 2, 3};
+        mappable_vector<int> small(nums);
+        BOOST_REQUIRE(std::equal(nums, nums + 3, small.begin()));
+    }
+    set_default_alloc_policy(alloc_default);
+}
+
+BOOST_AUTO_TEST_CASE(residency_tree)
+{
+    complex_struct s;
+    s.init();
+    std::vector<uint32_t> big(1 << 20, 1);
+    s.m_b.assign(big);
+    succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        complex_struct mapped_s;
+        succinct::mapper::map(mapped_s, m, succinct::mapper::map_flags::warmup);
+
+        succinct::mapper::size_node_ptr tree = succinct::mapper::residency_tree_of(mapped_s);
+        size_t pages = big.size() * sizeof(uint32_t) / succinct::mapper::detail::page_size();
+        BOOST_REQUIRE_EQUAL(1U, tree->children.size());
+        // the payload is not page-aligned
+        BOOST_REQUIRE_EQUAL(pages + 1, tree->children[0]->pages);
+        BOOST_REQUIRE_EQUAL(tree->pages, tree->children[0]->pages);
+        // warmed up
+        BOOST_REQUIRE_EQUAL(tree->pages, tree->resident_pages);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+size_t locked_kb()
+{
+    std::ifstream fin("/proc/self/status");
+    std::string line;
+    while (std::getline(fin, line)) {
+        if (line.compare(0, 6, "VmLck:") == 0) {
+            return size_t(atol(line.c_str() + 6));
+        }
+    }
+    return 0;
+}
+
+BOOST_AUTO_TEST_CASE(map_policy)
+{
+    using succinct::mapper::field_advice;
+    succinct::mapper::map_policy policy = succinct::mapper::map_policy::lock_directories();
+
+    std::vector<const char*> path;
+    path.push_back("<TOP>");
+    path.push_back("m_high_bits_d1");
+    path.push_back("m_block_inventory");
+    BOOST_REQUIRE_EQUAL(uint64_t(field_advice::lock), policy.advice(path));
+    path[2] = "m_bits";
+    BOOST_REQUIRE_EQUAL(uint64_t(field_advice::random), policy.advice(path));
+    // the outermost rule wins
+    path[1] = "m_upper_bounds";
+    BOOST_REQUIRE_EQUAL(uint64_t(field_advice::lock), policy.advice(path));
+    // full paths
+    policy.set("<TOP>.m_upper_bounds.m_bits", field_advice::sequential);
+    BOOST_REQUIRE_EQUAL(uint64_t(field_advice::sequential), policy.advice(path));
+    path[1] = "m_foo";
+    path[2] = "m_bar";
+    BOOST_REQUIRE_EQUAL(uint64_t(field_advice::none), policy.advice(path));
+
+    complex_struct s;
+    s.init();
+    std::vector<uint32_t> big(1 << 20, 1);
+    s.m_b.assign(big);
+    succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        complex_struct mapped_s;
+        size_t locked = locked_kb();
+        succinct::mapper::map_policy lock_b;
+        lock_b.set("m_b", field_advice::lock);
+        succinct::mapper::map(mapped_s, m, 0, lock_b);
+        BOOST_REQUIRE(std::equal(s.m_b.begin(), s.m_b.end(), mapped_s.m_b.begin()));
+        // may fail without CAP_IPC_LOCK and a low RLIMIT_MEMLOCK
+        if (locked_kb() > locked) {
+            BOOST_REQUIRE(locked_kb() - locked >= big.size() * sizeof(uint32_t) / 1024);
+        }
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(default_map_policy)
+{
+    // the rank pairs of the 16M bits are 512KB
+    std::vector<bool> bits(1 << 24);
+    for (size_t i = 0; i < bits.size(); i += 3) {
+        bits[i] = true;
+    }
+    succinct::rs_bit_vector bv(bits);
+    succinct::mapper::freeze(bv, TEMP_FILE("temp.bin"));
+    size_t bits_kb = bits.size() / 8 / 1024;
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        size_t locked = locked_kb();
+        succinct::rs_bit_vector mapped_bv;
+        succinct::mapper::map(mapped_bv, m);
+        BOOST_REQUIRE_EQUAL(bv.num_ones(), mapped_bv.num_ones());
+        // locking is opt-in
+        BOOST_REQUIRE_EQUAL(locked, locked_kb());
+
+        // the directories are locked, unless RLIMIT_MEMLOCK is too low,
+        // and the bits are left pageable
+        succinct::rs_bit_vector locked_bv;
+        succinct::mapper::map(locked_bv, m, 0, succinct::mapper::map_policy::lock_directories());
+        BOOST_REQUIRE_EQUAL(bv.num_ones(), locked_bv.num_ones());
+        if (locked_kb() > locked) {
+            BOOST_REQUIRE(locked_kb() - locked >= 512);
+        }
+        BOOST_REQUIRE(locked_kb() - locked < bits_kb);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+struct indexed_struct {
+    void init() {
+        std::vector<bool> bits(100000), bp;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            bits[i] = rand() % 3 == 0;
+        }
+        succinct::rs_bit_vector(bits, succinct::select_index_inventory,
+                                succinct::select_index_hints).swap(m_bits);
+
+        succinct::elias_fano_builder efb(bits.size(), m_bits.num_ones());
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (bits[i]) efb.push_back(i);
+        }
+        succinct::elias_fano(&efb).swap(m_ef);
+
+        size_t excess = 0;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            bool open = excess == 0 || rand() % 2;
+            bp.push_back(open);
+            excess += open ? 1 : -1;
+        }
+        bp.insert(bp.end(), excess, false);
+        succinct::bp_vector(bp).swap(m_bp);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit
+            (m_bits, "m_bits")
+            (m_ef, "m_ef")
+            (m_bp, "m_bp")
+            ;
+    }
+
+    succinct::rs_bit_vector m_bits;
+    succinct::elias_fano m_ef;
+    succinct::bp_vector m_bp;
+};
+
+void check_indexed_struct(indexed_struct const& s, indexed_struct const& mapped_s)
+{
+    for (size_t i = 0; i < s.m_bits.size(); i += 7) {
+        MY_REQUIRE_EQUAL(s.m_bits.rank(i), mapped_s.m_bits.rank(i), "i = " << i);
+        MY_REQUIRE_EQUAL(s.m_ef.rank(i), mapped_s.m_ef.rank(i), "i = " << i);
+    }
+    for (size_t i = 0; i < s.m_bits.num_ones(); i += 7) {
+        MY_REQUIRE_EQUAL(s.m_bits.select(i), mapped_s.m_bits.select(i), "i = " << i);
+        MY_REQUIRE_EQUAL(s.m_ef.select(i), mapped_s.m_ef.select(i), "i = " << i);
+    }
+    for (size_t i = 0; i < s.m_bits.size() - s.m_bits.num_ones(); i += 7) {
+        MY_REQUIRE_EQUAL(s.m_bits.select0(i), mapped_s.m_bits.select0(i), "i = " << i);
+    }
+    for (size_t i = 0; i < s.m_bp.size(); i += 7) {
+        if (s.m_bp[i]) {
+            MY_REQUIRE_EQUAL(s.m_bp.find_close(i), mapped_s.m_bp.find_close(i), "i = " << i);
+        } else {
+            MY_REQUIRE_EQUAL(s.m_bp.find_open(i), mapped_s.m_bp.find_open(i), "i = " << i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(omit_derived)
+{
+    using succinct::mapper::freeze_flags;
+    indexed_struct s;
+    s.init();
+    size_t full_size = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"));
+    size_t size = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"), freeze_flags::omit_derived);
+    BOOST_REQUIRE_EQUAL(boost::filesystem::file_size(TEMP_FILE("temp.bin")), size);
+    BOOST_REQUIRE_EQUAL(full_size, succinct::mapper::size_of(s));
+    BOOST_REQUIRE_EQUAL(size, succinct::mapper::size_of(s, freeze_flags::omit_derived));
+    BOOST_REQUIRE_LT(size, full_size);
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        indexed_struct mapped_s;
+        BOOST_REQUIRE_EQUAL(size, succinct::mapper::map(mapped_s, m));
+        BOOST_REQUIRE(!mapped_s.m_bits.data().omitted());
+        check_indexed_struct(s, mapped_s);
+        // the rebuilt indices are the same as the frozen ones
+        BOOST_REQUIRE_EQUAL(succinct::mapper::size_of(s), succinct::mapper::size_of(mapped_s));
+
+        succinct::mapper::background_map<indexed_struct> bg(m);
+        BOOST_REQUIRE_EQUAL(size, bg.bytes_read());
+        BOOST_REQUIRE(bg.ready());
+        check_indexed_struct(s, bg.get());
+    }
+
+    // with the alignment, and the same file through freeze_parallel
+    uint64_t flags = freeze_flags::omit_derived | freeze_flags::align_cache_line;
+    size = succinct::mapper::freeze(s, TEMP_FILE("temp.bin"), flags);
+    BOOST_REQUIRE_EQUAL(size, succinct::mapper::size_of(s, flags));
+    std::vector<char> frozen = read_file(TEMP_FILE("temp.bin"));
+    BOOST_REQUIRE_EQUAL(size, succinct::mapper::freeze_parallel(s, TEMP_FILE("temp.bin"), flags));
+    BOOST_REQUIRE(frozen == read_file(TEMP_FILE("temp.bin")));
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        indexed_struct mapped_s;
+        BOOST_REQUIRE_EQUAL(size, succinct::mapper::map(mapped_s, m));
+        check_indexed_struct(s, mapped_s);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(background_map_error)
+{
+    uint64_t header = uint64_t(succinct::mapper::detail::max_format_version + 1)
+        << succinct::mapper::detail::format_version_shift;
+    succinct::mapper::background_map<indexed_struct> bg(reinterpret_cast<const char*>(&header));
+    BOOST_REQUIRE_THROW(bg.get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(move_semantics)
+{
+    // data, size and a tagged owner
+    BOOST_REQUIRE_EQUAL(3 * sizeof(uint64_t), sizeof(succinct::mapper::mappable_vector<uint64_t>));
+
+    std::vector<uint64_t> v(1000);
+    for (size_t i = 0; i < v.size(); ++i) {
+        v[i] = i * i;
+    }
+    std::vector<uint64_t> expected(v);
+    succinct::mapper::mappable_vector<uint64_t> stolen;
+    stolen.steal(v);
+    BOOST_REQUIRE(v.empty());
+    BOOST_REQUIRE(std::equal(expected.begin(), expected.end(), stolen.begin()));
+
+    // a vector reserved with its padding is stolen without a copy
+    std::vector<uint64_t> padded;
+    succinct::mapper::reserve_padded(padded, expected.size());
+    padded.assign(expected.begin(), expected.end());
+    const uint64_t* padded_data = padded.data();
+    succinct::mapper::mappable_vector<uint64_t> stolen_padded;
+    stolen_padded.steal(padded);
+    BOOST_REQUIRE(stolen_padded.data() == padded_data);
+
+#if !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+    succinct::mapper::mappable_vector<uint64_t> moved(std::move(stolen));
+    BOOST_REQUIRE_EQUAL(0U, stolen.size());
+    BOOST_REQUIRE(std::equal(expected.begin(), expected.end(), moved.begin()));
+    stolen = std::move(moved);
+    BOOST_REQUIRE_EQUAL(0U, moved.size());
+    BOOST_REQUIRE(std::equal(expected.begin(), expected.end(), stolen.begin()));
+
+    indexed_struct s;
+    s.init();
+    size_t size = succinct::mapper::size_of(s);
+    std::vector<succinct::elias_fano> efs;
+    efs.push_back(std::move(s.m_ef));
+    BOOST_REQUIRE_EQUAL(0U, s.m_ef.size());
+    succinct::rs_bit_vector bits(std::move(s.m_bits));
+    BOOST_REQUIRE_EQUAL(0U, s.m_bits.size());
+    s.m_bits = std::move(bits);
+    s.m_ef = std::move(efs.back());
+    BOOST_REQUIRE_EQUAL(size, succinct::mapper::size_of(s));
+    BOOST_REQUIRE_EQUAL(s.m_bits.num_ones(), s.m_ef.num_ones());
+#endif
 }
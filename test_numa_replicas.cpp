@@ -0,0 +1,81 @@
+#define BOOST_TEST_MODULE numa_replicas
+#include "test_common.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include "elias_fano.hpp"
+#include "numa_replicas.hpp"
+
+BOOST_AUTO_TEST_CASE(parse_id_list)
+{
+    std::vector<size_t> ids = succinct::mapper::detail::parse_id_list("0-2,5,7-8");
+    size_t expected[] = {0, 1, 2, 5, 7, 8};
+    BOOST_REQUIRE_EQUAL(6U, ids.size());
+    BOOST_REQUIRE(std::equal(ids.begin(), ids.end(), expected));
+    BOOST_REQUIRE_EQUAL(0U, succinct::mapper::detail::parse_id_list("").size());
+}
+
+BOOST_AUTO_TEST_CASE(numa_replicas)
+{
+    succinct::bit_vector_builder bvb(100000);
+    for (size_t i = 0; i < bvb.size(); i += 7) {
+        bvb.set(i, 1);
+    }
+    succinct::elias_fano ef(&bvb);
+    succinct::mapper::freeze(ef, TEMP_FILE("temp.bin"));
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::numa_replicas<succinct::elias_fano> replicas(m);
+        BOOST_REQUIRE(replicas.num_replicas() >= 1);
+
+        for (size_t r = 0; r < replicas.num_replicas(); ++r) {
+            succinct::elias_fano const& replica = replicas.replica(r);
+            BOOST_REQUIRE_EQUAL(ef.num_ones(), replica.num_ones());
+            for (size_t i = 0; i < ef.num_ones(); ++i) {
+                MY_REQUIRE_EQUAL(ef.select(i), replica.select(i), "replica = " << r << ", i = " << i);
+            }
+        }
+
+        succinct::elias_fano const& local = replicas.local();
+        BOOST_REQUIRE_EQUAL(ef.select(42), local.select(42));
+        bool is_replica = false;
+        for (size_t r = 0; r < replicas.num_replicas(); ++r) {
+            is_replica |= (&local == &replicas.replica(r));
+        }
+        BOOST_REQUIRE(is_replica);
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(numa_replicas_omit_derived)
+{
+    succinct::bit_vector_builder bvb(100000);
+    for (size_t i = 0; i < bvb.size(); i += 5) {
+        bvb.set(i, 1);
+    }
+    succinct::elias_fano ef(&bvb);
+    succinct::mapper::freeze(ef, TEMP_FILE("temp.bin"), succinct::mapper::freeze_flags::omit_derived);
+
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::numa_replicas<succinct::elias_fano> replicas(m);
+        for (size_t r = 0; r < replicas.num_replicas(); ++r) {
+            succinct::elias_fano const& replica = replicas.replica(r);
+            for (size_t i = 0; i < ef.num_ones(); i += 13) {
+                MY_REQUIRE_EQUAL(ef.select(i), replica.select(i), "replica = " << r << ", i = " << i);
+            }
+        }
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(numa_replicas_map_error)
+{
+    // the exception thrown by map() in the filler threads reaches the
+    // constructor
+    uint64_t header = uint64_t(0xFF) << 32;
+    typedef succinct::mapper::numa_replicas<succinct::elias_fano> replicas_type;
+    BOOST_REQUIRE_THROW(replicas_type(reinterpret_cast<const char*>(&header), sizeof(header)),
+                        std::runtime_error);
+}
@@ -0,0 +1,171 @@
+#define BOOST_TEST_MODULE packed_collection
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+
+#include "packed_collection.hpp"
+#include "gamma_vector.hpp"
+
+std::vector<std::vector<uint64_t> > random_lists(size_t n)
+{
+    std::vector<std::vector<uint64_t> > lists(n);
+    for (size_t i = 0; i < n; ++i) {
+        // mostly tiny lists, a few large ones
+        size_t len = (i % 100 == 0) ? 1000 : size_t(rand() % 5);
+        uint64_t cur = 0;
+        for (size_t j = 0; j < len; ++j) {
+            cur += uint64_t(rand() % 100);
+            lists[i].push_back(cur);
+        }
+    }
+    return lists;
+}
+
+BOOST_AUTO_TEST_CASE(packed_elias_fano)
+{
+    srand(42);
+    std::vector<std::vector<uint64_t> > lists = random_lists(10000);
+
+    succinct::packed_collection<succinct::elias_fano>::builder builder;
+    size_t frozen = 0;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        std::vector<uint64_t> const& l = lists[i];
+        uint64_t universe = l.empty() ? 0 : l.back();
+        succinct::elias_fano::elias_fano_builder efb(universe, l.size());
+        for (size_t j = 0; j < l.size(); ++j) {
+            efb.push_back(l[j]);
+        }
+        succinct::elias_fano ef(&efb);
+        builder.push_back(ef);
+        frozen += succinct::mapper::freeze(ef, TEMP_FILE("temp.bin"));
+    }
+    BOOST_REQUIRE_EQUAL(lists.size(), builder.size());
+
+    succinct::packed_collection<succinct::elias_fano> coll(&builder);
+    BOOST_REQUIRE_EQUAL(0U, builder.size());
+    BOOST_REQUIRE_EQUAL(lists.size(), coll.size());
+    // the compact framing takes less than the frozen one, even with
+    // the zero padding after each payload
+    BOOST_REQUIRE_LT(succinct::mapper::size_of(coll), frozen * 3 / 4);
+
+    // without alignment the vectors after the 16-bit darray
+    // inventories of the directory would be unaligned
+    size_t written = succinct::mapper::freeze(coll, TEMP_FILE("temp.bin"),
+                                              succinct::mapper::freeze_flags::align_cache_line);
+    {
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::packed_collection<succinct::elias_fano> mapped_coll;
+        BOOST_REQUIRE_EQUAL(written, succinct::mapper::map(mapped_coll, m));
+        BOOST_REQUIRE_EQUAL(lists.size(), mapped_coll.size());
+
+        succinct::elias_fano view;
+        for (size_t i = 0; i < lists.size(); ++i) {
+            mapped_coll.get(i, view);
+            std::vector<uint64_t> const& l = lists[i];
+            MY_REQUIRE_EQUAL(l.size(), view.num_ones(), "i = " << i);
+            for (size_t j = 0; j < l.size(); ++j) {
+                MY_REQUIRE_EQUAL(l[j], view.select(j), "i = " << i << " j = " << j);
+            }
+        }
+    }
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(packed_gamma_vector)
+{
+    srand(42);
+    std::vector<std::vector<uint64_t> > lists = random_lists(1000);
+
+    succinct::packed_collection<succinct::gamma_vector>::builder builder;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        succinct::gamma_vector gv(lists[i]);
+        builder.push_back(gv);
+    }
+    succinct::packed_collection<succinct::gamma_vector> coll(&builder);
+    BOOST_REQUIRE_EQUAL(lists.size(), coll.size());
+
+    succinct::gamma_vector view;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        coll.get(i, view);
+        std::vector<uint64_t> const& l = lists[i];
+        MY_REQUIRE_EQUAL(l.size(), view.size(), "i = " << i);
+        for (size_t j = 0; j < l.size(); ++j) {
+            MY_REQUIRE_EQUAL(l[j], view[j], "i = " << i << " j = " << j);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(packed_empty)
+{
+    succinct::packed_collection<succinct::gamma_vector> empty;
+    BOOST_REQUIRE_EQUAL(0U, empty.size());
+
+    succinct::packed_collection<succinct::gamma_vector>::builder builder;
+    succinct::packed_collection<succinct::gamma_vector> coll(&builder);
+    BOOST_REQUIRE_EQUAL(0U, coll.size());
+}
+
+struct mixed_struct {
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit
+            (bytes, "bytes")
+            (words, "words")
+            ;
+    }
+
+    succinct::mapper::mappable_vector<uint8_t> bytes;
+    succinct::mapper::mappable_vector<uint64_t> words;
+};
+
+BOOST_AUTO_TEST_CASE(packed_alignment)
+{
+    succinct::packed_collection<mixed_struct>::builder builder;
+    for (size_t i = 0; i < 20; ++i) {
+        mixed_struct item;
+        std::vector<uint8_t> bytes(i, uint8_t(i));
+        std::vector<uint64_t> words(i % 3 + 1, i);
+        item.bytes.assign(bytes);
+        item.words.assign(words);
+        builder.push_back(item);
+    }
+    succinct::packed_collection<mixed_struct> coll(&builder);
+
+    mixed_struct view;
+    for (size_t i = 0; i < coll.size(); ++i) {
+        coll.get(i, view);
+        MY_REQUIRE_EQUAL(i, view.bytes.size(), "i = " << i);
+        uintptr_t words_addr = uintptr_t(view.words.data());
+        MY_REQUIRE_EQUAL(0U, words_addr % sizeof(uint64_t), "i = " << i);
+        MY_REQUIRE_EQUAL(i % 3 + 1, view.words.size(), "i = " << i);
+        MY_REQUIRE_EQUAL(i, view.words[0], "i = " << i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(packed_padding)
+{
+    succinct::packed_collection<mixed_struct>::builder builder;
+    for (size_t i = 0; i < 20; ++i) {
+        mixed_struct item;
+        std::vector<uint8_t> bytes(i, 0xFF);
+        std::vector<uint64_t> words(i % 3 + 1, uint64_t(-1));
+        item.bytes.assign(bytes);
+        item.words.assign(words);
+        builder.push_back(item);
+    }
+    succinct::packed_collection<mixed_struct> coll(&builder);
+
+    // the payloads are followed by zeros, not by the next item
+    mixed_struct view;
+    for (size_t i = 0; i < coll.size(); ++i) {
+        coll.get(i, view);
+        if (view.bytes.size()) {
+            uint64_t after_bytes;
+            memcpy(&after_bytes, view.bytes.data() + view.bytes.size(), sizeof(after_bytes));
+            MY_REQUIRE_EQUAL(0U, after_bytes, "i = " << i);
+        }
+        uint64_t after_words = view.words.data()[view.words.size()];
+        MY_REQUIRE_EQUAL(0U, after_words, "i = " << i);
+    }
+}
@@ -0,0 +1,52 @@
+#define BOOST_TEST_MODULE parallel
+#include "test_common.hpp"
+
+#include <stdexcept>
+
+#include "parallel.hpp"
+
+struct counting_function {
+    counting_function(size_t n, size_t fail_at)
+        : calls(n)
+        , fail_at(fail_at)
+    {}
+
+    void operator()(size_t i) {
+        ++calls[i];
+        if (i == fail_at) {
+            throw std::runtime_error("failed");
+        }
+    }
+
+    std::vector<size_t> calls;
+    size_t fail_at;
+};
+
+BOOST_AUTO_TEST_CASE(parallel_for_each)
+{
+    size_t n = 1000;
+    size_t threads[] = {1, 2, 3, 8};
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        succinct::parallel::set_num_threads(threads[t]);
+        counting_function f(n, n);
+        succinct::parallel::for_each(n, f);
+        BOOST_REQUIRE_EQUAL(n, size_t(std::count(f.calls.begin(), f.calls.end(), 1)));
+    }
+    succinct::parallel::set_num_threads(1);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_for_each_exception)
+{
+    size_t n = 1000;
+    // the failing index is in the calling thread's part, then in a
+    // worker's
+    size_t fail_at[] = {0, n / 2, n - 1};
+    succinct::parallel::set_num_threads(4);
+    for (size_t i = 0; i < sizeof(fail_at) / sizeof(fail_at[0]); ++i) {
+        counting_function f(n, fail_at[i]);
+        BOOST_REQUIRE_THROW(succinct::parallel::for_each(n, f), std::runtime_error);
+        // the other parts run to completion
+        BOOST_REQUIRE_EQUAL(1U, f.calls[fail_at[i] < n / 2 ? n - 1 : 0]);
+    }
+    succinct::parallel::set_num_threads(1);
+}
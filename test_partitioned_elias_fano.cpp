@@ -0,0 +1,218 @@
+#define BOOST_TEST_MODULE partitioned_elias_fano
+#include "test_common.hpp"
+#include "test_rank_select_common.hpp"
+
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "mapper.hpp"
+#include "elias_fano.hpp"
+#include "partitioned_elias_fano.hpp"
+
+// alternates runs of consecutive ones, dense clusters and long gaps,
+// so that all the chunk encodings are used
+std::vector<bool> clustered_bit_vector(size_t n)
+{
+    std::vector<bool> v(n);
+    size_t i = 0;
+    while (i < n) {
+        size_t len = size_t(rand()) % 2000 + 1;
+        switch (rand() % 3) {
+        case 0:
+            for (size_t j = i; j < std::min(n, i + len); ++j) {
+                v[j] = 1;
+            }
+            break;
+        case 1:
+            for (size_t j = i; j < std::min(n, i + len); ++j) {
+                v[j] = rand() % 4 == 0;
+            }
+            break;
+        default:
+            len *= 50;
+            if (i + len < n) {
+                v[i + len - 1] = 1;
+            }
+        }
+        i += len;
+    }
+    return v;
+}
+
+void test_pef(std::vector<bool> const& v, const char* test_name)
+{
+    succinct::bit_vector_builder bvb;
+    for (size_t i = 0; i < v.size(); ++i) {
+        bvb.push_back(v[i]);
+    }
+
+    succinct::partitioned_elias_fano bitmap(&bvb);
+    test_equal_bits(v, bitmap, test_name);
+    test_rank_select1(v, bitmap, test_name);
+    test_select_enumeration(v, bitmap, test_name);
+    test_enumerator_seek(v, bitmap, test_name);
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano)
+{
+    srand(42);
+    size_t N = 10000;
+
+    for (size_t d = 1; d < 8; ++d) {
+        double density = 1.0 / (1 << d);
+        test_pef(random_bit_vector(N, density), "Random bitmap");
+    }
+
+    test_pef(std::vector<bool>(N), "Empty bitmap");
+
+    std::vector<bool> v(N);
+    v[37] = 1;
+    test_pef(v, "Only one value");
+
+    test_pef(std::vector<bool>(N, 1), "Full bitmap");
+
+    test_pef(clustered_bit_vector(100000), "Clustered bitmap");
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano_values)
+{
+    srand(42);
+    std::vector<uint64_t> values;
+    uint64_t cur = 0;
+    for (size_t i = 0; i < 100000; ++i) {
+        cur += uint64_t(rand()) % (i % 5000 < 2500 ? 3 : 1000) + 1;
+        values.push_back(cur);
+    }
+    uint64_t universe = cur + 10;
+
+    succinct::partitioned_elias_fano pef(values, universe);
+    BOOST_REQUIRE_EQUAL(universe, pef.size());
+    BOOST_REQUIRE_EQUAL(values.size(), pef.num_ones());
+    for (size_t i = 0; i < values.size(); ++i) {
+        MY_REQUIRE_EQUAL(values[i], pef.select(i), "select, i = " << i);
+    }
+    BOOST_REQUIRE_EQUAL(values.size(), pef.rank(universe - 1));
+
+    succinct::partitioned_elias_fano::select_enumerator it(pef, 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+        uint64_t val = it.next();
+        MY_REQUIRE_EQUAL(values[i], val, "next, i = " << i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano_space)
+{
+    srand(42);
+    std::vector<bool> v = clustered_bit_vector(1000000);
+    succinct::bit_vector_builder bvb_ef, bvb_pef;
+    for (size_t i = 0; i < v.size(); ++i) {
+        bvb_ef.push_back(v[i]);
+        bvb_pef.push_back(v[i]);
+    }
+
+    succinct::elias_fano ef(&bvb_ef);
+    succinct::partitioned_elias_fano pef(&bvb_pef);
+    BOOST_REQUIRE_EQUAL(ef.num_ones(), pef.num_ones());
+    BOOST_REQUIRE_LT(succinct::mapper::size_of(pef), succinct::mapper::size_of(ef));
+}
+
+// exposes the partition for testing
+struct pef_partition : succinct::partitioned_elias_fano {
+    using succinct::partitioned_elias_fano::partition;
+    using succinct::partitioned_elias_fano::chunk_cost;
+    using succinct::partitioned_elias_fano::max_chunk_size;
+
+    static uint64_t cost(std::vector<uint64_t> const& values,
+                         std::vector<uint64_t> const& endpoints) {
+        uint64_t total = 0, begin = 0;
+        for (size_t c = 0; c < endpoints.size(); ++c) {
+            total += chunk_cost(values, begin, endpoints[c]);
+            begin = endpoints[c];
+        }
+        return total;
+    }
+
+    // O(n^2) exact minimum
+    static uint64_t optimal_cost(std::vector<uint64_t> const& values) {
+        uint64_t n = values.size();
+        std::vector<uint64_t> min_cost(n + 1, uint64_t(-1));
+        min_cost[0] = 0;
+        for (uint64_t j = 1; j <= n; ++j) {
+            for (uint64_t i = (j > max_chunk_size) ? j - max_chunk_size : 0; i < j; ++i) {
+                min_cost[j] = std::min(min_cost[j], min_cost[i] + chunk_cost(values, i, j));
+            }
+        }
+        return min_cost[n];
+    }
+};
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano_partition)
+{
+    srand(42);
+    std::vector<std::vector<uint64_t> > inputs;
+    // a run of consecutive values followed by sparse ones, where
+    // some nodes of the DAG are not reached by the bounded edges
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    for (uint64_t i = 0; i < 1000; ++i) {
+        values.push_back(values.back() + 18);
+    }
+    inputs.push_back(values);
+    for (size_t t = 0; t < 5; ++t) {
+        std::vector<bool> v = clustered_bit_vector(20000);
+        values.clear();
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (v[i]) values.push_back(i);
+        }
+        inputs.push_back(values);
+    }
+
+    for (size_t t = 0; t < inputs.size(); ++t) {
+        std::vector<uint64_t> endpoints;
+        pef_partition::partition(inputs[t], endpoints);
+        BOOST_REQUIRE(!endpoints.empty());
+        BOOST_REQUIRE_EQUAL(inputs[t].size(), endpoints.back());
+        for (size_t c = 0; c < endpoints.size(); ++c) {
+            uint64_t begin = c ? endpoints[c - 1] : 0;
+            BOOST_REQUIRE(endpoints[c] > begin);
+            BOOST_REQUIRE(endpoints[c] - begin <= pef_partition::max_chunk_size);
+        }
+
+        // within the approximation factor 1 + eps of the optimum
+        uint64_t cost = pef_partition::cost(inputs[t], endpoints);
+        uint64_t optimal = pef_partition::optimal_cost(inputs[t]);
+        BOOST_REQUIRE(cost >= optimal);
+        if (t == 0) {
+            BOOST_REQUIRE_EQUAL(optimal, cost);
+        }
+        BOOST_REQUIRE_MESSAGE(cost <= optimal * 13 / 10,
+                              "input = " << t << ", cost = " << cost << ", optimal = " << optimal);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_elias_fano_map)
+{
+    srand(42);
+    std::vector<bool> v = clustered_bit_vector(100000);
+    succinct::bit_vector_builder bvb;
+    for (size_t i = 0; i < v.size(); ++i) {
+        bvb.push_back(v[i]);
+    }
+
+    succinct::partitioned_elias_fano bitmap(&bvb);
+    succinct::mapper::freeze(bitmap, TEMP_FILE("temp.bin"));
+
+    {
+        succinct::partitioned_elias_fano mapped_bitmap;
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::map(mapped_bitmap, m);
+        test_equal_bits(v, mapped_bitmap, "Mapped");
+        test_rank_select1(v, mapped_bitmap, "Mapped");
+        test_enumerator_seek(v, mapped_bitmap, "Mapped");
+    }
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
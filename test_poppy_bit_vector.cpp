@@ -0,0 +1,91 @@
+#define BOOST_TEST_MODULE poppy_bit_vector
+#include "test_common.hpp"
+#include "test_rank_select_common.hpp"
+
+#include <cstdlib>
+#include <boost/filesystem.hpp>
+
+#include "mapper.hpp"
+#include "poppy_bit_vector.hpp"
+
+BOOST_AUTO_TEST_CASE(poppy_bit_vector)
+{
+    srand(42);
+
+    // empty vector
+    std::vector<bool> v;
+    succinct::poppy_bit_vector bitmap;
+
+    succinct::poppy_bit_vector(v).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    BOOST_REQUIRE_EQUAL(0U, bitmap.rank(0));
+    succinct::poppy_bit_vector(v, true, true).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+
+    // random vector
+    v = random_bit_vector();
+
+    succinct::poppy_bit_vector(v).swap(bitmap);
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_equal_bits(v, bitmap, "Poppy - Uniform bits");
+    test_rank_select(v, bitmap, "Uniform bits");
+
+    succinct::poppy_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Uniform bits - with samples");
+
+    v.resize(10000);
+    v[9999] = 1;
+    v[9000] = 1;
+    succinct::poppy_bit_vector(v).swap(bitmap);
+
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_rank_select(v, bitmap, "Long runs of 0");
+    succinct::poppy_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Long runs of 0 - with samples");
+
+    // corner cases, around basic block and L1 block boundaries
+    v.clear();
+    v.resize(10000);
+    v[0] = 1;
+    v[511] = 1;
+    v[512] = 1;
+    v[2047] = 1;
+    v[2048] = 1;
+    v[4095] = 1;
+    v[8191] = 1;
+    succinct::poppy_bit_vector(v).swap(bitmap);
+
+    BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
+    test_rank_select(v, bitmap, "Corner cases");
+    succinct::poppy_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Corner cases - with samples");
+
+    // dense and sparse regions, many samples
+    v.clear();
+    for (size_t i = 0; i < 200000; ++i) {
+        v.push_back(rand() % 2);
+    }
+    for (size_t i = 0; i < 1000000; ++i) {
+        v.push_back(i % 997 == 0);
+    }
+    succinct::poppy_bit_vector(v, true, true).swap(bitmap);
+    test_rank_select(v, bitmap, "Dense and sparse - with samples");
+}
+
+BOOST_AUTO_TEST_CASE(poppy_bit_vector_map)
+{
+    srand(42);
+    std::vector<bool> v = random_bit_vector();
+    succinct::poppy_bit_vector bitmap(v, true, true);
+    succinct::mapper::freeze(bitmap, TEMP_FILE("temp.bin"));
+
+    {
+        succinct::poppy_bit_vector mapped_bitmap;
+        boost::iostreams::mapped_file_source m(TEMP_FILE("temp.bin"));
+        succinct::mapper::map(mapped_bitmap, m);
+        test_equal_bits(v, mapped_bitmap, "Mapped");
+        test_rank_select(v, mapped_bitmap, "Mapped");
+    }
+
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
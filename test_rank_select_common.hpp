@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "test_common.hpp"
 
 template <class Vector>
@@ -121,3 +123,62 @@ void test_select_enumeration(std::vector<bool> const& v, Vector const& bitmap, c
         }
     }
 }
+
+template <class Vector>
+void test_enumerator_seek(std::vector<bool> const& v, Vector const& bitmap, const char* test_name)
+{
+    std::vector<uint64_t> positions;
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i]) positions.push_back(i);
+    }
+    uint64_t n = positions.size();
+
+    {
+        // move to random elements, back and forth
+        typename Vector::select_enumerator it(bitmap, 0);
+        for (size_t t = 0; t < 1000 && n; ++t) {
+            uint64_t i = uint64_t(rand()) % n;
+            it.move(i);
+            MY_REQUIRE_EQUAL(i, it.index(), "move (" << test_name << ")");
+            uint64_t val = it.next();
+            MY_REQUIRE_EQUAL(positions[i], val, "move (" << test_name << "), i = " << i);
+        }
+    }
+
+    {
+        // skips of increasing length
+        typename Vector::select_enumerator it(bitmap, 0);
+        uint64_t i = 0;
+        for (uint64_t k = 0; i + k < n; k = k * 2 + 1) {
+            it.skip(k);
+            i += k;
+            uint64_t val = it.next();
+            MY_REQUIRE_EQUAL(positions[i], val, "skip (" << test_name << "), i = " << i);
+            i += 1;
+        }
+    }
+
+    {
+        // next_geq with increasing targets and random gaps
+        for (uint64_t max_gap = 1; max_gap < v.size(); max_gap *= 4) {
+            typename Vector::select_enumerator it(bitmap, 0);
+            uint64_t i = 0;
+            uint64_t x = 0;
+            while (true) {
+                uint64_t j = uint64_t(std::lower_bound(positions.begin(), positions.end(), x)
+                                      - positions.begin());
+                j = std::max(i, j);
+                uint64_t expected = j < n ? positions[j] : bitmap.size();
+                uint64_t val = it.next_geq(x);
+                MY_REQUIRE_EQUAL(expected, val,
+                                 "next_geq (" << test_name << "), x = " << x << ", max_gap = " << max_gap);
+                if (j >= n) break;
+                i = j + 1;
+                MY_REQUIRE_EQUAL(i, it.index(), "next_geq (" << test_name << ")");
+                x = expected + uint64_t(rand()) % max_gap;
+            }
+            uint64_t val = it.next_geq(x);
+            MY_REQUIRE_EQUAL(bitmap.size(), val, "next_geq past the end (" << test_name << ")");
+        }
+    }
+}
@@ -8,6 +8,41 @@
 #include "mapper.hpp"
 #include "rs_bit_vector.hpp"
 
+void test_rank_select_batch(std::vector<bool> const& v, succinct::rs_bit_vector const& bitmap, const char* test_name)
+{
+    std::vector<uint64_t> positions, ones, zeros;
+    for (size_t i = 0; i <= v.size(); ++i) {
+        positions.push_back(uint64_t(rand()) % (v.size() + 1));
+    }
+    for (size_t i = 0; i < bitmap.num_ones(); ++i) {
+        ones.push_back(uint64_t(rand()) % bitmap.num_ones());
+    }
+    for (size_t i = 0; i < bitmap.num_zeros(); ++i) {
+        zeros.push_back(uint64_t(rand()) % bitmap.num_zeros());
+    }
+
+    std::vector<uint64_t> out(positions.size());
+    bitmap.rank_batch(positions.data(), positions.size(), out.data());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        MY_REQUIRE_EQUAL(bitmap.rank(positions[i]), out[i],
+                         "rank_batch (" << test_name << "): i = " << i << ", pos = " << positions[i]);
+    }
+
+    out.resize(ones.size());
+    bitmap.select_batch(ones.data(), ones.size(), out.data());
+    for (size_t i = 0; i < ones.size(); ++i) {
+        MY_REQUIRE_EQUAL(bitmap.select(ones[i]), out[i],
+                         "select_batch (" << test_name << "): i = " << i << ", n = " << ones[i]);
+    }
+
+    out.resize(zeros.size());
+    bitmap.select0_batch(zeros.data(), zeros.size(), out.data());
+    for (size_t i = 0; i < zeros.size(); ++i) {
+        MY_REQUIRE_EQUAL(bitmap.select0(zeros[i]), out[i],
+                         "select0_batch (" << test_name << "): i = " << i << ", n = " << zeros[i]);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(rs_bit_vector)
 {
     srand(42);
@@ -28,9 +63,11 @@ BOOST_AUTO_TEST_CASE(rs_bit_vector)
     BOOST_REQUIRE_EQUAL(v.size(), bitmap.size());
     test_equal_bits(v, bitmap, "RS - Uniform bits");
     test_rank_select(v, bitmap, "Uniform bits");
+    test_rank_select_batch(v, bitmap, "Uniform bits");
 
     succinct::rs_bit_vector(v, true, true).swap(bitmap);
     test_rank_select(v, bitmap, "Uniform bits - with hints");
+    test_rank_select_batch(v, bitmap, "Uniform bits - with hints");
 
     v.resize(10000);
     v[9999] = 1;
@@ -41,6 +78,7 @@ BOOST_AUTO_TEST_CASE(rs_bit_vector)
     test_rank_select(v, bitmap, "Long runs of 0");
     succinct::rs_bit_vector(v, true, true).swap(bitmap);
     test_rank_select(v, bitmap, "Long runs of 0 - with hints");
+    test_rank_select_batch(v, bitmap, "Long runs of 0 - with hints");
 
     // corner cases
     v.clear();
@@ -57,3 +95,72 @@ BOOST_AUTO_TEST_CASE(rs_bit_vector)
     succinct::rs_bit_vector(v, true).swap(bitmap);
     test_rank_select(v, bitmap, "Corner cases - with hints");
 }
+
+BOOST_AUTO_TEST_CASE(rs_bit_vector_select_inventory)
+{
+    srand(42);
+    using succinct::select_index_inventory;
+
+    std::vector<bool> v = random_bit_vector();
+    succinct::rs_bit_vector bitmap(v, select_index_inventory, select_index_inventory);
+    test_rank_select(v, bitmap, "Uniform bits - with inventory");
+    test_rank_select_batch(v, bitmap, "Uniform bits - with inventory");
+
+    // dense regions mixed with sparse ones, whose positions are
+    // stored explicitly in the inventory
+    v.clear();
+    for (size_t i = 0; i < 100000; ++i) {
+        v.push_back(rand() % 2);
+    }
+    for (size_t i = 0; i < 1000000; ++i) {
+        v.push_back(i % 997 == 0);
+    }
+    for (size_t i = 0; i < 100000; ++i) {
+        v.push_back(rand() % 2);
+    }
+    for (size_t i = 0; i < 1000000; ++i) {
+        v.push_back(i % 1009 != 0);
+    }
+    succinct::rs_bit_vector(v, select_index_inventory, select_index_inventory).swap(bitmap);
+    test_rank_select(v, bitmap, "Dense and sparse - with inventory");
+    test_rank_select_batch(v, bitmap, "Dense and sparse - with inventory");
+}
+
+BOOST_AUTO_TEST_CASE(rs_bit_vector_parallel_build)
+{
+    srand(42);
+    using succinct::select_index_hints;
+    using succinct::select_index_inventory;
+
+    std::vector<std::vector<bool> > vectors;
+    vectors.push_back(std::vector<bool>());
+    vectors.push_back(random_bit_vector(1000));
+    vectors.push_back(random_bit_vector(1000003));
+    vectors.push_back(random_bit_vector(1000000, 0.01));
+    vectors.push_back(random_bit_vector(1000000, 0.99));
+    std::vector<bool> mixed = random_bit_vector(100000);
+    for (size_t i = 0; i < 1000000; ++i) {
+        mixed.push_back(i % 997 == 0);
+    }
+    vectors.push_back(mixed);
+
+    size_t threads[] = {2, 3, 8};
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        succinct::parallel::set_num_threads(1);
+        succinct::rs_bit_vector serial_hints(vectors[i], true, true);
+        succinct::rs_bit_vector serial_inventory(vectors[i], select_index_inventory, select_index_inventory);
+        std::string hints_bytes = frozen_bytes(serial_hints);
+        std::string inventory_bytes = frozen_bytes(serial_inventory);
+
+        for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+            succinct::parallel::set_num_threads(threads[t]);
+            succinct::rs_bit_vector parallel_hints(vectors[i], true, true);
+            succinct::rs_bit_vector parallel_inventory(vectors[i], select_index_inventory, select_index_inventory);
+            BOOST_REQUIRE_MESSAGE(hints_bytes == frozen_bytes(parallel_hints),
+                                  "hints: i = " << i << " threads = " << threads[t]);
+            BOOST_REQUIRE_MESSAGE(inventory_bytes == frozen_bytes(parallel_inventory),
+                                  "inventory: i = " << i << " threads = " << threads[t]);
+        }
+    }
+    succinct::parallel::set_num_threads(1);
+}
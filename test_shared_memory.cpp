@@ -0,0 +1,135 @@
+#define BOOST_TEST_MODULE shared_memory
+#include "test_common.hpp"
+
+#include <cstdlib>
+#include <sys/wait.h>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "elias_fano.hpp"
+#include "shared_memory.hpp"
+
+std::vector<uint64_t> test_values()
+{
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 100000; ++i) {
+        values.push_back(i * 13 + i % 7);
+    }
+    return values;
+}
+
+
+bool check_mapping(succinct::mapper::shared_mapping const& m, std::vector<uint64_t> const& values)
+{
+    succinct::elias_fano ef;
+    m.map(ef);
+    if (ef.num_ones() != values.size()) return false;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (ef.select(i) != values[i]) return false;
+    }
+    return true;
+}
+
+// runs f in a child process; call wait_child for the result
+template <typename Function>
+pid_t in_child(Function f, int close_fd = -1)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (close_fd >= 0) {
+            close(close_fd);
+        }
+        bool ok = false;
+        try {
+            ok = f();
+        } catch (...) {}
+        _exit(ok ? 0 : 1);
+    }
+    return pid;
+}
+
+bool wait_child(pid_t pid)
+{
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct map_inherited {
+    int fd;
+    std::vector<uint64_t> const* values;
+    bool operator()() const {
+        succinct::mapper::shared_mapping m(fd);
+        return check_mapping(m, *values);
+    }
+};
+
+struct map_received {
+    int socket;
+    std::vector<uint64_t> const* values;
+    bool operator()() const {
+        int fd = succinct::mapper::receive_fd(socket);
+        succinct::mapper::shared_mapping m(fd);
+        close(fd);
+        return check_mapping(m, *values);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(shared_memory)
+{
+    std::vector<uint64_t> values = test_values();
+    succinct::bit_vector_builder bvb(values.back() + 1);
+    for (size_t i = 0; i < values.size(); ++i) {
+        bvb.set(values[i], 1);
+    }
+    succinct::elias_fano ef(&bvb);
+
+    int fd = succinct::mapper::freeze_shared(ef);
+    {
+        succinct::mapper::shared_mapping m(fd);
+        BOOST_REQUIRE(check_mapping(m, values));
+    }
+
+    // inherited descriptor
+    map_inherited inherited = {fd, &values};
+    BOOST_REQUIRE(wait_child(in_child(inherited)));
+
+    // descriptor passed over a socket, to a process that does not
+    // have it yet
+    int sockets[2];
+    BOOST_REQUIRE_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    map_received received = {sockets[1], &values};
+    pid_t pid = in_child(received, fd);
+    succinct::mapper::send_fd(sockets[0], fd);
+    BOOST_REQUIRE(wait_child(pid));
+    close(sockets[0]);
+    close(sockets[1]);
+    close(fd);
+
+    // named segment, loaded from a frozen file
+    succinct::mapper::freeze(ef, TEMP_FILE("temp.bin"));
+    std::string name = "/succinct_test." + boost::lexical_cast<std::string>(getpid());
+    fd = succinct::mapper::load_shared(TEMP_FILE("temp.bin"), name.c_str());
+    close(fd);
+    {
+        succinct::mapper::shared_mapping m(name.c_str());
+        BOOST_REQUIRE_EQUAL(boost::filesystem::file_size(TEMP_FILE("temp.bin")), m.size());
+        BOOST_REQUIRE(check_mapping(m, values));
+    }
+    shm_unlink(name.c_str());
+    boost::filesystem::remove(TEMP_FILE("temp.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(shared_memory_create_error)
+{
+    // a failed resize reports its own error and removes the name
+    std::string name = "/succinct_test_error." + boost::lexical_cast<std::string>(getpid());
+    try {
+        succinct::mapper::detail::create_segment(uint64_t(-1), name.c_str());
+        BOOST_FAIL("create_segment did not throw");
+    } catch (std::runtime_error const& e) {
+        BOOST_REQUIRE(std::string(e.what()).find(strerror(EINVAL)) != std::string::npos);
+    }
+    BOOST_REQUIRE_EQUAL(-1, shm_open(name.c_str(), O_RDONLY, 0));
+    BOOST_REQUIRE_EQUAL(ENOENT, errno);
+}
@@ -173,6 +173,8 @@ namespace succinct {
                 (m_cartesian_tree, "m_cartesian_tree");
         }
 
+        SUCCINCT_MOVE_BY_SWAP(topk_vector)
+
         void swap(topk_vector& other)
         {
             other.m_v.swap(m_v);
@@ -4,8 +4,14 @@
 #include <stdexcept>
 #include <fstream>
 #include <list>
+#include <new>
+#include <limits>
 
 #include <stdint.h>
+#include <stdlib.h>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
 
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
@@ -270,4 +276,73 @@ namespace succinct { namespace util {
         return IntType1(dividend + d - 1) / d;
     }
 
+    // STL allocator that aligns the storage to Alignment bytes (a
+    // power of 2, multiple of sizeof(void*)), for example to make
+    // the elements of a std::vector start on a cache line
+    template <typename T, size_t Alignment>
+    class aligned_allocator {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T const* const_pointer;
+        typedef T& reference;
+        typedef T const& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind {
+            typedef aligned_allocator<U, Alignment> other;
+        };
+
+        aligned_allocator() {}
+
+        template <typename U>
+        aligned_allocator(aligned_allocator<U, Alignment> const&) {}
+
+        pointer address(reference x) const { return &x; }
+        const_pointer address(const_reference x) const { return &x; }
+
+        pointer allocate(size_type n, const void* /* hint */ = 0)
+        {
+            if (!n) return 0;
+            if (n > max_size()) throw std::bad_alloc();
+            void* p;
+#if defined(_MSC_VER)
+            p = _aligned_malloc(n * sizeof(T), Alignment);
+            if (!p) throw std::bad_alloc();
+#else
+            if (posix_memalign(&p, Alignment, n * sizeof(T))) throw std::bad_alloc();
+#endif
+            return static_cast<pointer>(p);
+        }
+
+        void deallocate(pointer p, size_type /* n */)
+        {
+#if defined(_MSC_VER)
+            _aligned_free(p);
+#else
+            free(p);
+#endif
+        }
+
+        size_type max_size() const
+        {
+            return std::numeric_limits<size_type>::max() / sizeof(T);
+        }
+
+        void construct(pointer p, const_reference val)
+        {
+            new (static_cast<void*>(p)) T(val);
+        }
+
+        void destroy(pointer p)
+        {
+            p->~T();
+        }
+
+        bool operator==(aligned_allocator const&) const { return true; }
+        bool operator!=(aligned_allocator const&) const { return false; }
+    };
+
 }}